@@ -21,6 +21,19 @@
 #include "Model.h"
 #include "Mesh.h"
 #include "render_stuff.h"
+#include "shadows.h"
+#include "headless.h"
+#include "benchmark.h"
+#include "profiler.h"
+#include "gl_stats.h"
+#include "hud.h"
+#include "alloc_tracker.h"
+#include "memory_ledger.h"
+#include "texture_residency.h"
+#include "texture_pipeline.h"
+#include "asset_pack.h"
+#include "asset_bake.h"
+#include "obj_benchmark.h"
 #include "glm/gtx/string_cast.hpp"
 #include "data.h"
 #include "stb_image.h"
@@ -39,6 +52,7 @@ float updateTime();
 void myGLFWInit();
 void enableTests();
 bool initOpenGlFunc();
+bool keepRendering(GLFWwindow* window);
 
 // Camera
 Camera camera(cameraStartPos);
@@ -47,26 +61,91 @@ Camera camera(cameraStartPos);
 ISoundEngine* soundEngine = createIrrKlangDevice();
 
 
-int main()
+int main(int argc, char** argv)
 {
-    // glfw: Init
-    myGLFWInit();
+    // Headless mode renders N frames without window: --headless N [out.ppm]
+    if (!parseHeadlessArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Benchmark replays camera script and writes frame times: --benchmark out.csv
+    if (!parseBenchmarkArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Profiler writes CPU and GPU scopes as Chrome trace: --trace out.json
+    if (!parseProfilerArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Allocation tracker aborts on heap allocation inside of frame: --alloc-assert
+    if (!parseAllocArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Textures of models are kept in video memory budget: --texture-budget MB
+    if (!parseTextureArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Textures of models are compressed and cached unless: --uncompressed-textures
+    if (!parseCompressionArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Assets are read from pack: --pack file.pak, pack is built by: --build-pack out.pak
+    if (!parseAssetPackArgs(argc, argv))
+        return MY_ERROR_RET;
+    // Changed models and textures are baked next to sources before pack is built: --bake
+    if (!parseBakeArgs(argc, argv))
+        return MY_ERROR_RET;
+    if (assetBake.enable && !bakeAssets())
+        return MY_ERROR_RET;
+    if (!assetPack.buildPath.empty())
+        return buildAssetPack(assetPack.buildPath) ? MY_SUCCESS_RET : MY_ERROR_RET;
+    if (assetBake.enable)
+        return MY_SUCCESS_RET;
+    // OBJ models are read by native loader unless: --assimp-obj, both loaders are compared by: --obj-benchmark
+    if (!parseObjLoaderArgs(argc, argv))
+        return MY_ERROR_RET;
+    if (objLoader.benchmark)
+        return benchmarkObjLoader() ? MY_SUCCESS_RET : MY_ERROR_RET;
 
-    // glfw: Window
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "House", NULL, NULL);
-    if (window == NULL)
+    // Files of scene are served from one mapped file, sounds are played from it too
+    openAssetPack();
+    addPackedSound(soundEngine, startCar);
+    addPackedSound(soundEngine, tearPainting);
+
+    GLFWwindow* window = NULL;
+    if (headlessRun.enable)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return MY_ERROR_RET;
+        // EGL: Context without display and offscreen framebuffer
+        if (!initHeadless(SCR_WIDTH, SCR_HEIGHT))
+            return MY_ERROR_RET;
     }
-    
-    // Set callback functions
-    setCallbacks(window);
+    else
+    {
+        // glfw: Init
+        myGLFWInit();
+
+        // glfw: Window
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "House", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return MY_ERROR_RET;
+        }
+
+        // Set callback functions
+        setCallbacks(window);
+
+        // glad: Init OpenGl functions
+        auto error = initOpenGlFunc();
+        if (error) return MY_ERROR_RET;
+
+        // Frame times are not limited by vsync in benchmark
+        if (benchmark.enable)
+            glfwSwapInterval(0);
+    }
+
+    // Count GL calls per pass, it does nothing without GL_STATS
+    installGLStats();
+
+    // Released GL objects are deleted after frames using them
+    initGLResources();
 
-    // glad: Init OpenGl functions
-    auto error = initOpenGlFunc();
-    if (error) return MY_ERROR_RET;
+    // Images are decoded by worker threads and copied into textures through pixel buffers
+    initTextureCompression();
+    initTexturePipeline();
     
     // Enable depth, stecil tests and setup blend
     enableTests();
@@ -76,6 +155,10 @@ int main()
     ShaderGen skyboxShader(skyboxVSpath, skyboxFSpath);
     ShaderGen duckShader(duckVSpath, duckFSpath);
     ShaderGen butterflyShader(butterflyVSpath, butterflyFSpath);    
+    ShaderGen shadowShader(shadowDepthVSpath, shadowDepthFSpath);
+    ShaderGen prepassShader(depthPrepassVSpath, depthPrepassFSpath);
+    ShaderGen oitCompositeShader(oitCompositeVSpath, oitCompositeFSpath);
+    ShaderGen hudShader(hudVSpath, hudFSpath);
     
     // Setup buffers for dynamical objects
     auto duckVAO = initDuckBuffers();
@@ -93,25 +176,17 @@ int main()
     auto skyboxTexture = loadCubemap(skyboxFacesPaths);
     auto skyboxVAO = init_skybox();
 
-    
-    //  Sort windows depend on distance from camera
+    // Setup shadow maps
+    initShadowMaps();
 
-    /*
-    map<float, Mesh> sorted_windows_pos;
-    unsigned int i = 0;
-    for (auto e : windows)
-    {
-        cout << i << endl;
-        glm::vec3 pos = glm::vec3(0.0f);
-        vector<Vertex> vertices = e.vertices;
-        for (unsigned int j = 0; j < vertices.size(); j++)
-        {
-           // cout << glm::to_string(vertices[j].Position) << endl;
-        }
-        i++;
-       // cout << glm::to_string(pos) << endl;
-    }
-    */
+    // Setup queries of shaded fragments
+    initFragmentStats();
+
+    // Setup order-independent transparency of windows
+    initOIT(oitCompositeShader);
+
+    // Setup performance overlay
+    initHud(hudShader);
     
     // Define textures in fragment shader
     skyboxShader.use();
@@ -123,18 +198,54 @@ int main()
     butterflyShader.use();
     glUniform1i(glGetUniformLocation(butterflyShader.ID, "texture_diffuse1"), 0);
     
-    // Init models
+    // Init models, they are streamed in behind first frames from the nearest one
     load_models();   
+    initRegions(camera.Position);
+    // Benchmark and headless runs measure complete scene, every region and texture is uploaded before first frame
+    if (benchmark.enable || headlessRun.enable)
+    {
+        loadAllRegions(camera.Position);
+        finishTextureUploads();
+    }
+    initTextureResidency();
+
+    // Camera script of benchmark
+    if (benchmark.enable)
+        initBenchmark();
+    initProfiler();
+    initFrameArena(frameArenaBytes);
+    initAllocTracker();
 
     // Render
-    while (!glfwWindowShouldClose(window))
+    while (keepRendering(window))
     {
        // glClearStencil(0);
         
         // Update frames
         auto currentFrame = updateTime();
+        beginAllocFrame();
+        resetFrameArena();
+        beginProfilerFrame();
+        beginGLStatsFrame();
+        collectGLResources();
+
+        // Benchmark ignores live input, camera goes by script
+        if (benchmark.enable)
+            beginBenchmarkFrame(camera);
+        else if (!headlessRun.enable)
+            processInput(window);
+
+        // Rooms near camera are streamed in, far ones are evicted
+        updateRegions(camera.Position);
 
-        processInput(window);
+        // Images decoded by workers are copied into textures within byte budget
+        updateTextureUploads(textureUploadBytesPerFrame);
+
+        // Draws of static models are collected once and shared by shadow, depth and color passes
+        build_house_queue(models);
+
+        // Update shadow maps, static depth is rendered only when it is stale
+        updateShadowMaps(shadowShader, tableVAO, tableTex, duckVAO, duckTex, butterflyVAO, butterflyTex);
 
         // Clear window and buffers
         glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
@@ -143,7 +254,17 @@ int main()
         // Calc projection and view models
         glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, near, far);
         glm::mat4 view = camera.GetViewMatrix();
-        
+        cullRenderQueue(houseQueue, projection * view, camera.Position);
+        prioritizeRegionModels(houseQueue, camera.Position);
+
+        // Textures of visible models get resolution they need, others are evicted under pressure,
+        // reloads get bytes of frame not used by streamed textures
+        beginTextureResidencyFrame(projection);
+        touchVisibleTextures(houseQueue, camera.Position);
+        updateTextureResidency(textureUploadBytesPerFrame - texturePipeline.uploadedBytes);
+
+        // Fill depth of opaque objects, so the main pass shades only visible fragments
+        draw_depth_prepass(prepassShader, view, projection);
 
         // Draw skybox
         glStencilFunc(GL_ALWAYS, 0, -1); // Set skybox unclickable
@@ -187,6 +308,7 @@ int main()
         sceneShader.use();
         glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "view"), 1, GL_FALSE, &view[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
+        bindShadowMaps(sceneShader);
 
         // 30+ TRIANGLES
         draw_table(sceneShader, tableVAO, tableTex);
@@ -195,12 +317,52 @@ int main()
         render_scene(sceneShader);
         // Set lights
         setLight(sceneShader, lightDir, camera, Kl, Kq);
+
+        // Performance overlay
+        drawHud();
+
+        if (benchmark.enable)
+            endBenchmarkFrame();
+
+        // Frame has to be free of heap allocations, swap and events are not counted
+        endAllocFrame();
+        endResourceFrame();
         
-        glfwSwapBuffers(window);
+        if (headlessRun.enable)
+        {
+            headlessFrameDone();
+            continue;
+        }
+        {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
-    glfwTerminate();
+    finishProfiler();
+    printGLStats();
+    printAllocStats();
+    printFrameArenaStats();
+    if (benchmark.enable)
+        finishBenchmark();
+    else
+        printFragmentStats();
+
+    // Objects of main are destroyed after context, so everything is deleted here
+    shutdownRegions();
+    shutdownTextureResidency();
+    shutdownTexturePipeline();
+    unload_models();
+    shutdownGLResources();
+    // Sounds of pack point into mapped file
+    if (soundEngine)
+        soundEngine->drop();
+    closeAssetPack();
+    if (headlessRun.enable)
+        terminateHeadless();
+    else
+        glfwTerminate();
     return MY_SUCCESS_RET;
 }
 
@@ -261,13 +423,33 @@ void enableTests()
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
+/// Render loop condition
+/**
+  Function that returns true while window is open, headless frames or benchmark script are not finished
+
+  \param[in] window current window, NULL in headless mode.
+*/
+bool keepRendering(GLFWwindow* window)
+{
+    if (benchmark.enable)
+        return benchmarkRunning() && (window == NULL || !glfwWindowShouldClose(window));
+    if (headlessRun.enable)
+        return headlessRunning();
+    return !glfwWindowShouldClose(window);
+}
+
 /// Time 
 /**
   Function that updates frames
 */
 float updateTime()
 {
-    float currentFrame = glfwGetTime();
+    // Headless and benchmark frames go by fixed step, so animations do not depend on speed of renderer
+    if (fixedTimeStep)
+        sceneTime += fixedDeltaTime;
+    else
+        sceneTime = glfwGetTime();
+    float currentFrame = (float)sceneTime;
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
     return currentFrame;
@@ -279,6 +461,7 @@ float updateTime()
 */
 void processInput(GLFWwindow* window)
 {
+    PROFILE_SCOPE("processInput");
     // Exit 
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -320,6 +503,42 @@ void processInput(GLFWwindow* window)
         else
             fogEnable = true;
     }
+    // Show/Hide performance overlay
+    if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS)
+    {
+        if (!hudKeyDown)
+            toggleHud();
+        hudKeyDown = true;
+    }
+    else
+        hudKeyDown = false;
+    // Enable/Disable depth pre-pass
+    if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
+    {
+        if (!prepassKeyDown)
+            toggleDepthPrepass();
+        prepassKeyDown = true;
+    }
+    else
+        prepassKeyDown = false;
+    // Enable/Disable frustum culling
+    if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+    {
+        if (!cullingKeyDown)
+            toggleCulling();
+        cullingKeyDown = true;
+    }
+    else
+        cullingKeyDown = false;
+    // Print memory ledger
+    if (glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS)
+    {
+        if (!memoryKeyDown)
+            dumpMemoryLedger();
+        memoryKeyDown = true;
+    }
+    else
+        memoryKeyDown = false;
     // Change static cameras by arrows    
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
     {
@@ -433,6 +652,8 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
             else if (ID == models.paintingModel.ID)
             {
                 tearPicture = true;
+                // Painting is part of cached static shadows
+                shadowStaticDirty = true;
                 soundEngine->play2D(tearPainting, false);
             }
                 
@@ -16,8 +16,13 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
-#include "shadergen.h" 
+#include "ShaderGen.h" 
+#include "memory_ledger.h"
+#include "gl_resource.h"
+#include "content_registry.h"
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
@@ -43,15 +48,25 @@ struct Texture {
     string path;///<path of texture
 };
 
+// What stays in CPU memory after upload
+enum GeometryResidency {
+    GEOMETRY_DROP,///< nothing, only GPU buffers
+    GEOMETRY_KEEP_POSITIONS///< positions and indices for picking and collisions
+};
+
 /// Class that holds info about mesh.
 class Mesh {
 public:
     // Mesh data
-    vector<Vertex> vertices;///<vertices of mesh
-    vector<unsigned int> indices;///<indices of mesh
+    vector<Vertex> vertices;///<vertices of mesh, empty after upload
+    vector<unsigned int> indices;///<indices of mesh, kept only with GEOMETRY_KEEP_POSITIONS
+    vector<glm::vec3> positions;///<positions of vertices, kept only with GEOMETRY_KEEP_POSITIONS
     vector<Texture> textures;///<textures of mesh
     aiString mesh_name;///<mesh_name
-    unsigned int VAO;///<VAO of mesh
+    shared_ptr<MeshBuffers> buffers;///<buffers of mesh, shared by meshes with the same content
+    unsigned int indexCount;///<indexCount number of drawn indices
+    glm::vec3 boundsMin;///<boundsMin corner of bounding box in model space
+    glm::vec3 boundsMax;///<boundsMax corner of bounding box in model space
 
     /// Constructor
     /**
@@ -61,8 +76,17 @@ public:
       \param[in] indices vector.
       \param[in] textures vector.
       \param[in] mesh_name name of mesh.
+      \param[in] residency of geometry after upload.
+      \param[in] contentHash hash of vertices and indices, mesh with the same hash gives its buffers, 0 is not shared.
     */
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, aiString mesh_name);
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, aiString mesh_name,
+        GeometryResidency residency = GEOMETRY_DROP, uint64_t contentHash = 0);
+
+    // Mesh shares its buffers only by content, so it can be only moved
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&&) = default;
+    Mesh& operator=(Mesh&&) = default;
     
     /// Mesh render
     /**
@@ -72,10 +96,15 @@ public:
     */
     void Draw(ShaderGen& shader);
 
+    /// Mesh depth render
+    /**
+      Function that draws mesh only with positions, used by depth passes
+    */
+    void DrawDepth();
+
 private:
     
-    // Data for rendering
-    unsigned int VBO, EBO;
+    vector<string> samplerNames;///<samplerNames uniform names of textures, like texture_diffuse1
 
     
     /// Init all buffers
@@ -83,33 +112,92 @@ private:
       Function that initialize and setup VAO,VBO and EBO buffers
     */
     void setupMesh();
+
+    /// Init positions
+    /**
+      Function that copies positions of vertices and computes bounding box, shared meshes need them too
+    */
+    void setupPositions();
+
+    /// Init sampler names
+    /**
+      Function that numbers textures by type, names are built once instead of every draw
+    */
+    void setupSamplerNames();
+
+    /// Release CPU geometry
+    /**
+      Function that frees vertices after upload, only index count and bounds are needed for drawing
+
+      \param[in] residency what stays in CPU memory.
+      \param[in] owner mesh created buffers, shared ones are accounted to their first mesh.
+    */
+    void releaseGeometry(GeometryResidency residency, bool owner);
 };
 
 
 
-Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, aiString mesh_name)
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, aiString mesh_name,
+    GeometryResidency residency, uint64_t contentHash)
 {
-    this->vertices = vertices;
-    this->indices = indices;
-    this->textures = textures;
+    this->vertices = std::move(vertices);
+    this->indices = std::move(indices);
+    this->textures = std::move(textures);
     this->mesh_name = mesh_name;
 
-    setupMesh();
+    setupSamplerNames();
+    setupPositions();
+
+    // Mesh with the same vertices and indices was uploaded already, its buffers are drawn with own textures
+    long long bytes = (long long)this->vertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)) + (long long)indexCount * sizeof(unsigned int);
+    buffers = findSharedMesh(contentHash, this->vertices.size(), indexCount, bytes);
+    bool owner = !buffers;
+    if (owner)
+    {
+        setupMesh();
+        registerSharedMesh(contentHash, buffers, this->vertices.size(), indexCount);
+    }
+    releaseGeometry(residency, owner);
 }
 
 void Mesh::Draw(ShaderGen& shader)
+{
+    for (unsigned int i = 0; i < textures.size(); i++)
+    {
+        // Before binding, activate the desired texture unit
+        glActiveTexture(GL_TEXTURE0 + i);
+
+        // Bind texture
+        glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
+        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+  
+
+    glBindVertexArray(buffers->VAO);
+
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void Mesh::DrawDepth()
+{
+    glBindVertexArray(buffers->depthVAO);
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+    glBindVertexArray(0);
+}
+
+void Mesh::setupSamplerNames()
 {
     unsigned int diffuseNr = 1;
     unsigned int specularNr = 1;
     unsigned int normalNr = 1;
     unsigned int heightNr = 1;
+    samplerNames.clear();
     for (unsigned int i = 0; i < textures.size(); i++)
     {
-        
-        // Before binding, activate the desired texture unit
-        glActiveTexture(GL_TEXTURE0 + i);
         //Get num of texture
-        
         string number;
         string name = textures[i].type;
         if (name == "texture_diffuse")
@@ -120,36 +208,33 @@ void Mesh::Draw(ShaderGen& shader)
             number = std::to_string(normalNr++);
         else if (name == "texture_height")
             number = std::to_string(heightNr++);
-
-        // Bind texture
-        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        samplerNames.push_back(name + number);
     }
-  
-
-    glBindVertexArray(VAO);
-
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
-
-    glActiveTexture(GL_TEXTURE0);
 }
 
 void Mesh::setupMesh()
 {
     // Genetate buffers
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+    buffers = make_shared<MeshBuffers>();
+    GLVertexArray& VAO = buffers->VAO;
+    GLBuffer& VBO = buffers->VBO;
+    GLBuffer& EBO = buffers->EBO;
+    VAO.create();
+    VBO.create();
+    EBO.create();
     // Bind buffers
     glBindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+    long long vertexBytes = (long long)vertices.size() * sizeof(Vertex);
+    ledgerBuffer(VBO, vertexBytes, "vertex", mesh_name.C_Str(), vertexBytes);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+    long long indexBytes = (long long)indices.size() * sizeof(unsigned int);
+    ledgerBuffer(EBO, indexBytes, "index", mesh_name.C_Str(), indexBytes);
 
     // Vertices coord
     glEnableVertexAttribArray(0);
@@ -172,8 +257,57 @@ void Mesh::setupMesh()
     glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    
+
+    // Position only stream, depth passes fetch 12 bytes per vertex instead of whole Vertex
+    GLVertexArray& depthVAO = buffers->depthVAO;
+    GLBuffer& positionVBO = buffers->positionVBO;
+    depthVAO.create();
+    positionVBO.create();
+    glBindVertexArray(depthVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    ledgerBuffer(positionVBO, (long long)positions.size() * sizeof(glm::vec3), "position", mesh_name.C_Str(), 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
     // Clean
     glBindVertexArray(0);
 }
+
+void Mesh::setupPositions()
+{
+    positions.resize(vertices.size());
+    boundsMin = glm::vec3(0.0f);
+    boundsMax = glm::vec3(0.0f);
+    for (unsigned int i = 0; i < vertices.size(); i++)
+    {
+        positions[i] = vertices[i].Position;
+        boundsMin = i == 0 ? positions[i] : glm::min(boundsMin, positions[i]);
+        boundsMax = i == 0 ? positions[i] : glm::max(boundsMax, positions[i]);
+    }
+    indexCount = (unsigned int)indices.size();
+}
+
+void Mesh::releaseGeometry(GeometryResidency residency, bool owner)
+{
+    // Swap with empty vector frees memory, clear() keeps capacity
+    vector<Vertex>().swap(vertices);
+    if (owner)
+        ledgerCpuCopy(LEDGER_BUFFER, buffers->VBO, 0);
+    if (residency == GEOMETRY_KEEP_POSITIONS)
+    {
+        positions.shrink_to_fit();
+        indices.shrink_to_fit();
+        if (owner)
+            ledgerCpuCopy(LEDGER_BUFFER, buffers->positionVBO, (long long)positions.size() * sizeof(glm::vec3));
+        return;
+    }
+    vector<glm::vec3>().swap(positions);
+    vector<unsigned int>().swap(indices);
+    if (owner)
+        ledgerCpuCopy(LEDGER_BUFFER, buffers->EBO, 0);
+}
 #endif
\ No newline at end of file
@@ -19,18 +19,76 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-#include "mesh.h"
-#include "shadergen.h"
+#include "Mesh.h"
+#include "ShaderGen.h"
 #include "data.h"
-
+#include "memory_ledger.h"
+#include "asset_pack.h"
+#include "gl_resource.h"
+#include "texture_residency.h"
+#include "texture_pipeline.h"
+#include "content_registry.h"
+#include "obj_loader.h"
+#include "import_arena.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
 using namespace std;
 
+#define BMESH_MAGIC 0x48534D42
+#define BMESH_VERSION 4
+
+/// Header of baked model, inputs, textures and meshes follow it
+struct BmeshHeader {
+    uint32_t magic;///<magic "BMSH"
+    uint32_t version;///<version of layout
+    uint32_t vertexSize;///<vertexSize size of Vertex, file of other build is not read
+    uint32_t inputs;///<inputs number of source files
+    uint32_t textures;///<textures number of textures of model
+    uint32_t meshes;///<meshes number of meshes
+    float boundsMin[3];///<boundsMin corner of box of vertices, placeholder is drawn from it before model is read
+    float boundsMax[3];///<boundsMax corner of box of vertices
+};
+
+/// Source file of baked model, stale model is imported from sources
+struct BmeshInput {
+    int64_t size;///<size of source file
+    int64_t time;///<time of modification of source file
+    uint32_t pathLength;///<pathLength length of path, paths follow inputs
+    uint32_t reserved;///<reserved zero
+};
+
+/// Mesh imported by loader thread, GL objects are created by upload
+struct MeshImport {
+    vector<Vertex> vertices;///<vertices of mesh
+    vector<unsigned int> indices;///<indices of mesh
+    vector<Texture> textures;///<textures of mesh, id is index of image
+    aiString name;///<name of mesh
+    string material;///<material name of material, used by classification only
+    bool window;///<window mesh is drawn with windows
+    uint64_t hash = 0;///<hash of vertices and indices, meshes with the same one share buffers
+};
+
+/// Model imported by loader thread
+/**
+  Import does not touch GL, so it can run on any thread, upload is done by render thread
+*/
+struct ModelImport {
+    string path;///<path of model file
+    string directory;///<directory where model stored
+    vector<MeshImport> meshes;///<meshes of model
+    vector<Texture> textures;///<textures shared by meshes, images are decoded by texture pipeline
+    vector<uint64_t> textureHashes;///<textureHashes hashes of images of textures, models with the same one share texture
+};
+
 /// Class that holds info about model.
 class Model
 {
@@ -38,9 +96,10 @@ public:
      
     // Model data
     int ID;///<ID of model
-    vector<Texture> textures_loaded;///<textures_loaded from mtl file
     vector<Mesh> meshes;///<meshes of model
     string directory;///<directory where model stored 
+    glm::vec3 boundsCenter = glm::vec3(0.0f);///<boundsCenter center of bounding sphere in model space
+    float boundsRadius = 0.0f;///<boundsRadius radius of bounding sphere in model space
 
    /// Constructor
    /**
@@ -48,163 +107,714 @@ public:
     */
     Model() { }
 
+    // Model owns meshes and textures, so it can be only moved
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = default;
+
     /// Init model
     /**
       Function that initialize model
       
       \param[in] path to model.
       \param[in] id of model.
+      \param[in] residency of CPU geometry after upload.
+    */
+    void init(string const& path, int id, GeometryResidency residency = GEOMETRY_DROP);
+
+    /// Import model
+    /**
+      Function that reads model without GL and prints its time and peak memory of process, returns false when file failed
+
+      \param[in] path to model.
+      \param[out] data imported model.
+    */
+    static bool importModel(string const& path, ModelImport& data);
+
+    /// Import source model
+    /**
+      Function that reads model from source file, OBJ file is read by native loader unless Assimp is requested,
+      returns false when file failed
+
+      \param[in] path to model.
+      \param[out] data imported model.
+    */
+    static bool importSourceModel(string const& path, ModelImport& data);
+
+    /// Import Assimp model
+    /**
+      Function that reads model by Assimp, returns false when file failed
+
+      \param[in] path to model.
+      \param[out] data imported model.
+    */
+    static bool importAssimpModel(string const& path, ModelImport& data);
+
+    /// Import OBJ model
+    /**
+      Function that reads OBJ model by native loader, meshes are the same as meshes given by Assimp,
+      returns false when file failed
+
+      \param[in] path to model.
+      \param[out] data imported model.
+    */
+    static bool importObjModel(string const& path, ModelImport& data);
+
+    /// Read baked model
+    /**
+      Function that reads model baked next to source, returns false when it is missing, broken or stale
+
+      \param[in] path to model.
+      \param[out] data imported model.
+    */
+    static bool readBakedModel(string const& path, ModelImport& data);
+
+    /// Write baked model
+    /**
+      Function that saves imported model next to source with stamps of its sources
+
+      \param[in] path to model.
+      \param[in] data imported model.
+      \param[in] inputs source files, model and its materials.
+    */
+    static bool writeBakedModel(string const& path, const ModelImport& data, const vector<string>& inputs);
+
+    /// Read baked bounds
+    /**
+      Function that reads box of model from header of baked model without reading meshes,
+      returns false when model is not baked
+
+      \param[in] path to model.
+      \param[out] boundsMin corner of box.
+      \param[out] boundsMax corner of box.
+    */
+    static bool readBakedBounds(string const& path, glm::vec3& boundsMin, glm::vec3& boundsMax);
+
+    /// Init placeholder
+    /**
+      Function that makes model a box of its bounds, it is drawn until model is uploaded
+
+      \param[in] boundsMin corner of box.
+      \param[in] boundsMax corner of box.
+      \param[in] id of model.
     */
-    void init(string const& path, int id);
+    void initPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax, int id);
+
+    /// Upload model
+    /**
+      Function that creates buffers and textures of imported model
+
+      \param[in] data imported model, its vectors are moved.
+      \param[in] id of model.
+      \param[in] residency of CPU geometry after upload.
+    */
+    void upload(ModelImport& data, int id, GeometryResidency residency = GEOMETRY_DROP);
 
     /// Draw model
     /**
       Function that call Draw() function in mesh class
 
       \param[in] shader requiers for Draw() function in mesh class.
+      \param[in] cutoutDepth cutout meshes write depth, depth pre-pass skipped them.
+    */
+    void Draw(ShaderGen& shader, bool cutoutDepth = false);
+
+    /// Draw model depth
+    /**
+      Function that call DrawDepth() function in mesh class for meshes without cutouts,
+      cutouts need texture for alpha test
+    */
+    void DrawDepth();
+
+    /// Draw cutouts
+    /**
+      Function that draws only cutout meshes with their textures, shadow pass tests alpha of them
+
+      \param[in] shader requiers for Draw() function in mesh class.
+    */
+    void DrawCutouts(ShaderGen& shader);
+
+    /// Cutout mesh
+    /**
+      Function that returns true when diffuse texture of mesh has alpha channel, like leaves of trees
+
+      \param[in] mesh of model.
     */
-    void Draw(ShaderGen shader);
+    bool isCutoutMesh(const Mesh& mesh);
 
     /// Get windows
     /**
       Helper function that returns vector meshes of windo
     */
-    vector<Mesh> getWindows();
+    vector<Mesh>& getWindows();
 
 private:
     vector<Mesh> meshes_of_windows;///<meshes_of_windows vector contains meshes of windows
+    GeometryResidency residency = GEOMETRY_DROP;///<residency of CPU geometry of meshes
+    vector<shared_ptr<GLTexture>> ownedTextures;///<ownedTextures textures shared by meshes, the last model with the same image deletes them
 
     
-    ///Load models and save meshes in vector
+    /// Bounding sphere
     /**
-      Function that load model from assimp library
-
-     \param[in] path where model is stored.
+      Function that computes bounding sphere around boxes of meshes, it is used by culling
     */
-    void loadModel(string const& path);
+    void computeBounds();
 
     
     /// Recursive process node
     /**
-      Function that recursive process nodes of model and stored mesh info in mesh vector
+      Function that recursive process nodes of model and stored mesh info in mesh vector,
+      vertices are transformed by nodes into space of model
 
       \param[in] node current node of model.
       \param[in] scene loaded model.
+      \param[in,out] data imported model.
+      \param[in] parentTransform transformation of parent nodes.
+    */
+    static void processNode(aiNode* node, const aiScene* scene, ModelImport& data, const glm::mat4& parentTransform);
+
+    /// Transform vertices
+    /**
+      Function that transforms positions by matrix and normals and tangents by its normal matrix
+
+      \param[in,out] vertices of mesh.
+      \param[in] transform matrix of node.
     */
-    void processNode(aiNode* node, const aiScene* scene);
+    static void transformVertices(vector<Vertex>& vertices, const glm::mat4& transform);
 
     /// Procces mesh in scene
     /**
-      Function that extract info about processed mesh and return mesh object
+      Function that extract info about processed mesh and return imported mesh
 
       \param[in] mesh current mesh of model.
       \param[in] scene loaded model.
+      \param[in,out] data imported model.
+    */
+    static MeshImport processMesh(aiMesh* mesh, const aiScene* scene, ModelImport& data);
+
+    /// Optimize model
+    /**
+      Function that classifies meshes by rules into opaque and transparent ones and merges meshes
+      of the same class and textures, so model is drawn by few draw calls. Baked model keeps the result
+
+      \param[in,out] data imported model.
     */
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+    static void optimizeModel(ModelImport& data);
+
+    /// Is transparent mesh
+    /**
+      Function that returns true when the first rule matching name or material of mesh is transparent
+
+      \param[in] mesh imported mesh.
+    */
+    static bool isTransparentMesh(const MeshImport& mesh);
+
+    /// Hash content
+    /**
+      Function that hashes streams of meshes and images of textures, it runs on loader thread so upload only looks them up
+
+      \param[in,out] data imported model.
+    */
+    static void hashContent(ModelImport& data);
 
     /// Check all textures of materials of the specified type and load textures if they have not been loaded yet
     /**
-      Function that loaded textures with materials from model
+      Function that adds textures of material to mesh, textures are shared by meshes
 
       \param[in] mat material of model.
       \param[in] type texture type of model.
       \param[in] typeName of texture.
+      \param[in,out] data imported model.
+      \param[in,out] textures of mesh.
     */
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName);
+    static void loadMaterialTextures(aiMaterial* mat, aiTextureType type, const string& typeName, ModelImport& data, vector<Texture>& textures);
+
+    /// Add texture
+    /**
+      Function that adds texture to mesh, texture with the same path is shared with other meshes of model
+
+      \param[in] path of texture from .mtl file.
+      \param[in] typeName of texture.
+      \param[in,out] data imported model.
+      \param[in,out] textures of mesh.
+    */
+    static void addMaterialTexture(const string& path, const string& typeName, ModelImport& data, vector<Texture>& textures);
 
     /// Load textures
     /**
-      Function that loaded and return textures from .mtl file
+      Function that creates texture and returns its id, image is decoded and uploaded by texture pipeline later
 
-      \param[in] path where texture is stored.
-      \param[in] directory of model where stored .mtl file.
-      \param[in] gamma of texture.
+      \param[in] texture type and path from .mtl file.
+      \param[in] hash of image, texture of the same image is reused, 0 is not shared.
     */
-    unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
+    unsigned int TextureFromFile(const Texture& texture, uint64_t hash);
 
 };
 
 
 
-void Model::init(string const& path, int id)
+void Model::init(string const& path, int id, GeometryResidency residency)
 {
     ID = id;
-    loadModel(path);
+    ModelImport data;
+    if (importModel(path, data))
+        upload(data, id, residency);
 }
 
 
-void Model::Draw(ShaderGen shader)
+void Model::Draw(ShaderGen& shader, bool cutoutDepth)
 {
     for (unsigned int i = 0; i < meshes.size(); i++)
     { 
-        meshes[i].Draw(shader);
+        // Blended cutouts are not in pre-pass depth, they write it like without pre-pass
+        if (cutoutDepth && isCutoutMesh(meshes[i]))
+        {
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+            meshes[i].Draw(shader);
+            glDepthFunc(GL_LEQUAL);
+            glDepthMask(GL_FALSE);
+        }
+        else
+            meshes[i].Draw(shader);
+    }
+}
+
+
+void Model::DrawDepth()
+{
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (!isCutoutMesh(meshes[i]))
+            meshes[i].DrawDepth();
+    }
+}
+
+
+void Model::DrawCutouts(ShaderGen& shader)
+{
+    for (unsigned int i = 0; i < meshes.size(); i++)
+    {
+        if (isCutoutMesh(meshes[i]))
+            meshes[i].Draw(shader);
+    }
+}
+
+
+bool Model::isCutoutMesh(const Mesh& mesh)
+{
+    for (const Texture& texture : mesh.textures)
+    {
+        if (texture.type == "texture_diffuse")
+            return textureHasAlpha(texture.id);
+    }
+    return false;
+}
+
+
+bool Model::importModel(string const& path, ModelImport& data)
+{
+    auto start = chrono::steady_clock::now();
+    // Baked model is read without Assimp
+    bool imported = readBakedModel(path, data);
+    if (!imported)
+    {
+        data = ModelImport();
+        imported = importSourceModel(path, data);
+    }
+    if (imported)
+    {
+        hashContent(data);
+        // Models are imported by loader threads, line is printed at once
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        char line[256];
+        snprintf(line, sizeof(line), ": %zu meshes, %.2f ms, peak memory %lld MB", data.meshes.size(), ms,
+            peakProcessMemory() / (1024 * 1024));
+        cout << "Model " + path + line + "\n" << flush;
+    }
+    return imported;
+}
+
+void Model::hashContent(ModelImport& data)
+{
+    for (auto& mesh : data.meshes)
+    {
+        mesh.hash = meshContentHash(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex),
+            mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
     }
+    data.textureHashes.resize(data.textures.size());
+    for (size_t i = 0; i < data.textures.size(); i++)
+        data.textureHashes[i] = textureContentHash(data.directory + '/' + data.textures[i].path, data.textures[i].type == "texture_normal");
 }
 
+bool Model::importSourceModel(string const& path, ModelImport& data)
+{
+    // OBJ file is read without Assimp, Assimp reads it when native loader fails
+    bool imported = false;
+    if (!objLoader.assimp && hasExtension(path, ".obj"))
+    {
+        imported = importObjModel(path, data);
+        if (!imported)
+        {
+            cout << "OBJ: " << path << " is imported by Assimp" << endl;
+            data = ModelImport();
+        }
+    }
+    if (!imported)
+        imported = importAssimpModel(path, data);
+    if (imported)
+        optimizeModel(data);
+    return imported;
+}
 
-void Model::loadModel(string const& path)
+bool Model::importAssimpModel(string const& path, ModelImport& data)
 {
     Assimp::Importer importer;
+    // Model and its materials are read from asset pack
+    importer.SetIOHandler(new AssetIOSystem());
     const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
    
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
     {
         cout << "ERROR ASSIMP: " << importer.GetErrorString() << endl;
-        return;
+        return false;
     }
 
     
     //Get file direction
-    directory = path.substr(0, path.find_last_of('\\'));
-
-    processNode(scene->mRootNode, scene);
+    data.path = path;
+    data.directory = path.substr(0, path.find_last_of("/\\"));
+    processNode(scene->mRootNode, scene, data, glm::mat4(1.0f));
+    return true;
 }
 
+bool Model::importObjModel(string const& path, ModelImport& data)
+{
+    // Temporaries of parser live in arena, it is destroyed after model which uses it
+    ImportArena arena;
+    ImportArena* previous = bindImportArena(&arena);
+    ObjModel model;
+    bool loaded = loadObjModel(path, model);
+    bindImportArena(previous);
+    if (!loaded)
+        return false;
+
+    data.path = path;
+    data.directory = path.substr(0, path.find_last_of("/\\"));
+    data.meshes.reserve(model.meshes.size());
+    for (auto& mesh : model.meshes)
+    {
+        const ObjMaterial& material = model.materials[mesh.material];
+        MeshImport imported;
+        imported.vertices = std::move(mesh.vertices);
+        imported.indices = std::move(mesh.indices);
+        // Textures are in the same order as in processMesh
+        if (!material.diffuseMap.empty())
+            addMaterialTexture(material.diffuseMap, "texture_diffuse", data, imported.textures);
+        if (!material.specularMap.empty())
+            addMaterialTexture(material.specularMap, "texture_specular", data, imported.textures);
+        if (!material.bumpMap.empty())
+            addMaterialTexture(material.bumpMap, "texture_normal", data, imported.textures);
+        if (!material.ambientMap.empty())
+            addMaterialTexture(material.ambientMap, "texture_height", data, imported.textures);
+        imported.name = aiString(mesh.name);
+        imported.material = material.name;
+        imported.window = false;
+        data.meshes.push_back(std::move(imported));
+    }
+    return true;
+}
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+bool Model::readBakedModel(string const& path, ModelImport& data)
 {
+    AssetData baked;
+    if (!readAsset(path + modelBakeExtension, baked))
+        return false;
+    size_t position = 0;
+    auto take = [&](void* out, size_t bytes)
+    {
+        if (baked.size - position < bytes)
+            return false;
+        memcpy(out, baked.data + position, bytes);
+        position += bytes;
+        return true;
+    };
+    auto takeString = [&](string& out, uint32_t length)
+    {
+        if (baked.size - position < length)
+            return false;
+        out.assign((const char*)baked.data + position, length);
+        position += length;
+        return true;
+    };
+
+    BmeshHeader header;
+    if (!take(&header, sizeof(header)) || header.magic != BMESH_MAGIC || header.version != BMESH_VERSION || header.vertexSize != sizeof(Vertex))
+        return false;
+
+    // Model or material changed after bake
+    vector<BmeshInput> inputs(header.inputs);
+    if (!take(inputs.data(), inputs.size() * sizeof(BmeshInput)))
+        return false;
+    for (auto& input : inputs)
+    {
+        string source;
+        int64_t size, time;
+        if (!takeString(source, input.pathLength) || !assetFileStat(source, size, time) || size != input.size || time != input.time)
+            return false;
+    }
 
-    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    data.path = path;
+    data.directory = path.substr(0, path.find_last_of("/\\"));
+    data.textures.resize(header.textures);
+    for (unsigned int i = 0; i < header.textures; i++)
     {
+        uint32_t lengths[2];
+        if (!take(lengths, sizeof(lengths)) || !takeString(data.textures[i].type, lengths[0]) || !takeString(data.textures[i].path, lengths[1]))
+            return false;
+        data.textures[i].id = i;
+    }
 
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];  
-      
+    data.meshes.resize(header.meshes);
+    for (auto& mesh : data.meshes)
+    {
+        // Name length, window, vertices, indices and textures
+        uint32_t counts[5];
+        string name;
+        if (!take(counts, sizeof(counts)) || !takeString(name, counts[0]))
+            return false;
+        mesh.name.Set(name);
+        mesh.window = counts[1] != 0;
+        mesh.textures.resize(counts[4]);
+        for (auto& texture : mesh.textures)
+        {
+            uint32_t index;
+            if (!take(&index, sizeof(index)) || index >= data.textures.size())
+                return false;
+            texture = data.textures[index];
+        }
+        mesh.vertices.resize(counts[2]);
+        mesh.indices.resize(counts[3]);
+        if (!take(mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex)) || !take(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int)))
+            return false;
+    }
+    return true;
+}
+
+bool Model::writeBakedModel(string const& path, const ModelImport& data, const vector<string>& inputs)
+{
+    string temporary = path + modelBakeExtension + ".tmp";
+    {
+        ofstream file(temporary, ios::binary | ios::trunc);
+        BmeshHeader header = { BMESH_MAGIC, BMESH_VERSION, (uint32_t)sizeof(Vertex), (uint32_t)inputs.size(),
+            (uint32_t)data.textures.size(), (uint32_t)data.meshes.size(), { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+        bool first = true;
+        for (auto& mesh : data.meshes)
+        {
+            for (auto& vertex : mesh.vertices)
+            {
+                for (int i = 0; i < 3; i++)
+                {
+                    header.boundsMin[i] = first ? vertex.Position[i] : min(header.boundsMin[i], vertex.Position[i]);
+                    header.boundsMax[i] = first ? vertex.Position[i] : max(header.boundsMax[i], vertex.Position[i]);
+                }
+                first = false;
+            }
+        }
+        file.write((const char*)&header, sizeof(header));
+        for (auto& source : inputs)
+        {
+            BmeshInput input = {};
+            if (!assetFileStat(source, input.size, input.time))
+                return false;
+            input.pathLength = (uint32_t)source.size();
+            file.write((const char*)&input, sizeof(input));
+        }
+        for (auto& source : inputs)
+            file.write(source.data(), source.size());
 
-        string tmp = (string)mesh->mName.data;
-        // This is necessary to separate the windows from the model of the house
-        if (tmp != back_window_bottom_left_name && tmp != back_window_bottom_middle_name &&
-            tmp != back_window_bottom_rightest_name && tmp != back_window_top_rightest_name &&
-            tmp != back_window_top_miidle_name && tmp != back_window_top_left_name &&
-            tmp != front_window_top_left_name && tmp != front_window_top_middle_name &&
-            tmp != front_window_top_right_name && tmp != door_window_front_left_name &&
-            tmp != front_windows_bottom_name && tmp != door_window_front_right_name &&
-            tmp != front_window10 && tmp != door_window_top_right_teracce &&
-            tmp != door_window_top_right_teracce2 && tmp != door_window_top_left_teracce &&
-            tmp != door_window_top_left_teracce2 && tmp != water)
+        for (auto& texture : data.textures)
         {
-            meshes.push_back(processMesh(mesh, scene));
+            uint32_t lengths[2] = { (uint32_t)texture.type.size(), (uint32_t)texture.path.size() };
+            file.write((const char*)lengths, sizeof(lengths));
+            file.write(texture.type.data(), texture.type.size());
+            file.write(texture.path.data(), texture.path.size());
         }
-        else
+
+        // Textures of meshes are indices of textures of model until upload
+        for (auto& mesh : data.meshes)
+        {
+            uint32_t counts[5] = { (uint32_t)mesh.name.length, mesh.window ? 1u : 0u, (uint32_t)mesh.vertices.size(),
+                (uint32_t)mesh.indices.size(), (uint32_t)mesh.textures.size() };
+            file.write((const char*)counts, sizeof(counts));
+            file.write(mesh.name.C_Str(), mesh.name.length);
+            for (auto& texture : mesh.textures)
+                file.write((const char*)&texture.id, sizeof(uint32_t));
+            file.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            file.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        }
+        if (!file)
         {
-            meshes_of_windows.push_back(processMesh(mesh, scene));
+            cout << "Failed to write baked model of " << path << endl;
+            return false;
         }
+    }
+    remove((path + modelBakeExtension).c_str());
+    return rename(temporary.c_str(), (path + modelBakeExtension).c_str()) == 0;
+}
+
+bool Model::readBakedBounds(string const& path, glm::vec3& boundsMin, glm::vec3& boundsMax)
+{
+    // Stale bake still gives good enough box
+    BmeshHeader header;
+    if (!readAssetHead(path + modelBakeExtension, &header, sizeof(header)) || header.magic != BMESH_MAGIC || header.version != BMESH_VERSION)
+        return false;
+    boundsMin = glm::vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+    boundsMax = glm::vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+    return true;
+}
+
+void Model::initPlaceholder(glm::vec3 boundsMin, glm::vec3 boundsMax, int id)
+{
+    // Every face of box has its own vertices, so it is lit flat
+    const glm::vec3 normals[6] = { glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+        glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1) };
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f, half = (boundsMax - boundsMin) * 0.5f;
+    MeshImport box;
+    box.vertices.reserve(24);
+    box.indices.reserve(36);
+    for (auto& normal : normals)
+    {
+        glm::vec3 u(normal.y != 0.0f ? 1.0f : 0.0f, normal.y != 0.0f ? 0.0f : 1.0f, 0.0f);
+        glm::vec3 v = glm::cross(normal, u);
+        unsigned int first = (unsigned int)box.vertices.size();
+        for (int corner = 0; corner < 4; corner++)
+        {
+            glm::vec2 side((corner == 1 || corner == 2) ? 1.0f : -1.0f, corner >= 2 ? 1.0f : -1.0f);
+            Vertex vertex;
+            vertex.Position = center + (normal + u * side.x + v * side.y) * half;
+            vertex.Normal = normal;
+            vertex.TexCoords = glm::vec2(0.0f);
+            vertex.color = placeholderColor;
+            vertex.useDiffuseTexture = 0.0f;
+            vertex.Tangent = u;
+            vertex.Bitangent = v;
+            box.vertices.push_back(vertex);
+        }
+        box.indices.insert(box.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+    }
+    box.name = aiString("placeholder");
+    box.window = false;
+
+    ModelImport data;
+    data.path = "placeholders";
+    data.meshes.push_back(std::move(box));
+    upload(data, id);
+}
+
+void Model::upload(ModelImport& data, int id, GeometryResidency residency)
+{
+    ID = id;
+    this->residency = residency;
+    directory = data.directory;
+
+    // Buffers and textures of model are accounted to its file
+    memoryLedger.group = data.path;
+    size_t windows = 0;
+    for (auto& mesh : data.meshes)
+        windows += mesh.window ? 1 : 0;
+    meshes.reserve(meshes.size() + data.meshes.size() - windows);
+    meshes_of_windows.reserve(meshes_of_windows.size() + windows);
+    vector<unsigned int> textureIDs;
+    textureIDs.reserve(data.textures.size());
+    for (size_t i = 0; i < data.textures.size(); i++)
+        textureIDs.push_back(TextureFromFile(data.textures[i], i < data.textureHashes.size() ? data.textureHashes[i] : 0));
+
+    for (auto& mesh : data.meshes)
+    {
+        for (auto& texture : mesh.textures)
+            texture.id = textureIDs[texture.id];
+        vector<Mesh>& target = mesh.window ? meshes_of_windows : meshes;
+        target.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), std::move(mesh.textures), mesh.name, residency, mesh.hash));
+    }
+    memoryLedger.group = "scene";
+    computeBounds();
+}
+
+void Model::computeBounds()
+{
+    if (meshes.empty())
+        return;
+
+    glm::vec3 minPos = meshes[0].boundsMin, maxPos = meshes[0].boundsMax;
+    for (auto& mesh : meshes)
+    {
+        minPos = glm::min(minPos, mesh.boundsMin);
+        maxPos = glm::max(maxPos, mesh.boundsMax);
+    }
+
+    // Sphere encloses boxes of meshes, vertices are not in CPU memory anymore
+    boundsCenter = (minPos + maxPos) * 0.5f;
+    boundsRadius = 0.0f;
+    for (auto& mesh : meshes)
+    {
+        glm::vec3 corner = glm::max(glm::abs(mesh.boundsMin - boundsCenter), glm::abs(mesh.boundsMax - boundsCenter));
+        boundsRadius = glm::max(boundsRadius, glm::length(corner));
+    }
+}
+
+
+void Model::processNode(aiNode* node, const aiScene* scene, ModelImport& data, const glm::mat4& parentTransform)
+{
+    // Hierarchy is flattened, so meshes of all nodes are in space of model and can be merged
+    const aiMatrix4x4& m = node->mTransformation;
+    glm::mat4 transform = parentTransform * glm::mat4(m.a1, m.b1, m.c1, m.d1, m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3, m.a4, m.b4, m.c4, m.d4);
+
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
+    {
+
+        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];  
+      
+
+        data.meshes.push_back(processMesh(mesh, scene, data));
+        if (transform != glm::mat4(1.0f))
+            transformVertices(data.meshes.back().vertices, transform);
         
     }
 
 
     for (unsigned int i = 0; i < node->mNumChildren; i++)
     {
-        processNode(node->mChildren[i], scene);
+        processNode(node->mChildren[i], scene, data, transform);
     }
 
 }
 
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+void Model::transformVertices(vector<Vertex>& vertices, const glm::mat4& transform)
+{
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+    glm::mat3 tangentMatrix = glm::mat3(transform);
+    for (auto& vertex : vertices)
+    {
+        vertex.Position = glm::vec3(transform * glm::vec4(vertex.Position, 1.0f));
+        vertex.Normal = glm::normalize(normalMatrix * vertex.Normal);
+        vertex.Tangent = glm::normalize(tangentMatrix * vertex.Tangent);
+        vertex.Bitangent = glm::normalize(tangentMatrix * vertex.Bitangent);
+    }
+}
+
+
+MeshImport Model::processMesh(aiMesh* mesh, const aiScene* scene, ModelImport& data)
 {
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
+    // Meshes are triangulated, so sizes are known before copy
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
@@ -273,7 +883,7 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
     //Indices
     for (unsigned int i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
 
         for (unsigned int j = 0; j < face.mNumIndices; j++)
             indices.push_back(face.mIndices[j]);
@@ -283,123 +893,169 @@ Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
     aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
     // Diffuse map
-    vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-    textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+    loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data, textures);
 
     // Specular map
-    vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-    textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+    loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data, textures);
     
     // Normal map
-    std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
-    textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
+    loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", data, textures);
 
     // Height map
-    std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
-    textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
-
-    return Mesh(vertices, indices, textures, mesh->mName);
+    loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", data, textures);
+
+    MeshImport imported;
+    imported.vertices = std::move(vertices);
+    imported.indices = std::move(indices);
+    imported.textures = std::move(textures);
+    imported.name = mesh->mName;
+    imported.material = material->GetName().C_Str();
+    imported.window = false;
+    return imported;
 }
 
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+void Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, const string& typeName, ModelImport& data, vector<Texture>& textures)
 {
-    vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
     {
         aiString str;
         mat->GetTexture(type, i, &str);
+        addMaterialTexture(str.C_Str(), typeName, data, textures);
+    }
+}
 
-        // Skip if textures materils are none
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); j++)
-        {
-            if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-            {
-                textures.push_back(textures_loaded[j]);
-                skip = true;
-                break;
-            }
-        }
-        if (!skip)
+
+void Model::addMaterialTexture(const string& path, const string& typeName, ModelImport& data, vector<Texture>& textures)
+{
+    // Skip if textures materils are none
+    for (unsigned int j = 0; j < data.textures.size(); j++)
+    {
+        if (data.textures[j].path == path)
         {
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), this->directory);
-            texture.type = typeName;
-            texture.path = str.C_Str();
-            textures.push_back(texture);
-            textures_loaded.push_back(texture);
+            textures.push_back(data.textures[j]);
+            return;
         }
     }
-    return textures;
+    // Until upload id is index of texture
+    Texture texture;
+    texture.id = (unsigned int)data.textures.size();
+    texture.type = typeName;
+    texture.path = path;
+    textures.push_back(texture);
+    data.textures.push_back(texture);
 }
 
 
-unsigned int Model::TextureFromFile(const char* path, const string& directory, bool gamma)
+void Model::optimizeModel(ModelImport& data)
 {
-    string filename = string(path);
-    filename = directory + '\\' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    for (auto& mesh : data.meshes)
+        mesh.window = isTransparentMesh(mesh);
 
-    int width, height, depth;
-    bool texture_alpha = false;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &depth, 0);
-    if (data)
+    // Color of material is stored in vertices, so meshes of one class differ only by textures
+    size_t count = data.meshes.size();
+    vector<size_t> group(count), firsts, vertexTotals, indexTotals;
+    for (size_t i = 0; i < count; i++)
     {
-        // Texture type 
-        GLenum format;
-        if (depth == 1)
-            format = GL_RED;
-        else if (depth == 2)
-            format = GL_RG;
-        else if (depth == 3)
-            format = GL_RGB;
-        else if (depth == 4)
+        const MeshImport& mesh = data.meshes[i];
+        auto first = find_if(firsts.begin(), firsts.end(), [&](size_t j)
         {
-            format = GL_RGBA;
-            texture_alpha = true;
-            //cout << "ALHPA" << endl;
-            //cout << filename.c_str() << endl;
-        }
-            
-        else if (depth == 0 || depth > 4) throw std::runtime_error("invalid depth");
-
-        
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        
-        
-        if (texture_alpha)
+            const MeshImport& other = data.meshes[j];
+            if (other.window != mesh.window || other.textures.size() != mesh.textures.size())
+                return false;
+            for (size_t t = 0; t < mesh.textures.size(); t++)
+            {
+                if (other.textures[t].id != mesh.textures[t].id)
+                    return false;
+            }
+            return true;
+        });
+        group[i] = first - firsts.begin();
+        if (first == firsts.end())
         {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            cout << "BIND ALPHA TEXTURE" << endl;
+            firsts.push_back(i);
+            vertexTotals.push_back(0);
+            indexTotals.push_back(0);
         }
-        else
+        vertexTotals[group[i]] += mesh.vertices.size();
+        indexTotals[group[i]] += mesh.indices.size();
+    }
+    if (firsts.size() == count)
+        return;
+
+    // Groups are numbered in order of their first meshes, first mesh is moved and grows once to size of group
+    vector<MeshImport> merged;
+    merged.reserve(firsts.size());
+    for (size_t i = 0; i < count; i++)
+    {
+        MeshImport& mesh = data.meshes[i];
+        if (firsts[group[i]] == i)
         {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            merged.push_back(std::move(mesh));
+            merged.back().vertices.reserve(vertexTotals[group[i]]);
+            merged.back().indices.reserve(indexTotals[group[i]]);
+            continue;
         }
-        
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // Merged mesh is named by material of its first mesh
+        MeshImport& target = merged[group[i]];
+        target.name = aiString(target.material);
+        unsigned int offset = (unsigned int)target.vertices.size();
+        target.vertices.insert(target.vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        for (unsigned int index : mesh.indices)
+            target.indices.push_back(offset + index);
+        vector<Vertex>().swap(mesh.vertices);
+        vector<unsigned int>().swap(mesh.indices);
+    }
+    data.meshes = std::move(merged);
+    if (data.meshes.size() != count)
+        cout << "Model " << data.path << ": " << count << " meshes merged into " << data.meshes.size() << endl;
+}
+
 
-        stbi_image_free(data);
+bool Model::isTransparentMesh(const MeshImport& mesh)
+{
+    for (auto& rule : meshClassRules)
+    {
+        if ((rule.material.empty() || rule.material == mesh.material) && (rule.name.empty() || rule.name == mesh.name.C_Str()))
+            return rule.transparent;
     }
-    else
+    return false;
+}
+
+
+unsigned int Model::TextureFromFile(const Texture& texture, uint64_t hash)
+{
+    // Other model uses the same image, its texture is uploaded already or is waiting in pipeline
+    shared_ptr<GLTexture> shared = findSharedTexture(hash);
+    if (shared)
     {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        ownedTextures.push_back(shared);
+        return shared->get();
     }
 
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+    ownedTextures.push_back(make_shared<GLTexture>(textureID));
+    registerSharedTexture(hash, ownedTextures.back());
+
+    // Format, wrap by alpha and mips are set when image is uploaded
+    TextureUploadJob job;
+    job.kind = TEXTURE_UPLOAD_MODEL;
+    job.texture = textureID;
+    job.target = GL_TEXTURE_2D;
+    job.format = GL_RGBA;
+    job.path = directory + '/' + texture.path;
+    job.owner = texture.path;
+    job.flip = false;
+    job.channels = 0;
+    job.normalMap = texture.type == "texture_normal";
+    submitTextureUpload(job);
+
     return textureID;
 }
 
-vector<Mesh> Model::getWindows()
+vector<Mesh>& Model::getWindows()
 {
     return meshes_of_windows;
 }
@@ -18,11 +18,14 @@
 #include <sstream>
 #include <iostream>
 
+#include "asset_pack.h"
+#include "gl_resource.h"
+
 /// Class that holds and use info about shaders programs.
 class ShaderGen
 {
 public:
-	unsigned int ID;///<ID of a shader program
+	GLProgram ID;///<ID of a shader program
 
 
 	/// Constructor
@@ -44,36 +47,19 @@ public:
 
 ShaderGen::ShaderGen(const char* vertexPath, const char* fragmentPath)
 {
-	std::string vertexCode;
-	std::string fragmentCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	// Read vertex and fragment shaders files
-	try
-	{
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
+	AssetData vertexCode;
+	AssetData fragmentCode;
 
-		vShaderFile.close();
-		fShaderFile.close();
-
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-	}
-	catch (std::ifstream::failure e)
+	// Read vertex and fragment shaders files, sources of pack are compiled without copy
+	if (!readAsset(vertexPath, vertexCode) || !readAsset(fragmentPath, fragmentCode))
 	{
 		std::cout << "ERROR: SHADER FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
 
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
+	const char* vertexSource = vertexCode.data ? (const char*)vertexCode.data : "";
+	const char* fragmentSource = fragmentCode.data ? (const char*)fragmentCode.data : "";
+	int vertexLength = (int)vertexCode.size;
+	int fragmentLength = (int)fragmentCode.size;
 
 	int vertexShader, fragmentShader;
 	int success;
@@ -81,7 +67,7 @@ ShaderGen::ShaderGen(const char* vertexPath, const char* fragmentPath)
 	
 	// Create vertex shader 
 	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
+	glShaderSource(vertexShader, 1, &vertexSource, &vertexLength);
 	glCompileShader(vertexShader);
 
 	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
@@ -93,7 +79,7 @@ ShaderGen::ShaderGen(const char* vertexPath, const char* fragmentPath)
 
 	// Create fragment shader 
 	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+	glShaderSource(fragmentShader, 1, &fragmentSource, &fragmentLength);
 	glCompileShader(fragmentShader);
 
 	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
@@ -104,7 +90,7 @@ ShaderGen::ShaderGen(const char* vertexPath, const char* fragmentPath)
 	}
 
 	// Create shader program
-	ID = glCreateProgram();
+	ID.create();
 	glAttachShader(ID, vertexShader);
 	glAttachShader(ID, fragmentShader);
 	glLinkProgram(ID);
@@ -0,0 +1,280 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    alloc_tracker.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Per-frame heap allocation tracker, enabled by ALLOC_TRACKER define
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <iostream>
+#include <string>
+
+#include "data.h"
+
+// Functions prototypes
+bool parseAllocArgs(int argc, char** argv);
+void initAllocTracker();
+void beginAllocFrame();
+void endAllocFrame();
+void printAllocStats();
+
+#ifdef ALLOC_TRACKER
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ALLOC_CALLER() _ReturnAddress()
+#else
+#define ALLOC_CALLER() __builtin_return_address(0)
+#endif
+
+#define N_ALLOC_SITES 1024
+#define N_ALLOC_TOP_SITES 8
+
+/// Call site of allocations
+struct AllocSite {
+    void* address;///<address return address of operator new, NULL when slot is free
+    long long count;///<count number of allocations
+    long long bytes;///<bytes allocated bytes
+};
+
+/// Tracker state
+/**
+  State has no constructor, so it is valid even for allocations of static initialization.
+  Call sites are kept in fixed table, the hook itself never allocates
+*/
+struct AllocTracker {
+    bool assertMode;///<assertMode abort on any allocation in frame after warm-up
+    bool inFrame;///<inFrame allocations are counted, from updateTime() to glfwSwapBuffers
+    long long frame;///<frame number of tracked frames
+    long long frameCount;///<frameCount allocations of current frame
+    long long frameBytes;///<frameBytes allocated bytes of current frame
+    long long lastCount;///<lastCount allocations of previous frame
+    long long lastBytes;///<lastBytes allocated bytes of previous frame
+    long long intervalCount;///<intervalCount allocations in report interval
+    long long intervalBytes;///<intervalBytes allocated bytes in report interval
+    int intervalFrames;///<intervalFrames number of frames in report interval
+    int droppedSites;///<droppedSites allocations whose site did not fit into table
+    AllocSite sites[N_ALLOC_SITES];///<sites open addressing table of call sites
+};
+AllocTracker allocTracker;
+
+// Only main thread is tracked, loader threads allocate freely
+thread_local bool allocTrackingThread = false;
+
+void recordAlloc(size_t size, void* caller);
+void* trackedAlloc(size_t size, void* caller);
+
+/// Record allocation
+/**
+  Function that counts allocation into frame and call site histogram
+
+  \param[in] size of allocation.
+  \param[in] caller return address of operator new.
+*/
+void recordAlloc(size_t size, void* caller)
+{
+    allocTracker.frameCount++;
+    allocTracker.frameBytes += size;
+
+    if (allocTracker.assertMode && allocTracker.frame >= allocWarmupFrames)
+    {
+        // Streams may allocate, so only stdio is used here
+        fprintf(stderr, "Allocation of %zu bytes in frame %lld from %p\n", size, allocTracker.frame, caller);
+        fflush(stderr);
+        abort();
+    }
+
+    size_t slot = ((size_t)caller >> 4) % N_ALLOC_SITES;
+    for (int probe = 0; probe < N_ALLOC_SITES; probe++)
+    {
+        AllocSite& site = allocTracker.sites[slot];
+        if (site.address == caller || site.address == NULL)
+        {
+            site.address = caller;
+            site.count++;
+            site.bytes += size;
+            return;
+        }
+        slot = (slot + 1) % N_ALLOC_SITES;
+    }
+    allocTracker.droppedSites++;
+}
+
+/// Tracked allocation
+/**
+  Function that allocates memory by malloc and records it inside of frame
+
+  \param[in] size of allocation.
+  \param[in] caller return address of operator new.
+*/
+void* trackedAlloc(size_t size, void* caller)
+{
+    void* ptr = malloc(size ? size : 1);
+    if (allocTrackingThread && allocTracker.inFrame)
+        recordAlloc(size, caller);
+    return ptr;
+}
+
+void* operator new(size_t size)
+{
+    void* ptr = trackedAlloc(size, ALLOC_CALLER());
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size)
+{
+    void* ptr = trackedAlloc(size, ALLOC_CALLER());
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    return trackedAlloc(size, ALLOC_CALLER());
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    return trackedAlloc(size, ALLOC_CALLER());
+}
+
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { free(ptr); }
+
+/// Parse arguments
+/**
+  Function that reads "--alloc-assert" from command line
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseAllocArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--alloc-assert")
+            allocTracker.assertMode = true;
+    }
+    return true;
+}
+
+/// Init tracker
+/**
+  Function that marks calling thread as render thread
+*/
+void initAllocTracker()
+{
+    allocTrackingThread = true;
+    cout << "Allocation tracker enabled" << (allocTracker.assertMode ? ", frames must not allocate after warm-up" : "") << endl;
+}
+
+/// Begin frame
+/**
+  Function that starts counting, it is called right after updateTime()
+*/
+void beginAllocFrame()
+{
+    allocTracker.frameCount = 0;
+    allocTracker.frameBytes = 0;
+    allocTracker.inFrame = true;
+}
+
+/// End frame
+/**
+  Function that stops counting before glfwSwapBuffers and prints report every allocReportFrames frames
+*/
+void endAllocFrame()
+{
+    allocTracker.inFrame = false;
+    allocTracker.lastCount = allocTracker.frameCount;
+    allocTracker.lastBytes = allocTracker.frameBytes;
+    allocTracker.intervalCount += allocTracker.frameCount;
+    allocTracker.intervalBytes += allocTracker.frameBytes;
+    allocTracker.intervalFrames++;
+    allocTracker.frame++;
+    if (allocTracker.intervalFrames == allocReportFrames)
+        printAllocStats();
+}
+
+/// Print statistics
+/**
+  Function that prints average allocations per frame and the most frequent call sites, then resets them.
+  Addresses are resolved by debugger or addr2line
+*/
+void printAllocStats()
+{
+    if (allocTracker.intervalFrames == 0)
+        return;
+
+    double n = allocTracker.intervalFrames;
+    char line[256];
+    snprintf(line, sizeof(line), "Heap allocations per frame, average of %d frames: %.1f (%.1f KB)",
+        allocTracker.intervalFrames, allocTracker.intervalCount / n, allocTracker.intervalBytes / n / 1024.0);
+    cout << line << endl;
+
+    // Selection of the most frequent sites, the table is small
+    AllocSite* top[N_ALLOC_TOP_SITES] = {};
+    for (auto& site : allocTracker.sites)
+    {
+        if (site.address == NULL)
+            continue;
+        for (int i = 0; i < N_ALLOC_TOP_SITES; i++)
+        {
+            if (top[i] == NULL || site.count > top[i]->count)
+            {
+                for (int j = N_ALLOC_TOP_SITES - 1; j > i; j--)
+                    top[j] = top[j - 1];
+                top[i] = &site;
+                break;
+            }
+        }
+    }
+    for (int i = 0; i < N_ALLOC_TOP_SITES && top[i]; i++)
+    {
+        snprintf(line, sizeof(line), "  %p %10.1f allocs %10.1f KB", top[i]->address, top[i]->count / n, top[i]->bytes / n / 1024.0);
+        cout << line << endl;
+    }
+    if (allocTracker.droppedSites > 0)
+        cout << "  " << allocTracker.droppedSites << " allocations without site, table is full" << endl;
+
+    for (auto& site : allocTracker.sites)
+        site = AllocSite();
+    allocTracker.intervalCount = 0;
+    allocTracker.intervalBytes = 0;
+    allocTracker.intervalFrames = 0;
+    allocTracker.droppedSites = 0;
+}
+
+#else
+// Without ALLOC_TRACKER the global allocator is not replaced
+bool parseAllocArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--alloc-assert")
+            cout << "--alloc-assert is ignored, build with ALLOC_TRACKER" << endl;
+    }
+    return true;
+}
+void initAllocTracker() {}
+void beginAllocFrame() {}
+void endAllocFrame() {}
+void printAllocStats() {}
+#endif
+
+#endif
@@ -0,0 +1,515 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    asset_bake.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Incremental bake of models and textures, outputs are keyed by hashes of their sources
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef ASSET_BAKE_H
+#define ASSET_BAKE_H
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+#include "asset_pack.h"
+#include "texture_compression.h"
+#include "Model.h"
+
+#define BAKE_VERSION 1
+
+/// Kind of baked output
+enum BakeKind {
+    BAKE_MODEL,
+    BAKE_TEXTURE
+};
+
+/// Source file of bake
+/**
+  Hash and dependencies are taken from manifest while size and time of file are unchanged
+*/
+struct BakeInput {
+    int64_t size = -1;///<size of file, -1 when file is missing
+    int64_t time = 0;///<time of modification
+    uint64_t hash = 0;///<hash of content
+    vector<string> dependencies;///<dependencies materials of model, "t:" or "n:" and name of texture of material
+    bool changed = false;///<changed size or time differs from manifest, content is hashed again
+    bool touched = false;///<touched size or time differs from manifest but content is the same
+};
+
+/// Baked file
+struct BakeOutput {
+    BakeKind kind;///<kind of output
+    string source;///<source model or image, output is next to it
+    vector<string> inputs;///<inputs files whose content makes output
+    bool normalMap = false;///<normalMap texture is normal map
+    uint64_t key = 0;///<key hash of inputs and version of tools
+    bool stale = false;///<stale output is baked
+    bool restamp = false;///<restamp only times of inputs are written into output
+    bool failed = false;///<failed output is baked again by next run
+};
+
+/// Bake state
+struct AssetBake {
+    bool enable = false;///<enable bake runs and program ends
+    unordered_map<string, BakeInput> inputs;///<inputs of this run by path
+    unordered_map<string, BakeInput> previousInputs;///<previousInputs inputs of manifest
+    unordered_map<string, uint64_t> previousKeys;///<previousKeys keys of outputs of manifest
+    vector<BakeOutput> outputs;///<outputs of this run
+    atomic<int> failed{ 0 };///<failed outputs, they are baked again by next run
+};
+AssetBake assetBake;
+
+// Functions prototypes
+bool parseBakeArgs(int argc, char** argv);
+bool bakeAssets();
+void refreshBakeInputs(const vector<string>& paths);
+void scanBakeDependencies(const string& path, const vector<unsigned char>& data, vector<string>& dependencies);
+void collectBakeOutputs(const vector<string>& models);
+void addBakeOutput(BakeOutput output, const string& extension);
+bool bakeOutput(const BakeOutput& output);
+bool restampOutput(const BakeOutput& output);
+void runBakeJobs(size_t count, const function<void(size_t)>& job);
+void readBakeManifest();
+void writeBakeManifest();
+uint64_t mixBakeKey(uint64_t key, uint64_t value);
+string directoryOf(const string& path);
+
+
+/// Parse arguments
+/**
+  Function that reads "--bake" from command line, changed models and textures are baked and program ends
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseBakeArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--bake")
+            assetBake.enable = true;
+    }
+    return true;
+}
+
+/// Bake assets
+/**
+  Function that bakes models of assets directory into binary models and their textures into compressed mip chains.
+  Dependencies go model, materials, textures. Only outputs whose key changed are baked, in parallel.
+  Sources with unchanged size and time are not read, so bake without changes only lists and stats files
+*/
+bool bakeAssets()
+{
+    auto start = chrono::steady_clock::now();
+    readBakeManifest();
+
+    vector<string> files, models;
+    listAssetFiles(assetPackSource, files);
+    sort(files.begin(), files.end());
+    for (auto& path : files)
+    {
+        if (hasExtension(path, ".obj"))
+            models.push_back(path);
+    }
+
+    // Every level of dependencies is known after files of previous level are scanned
+    refreshBakeInputs(models);
+    vector<string> materials;
+    for (auto& model : models)
+    {
+        for (auto& material : assetBake.inputs[model].dependencies)
+            materials.push_back(material);
+    }
+    refreshBakeInputs(materials);
+    collectBakeOutputs(models);
+
+    vector<BakeOutput*> work;
+    int stale = 0;
+    for (auto& output : assetBake.outputs)
+    {
+        if (output.stale || output.restamp)
+            work.push_back(&output);
+        stale += output.stale ? 1 : 0;
+    }
+    runBakeJobs(work.size(), [&](size_t i)
+    {
+        bool done = work[i]->stale ? bakeOutput(*work[i]) : restampOutput(*work[i]);
+        if (!done)
+        {
+            work[i]->failed = true;
+            assetBake.failed++;
+        }
+    });
+    writeBakeManifest();
+
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Bake: " << assetBake.outputs.size() << " outputs, " << stale << " baked, " << work.size() - stale << " restamped, "
+        << assetBake.failed << " failed in " << ms << " ms" << endl;
+    return assetBake.failed == 0;
+}
+
+/// Refresh inputs
+/**
+  Function that stats files, files changed since manifest are read, hashed and scanned for dependencies by all cores
+
+  \param[in] paths of files.
+*/
+void refreshBakeInputs(const vector<string>& paths)
+{
+    vector<pair<string, BakeInput*>> changed;
+    for (auto& path : paths)
+    {
+        if (assetBake.inputs.count(path))
+            continue;
+        BakeInput& input = assetBake.inputs[path];
+        if (!assetFileStat(path, input.size, input.time))
+        {
+            input.size = -1;
+            continue;
+        }
+        auto previous = assetBake.previousInputs.find(path);
+        if (previous != assetBake.previousInputs.end() && previous->second.size == input.size && previous->second.time == input.time)
+        {
+            input.hash = previous->second.hash;
+            input.dependencies = previous->second.dependencies;
+        }
+        else
+        {
+            input.changed = true;
+            changed.push_back({ path, &input });
+        }
+    }
+
+    runBakeJobs(changed.size(), [&](size_t i)
+    {
+        vector<unsigned char> data;
+        const string& path = changed[i].first;
+        BakeInput& input = *changed[i].second;
+        if (!readLooseFile(path, data))
+        {
+            input.size = -1;
+            return;
+        }
+        input.hash = contentHash(data.data(), data.size());
+        scanBakeDependencies(path, data, input.dependencies);
+
+        // File was only copied or checked out again
+        auto previous = assetBake.previousInputs.find(path);
+        input.touched = previous != assetBake.previousInputs.end() && previous->second.hash == input.hash;
+    });
+}
+
+/// Scan dependencies
+/**
+  Function that finds materials of model and textures of material, like Assimp does. Materials are relative
+  to model, textures are kept as written, model resolves them
+
+  \param[in] path of file.
+  \param[in] data content of file.
+  \param[out] dependencies found files.
+*/
+void scanBakeDependencies(const string& path, const vector<unsigned char>& data, vector<string>& dependencies)
+{
+    dependencies.clear();
+    bool model = hasExtension(path, ".obj");
+    if (!model && !hasExtension(path, ".mtl"))
+        return;
+
+    const char* text = (const char*)data.data();
+    size_t size = data.size();
+    for (size_t begin = 0; begin < size;)
+    {
+        const char* newline = (const char*)memchr(text + begin, '\n', size - begin);
+        size_t end = newline ? newline - text : size;
+        string line = trimLine(string(text + begin, end - begin));
+        begin = end + 1;
+
+        size_t space = line.find_first_of(" \t");
+        if (space == string::npos)
+            continue;
+        string keyword = line.substr(0, space);
+        for (auto& c : keyword)
+            c = (char)tolower((unsigned char)c);
+        string rest = trimLine(line.substr(space + 1));
+
+        if (model && keyword == "mtllib")
+            dependencies.push_back(directoryOf(path) + "/" + rest);
+        else if (!model && (keyword == "map_kd" || keyword == "map_ks" || keyword == "map_ka"))
+            dependencies.push_back("t:" + textureOptionsSkipped(rest));
+        else if (!model && (keyword == "map_bump" || keyword == "bump"))
+            dependencies.push_back("n:" + textureOptionsSkipped(rest));
+    }
+}
+
+/// Collect outputs
+/**
+  Function that creates binary model of every model and compressed chain of every texture of its materials,
+  output is stale when its key differs from manifest or it is missing
+
+  \param[in] models paths of models.
+*/
+void collectBakeOutputs(const vector<string>& models)
+{
+    vector<BakeOutput> textures;
+    vector<string> images;
+    unordered_map<string, bool> found;
+    for (auto& model : models)
+    {
+        BakeInput& source = assetBake.inputs[model];
+        if (source.size < 0)
+            continue;
+
+        BakeOutput output;
+        output.kind = BAKE_MODEL;
+        output.source = model;
+        output.inputs.push_back(model);
+        for (auto& material : source.dependencies)
+        {
+            if (assetBake.inputs[material].size >= 0)
+                output.inputs.push_back(material);
+        }
+        output.key = mixBakeKey(mixBakeKey(BAKE_VERSION, BMESH_VERSION), sizeof(Vertex));
+        addBakeOutput(output, modelBakeExtension);
+
+        // Textures are found under directory of model, texture used as normal map first stays normal map
+        for (size_t i = 1; i < output.inputs.size(); i++)
+        {
+            for (auto& dependency : assetBake.inputs[output.inputs[i]].dependencies)
+            {
+                // Windows accepts both separators, so bake runs on any system
+                string image = directoryOf(model) + "/" + dependency.substr(2);
+                replace(image.begin(), image.end(), '\\', '/');
+                if (found.count(normalizeAssetPath(image)))
+                    continue;
+                found[normalizeAssetPath(image)] = true;
+
+                BakeOutput texture;
+                texture.kind = BAKE_TEXTURE;
+                texture.source = image;
+                texture.inputs.push_back(image);
+                texture.normalMap = dependency[0] == 'n';
+                texture.key = mixBakeKey(mixBakeKey(BAKE_VERSION, BTEX_VERSION), texture.normalMap);
+                textures.push_back(texture);
+                images.push_back(image);
+            }
+        }
+    }
+
+    refreshBakeInputs(images);
+    for (auto& texture : textures)
+    {
+        if (assetBake.inputs[texture.source].size >= 0)
+            addBakeOutput(texture, textureCacheExtension);
+    }
+}
+
+/// Add output
+/**
+  Function that finishes key of output by hashes of its inputs and decides what is done with it
+
+  \param[in] output baked file.
+  \param[in] extension of output after name of source.
+*/
+void addBakeOutput(BakeOutput output, const string& extension)
+{
+    bool touched = false;
+    for (auto& path : output.inputs)
+    {
+        output.key = mixBakeKey(output.key, assetBake.inputs[path].hash);
+        touched = touched || assetBake.inputs[path].touched;
+    }
+
+    struct stat info;
+    auto previous = assetBake.previousKeys.find(output.source);
+    output.stale = previous == assetBake.previousKeys.end() || previous->second != output.key ||
+        stat((output.source + extension).c_str(), &info) != 0;
+    // Output keeps times of inputs, runtime compares them instead of hashing
+    output.restamp = !output.stale && touched;
+    assetBake.outputs.push_back(output);
+}
+
+/// Bake output
+/**
+  Function that imports model or compresses texture and writes result next to source, it runs on bake thread
+
+  \param[in] output baked file.
+*/
+bool bakeOutput(const BakeOutput& output)
+{
+    if (output.kind == BAKE_MODEL)
+    {
+        ModelImport data;
+        if (!Model::importSourceModel(output.source, data) || !Model::writeBakedModel(output.source, data, output.inputs))
+            return false;
+    }
+    else
+    {
+        // Cache of other version or format is encoded again
+        CompressedImage image;
+        remove((output.source + textureCacheExtension).c_str());
+        if (!loadCompressedTexture(output.source, output.normalMap, image))
+            return false;
+    }
+    cout << "Baked " << output.source << endl;
+    return true;
+}
+
+/// Restamp output
+/**
+  Function that writes new sizes and times of inputs into header of output whose inputs did not change content
+
+  \param[in] output baked file.
+*/
+bool restampOutput(const BakeOutput& output)
+{
+    if (output.kind == BAKE_TEXTURE)
+    {
+        fstream file(output.source + textureCacheExtension, ios::binary | ios::in | ios::out);
+        BtexHeader header;
+        if (!file.read((char*)&header, sizeof(header)) || header.magic != BTEX_MAGIC ||
+            !assetFileStat(output.source, header.sourceSize, header.sourceTime))
+            return false;
+        file.seekp(0);
+        return (bool)file.write((const char*)&header, sizeof(header));
+    }
+
+    fstream file(output.source + modelBakeExtension, ios::binary | ios::in | ios::out);
+    BmeshHeader header;
+    if (!file.read((char*)&header, sizeof(header)) || header.magic != BMESH_MAGIC || header.inputs != output.inputs.size())
+        return false;
+    vector<BmeshInput> inputs(header.inputs);
+    if (!file.read((char*)inputs.data(), inputs.size() * sizeof(BmeshInput)))
+        return false;
+    for (size_t i = 0; i < inputs.size(); i++)
+    {
+        if (inputs[i].pathLength != output.inputs[i].size() || !assetFileStat(output.inputs[i], inputs[i].size, inputs[i].time))
+            return false;
+    }
+    file.seekp(sizeof(header));
+    return (bool)file.write((const char*)inputs.data(), inputs.size() * sizeof(BmeshInput));
+}
+
+/// Run jobs
+/**
+  Function that runs jobs on all cores and waits for them
+
+  \param[in] count number of jobs.
+  \param[in] job function of job index.
+*/
+void runBakeJobs(size_t count, const function<void(size_t)>& job)
+{
+    atomic<size_t> next{ 0 };
+    size_t workers = min<size_t>(max(thread::hardware_concurrency(), 1u), count);
+    vector<thread> threads;
+    for (size_t i = 0; i < workers; i++)
+    {
+        threads.push_back(thread([&]
+        {
+            for (size_t index = next++; index < count; index = next++)
+                job(index);
+        }));
+    }
+    for (auto& worker : threads)
+        worker.join();
+}
+
+/// Read manifest
+/**
+  Function that reads inputs and output keys of previous bake, manifest of other version is ignored
+*/
+void readBakeManifest()
+{
+    ifstream file(assetBakeManifest);
+    string line;
+    if (!getline(file, line) || line != "bake\t" + to_string(BAKE_VERSION))
+        return;
+    while (getline(file, line))
+    {
+        vector<string> fields;
+        stringstream stream(line);
+        string field;
+        while (getline(stream, field, '\t'))
+            fields.push_back(field);
+
+        if (fields.size() >= 5 && fields[0] == "input")
+        {
+            BakeInput& input = assetBake.previousInputs[fields[1]];
+            input.size = strtoll(fields[2].c_str(), NULL, 10);
+            input.time = strtoll(fields[3].c_str(), NULL, 10);
+            input.hash = strtoull(fields[4].c_str(), NULL, 16);
+            input.dependencies.assign(fields.begin() + 5, fields.end());
+        }
+        else if (fields.size() == 3 && fields[0] == "output")
+            assetBake.previousKeys[fields[1]] = strtoull(fields[2].c_str(), NULL, 16);
+    }
+}
+
+/// Write manifest
+/**
+  Function that saves inputs and output keys of this bake, failed outputs are left out
+*/
+void writeBakeManifest()
+{
+    ofstream file(assetBakeManifest, ios::trunc);
+    file << "bake\t" << BAKE_VERSION << "\n";
+    for (auto& entry : assetBake.inputs)
+    {
+        if (entry.second.size < 0)
+            continue;
+        file << "input\t" << entry.first << "\t" << entry.second.size << "\t" << entry.second.time << "\t" << hex << entry.second.hash << dec;
+        for (auto& dependency : entry.second.dependencies)
+            file << "\t" << dependency;
+        file << "\n";
+    }
+    for (auto& output : assetBake.outputs)
+    {
+        if (output.failed)
+            continue;
+        file << "output\t" << output.source << "\t" << hex << output.key << dec << "\n";
+    }
+}
+
+/// Mix key
+/**
+  Function that adds value into key of output
+
+  \param[in] key of output.
+  \param[in] value added value.
+*/
+uint64_t mixBakeKey(uint64_t key, uint64_t value)
+{
+    key ^= value + 0x9E3779B97F4A7C15ull + (key << 6) + (key >> 2);
+    return key * 1099511628211ull;
+}
+
+/// Directory
+/**
+  Function that returns directory of path like Model does
+
+  \param[in] path of file.
+*/
+string directoryOf(const string& path)
+{
+    return path.substr(0, path.find_last_of("/\\"));
+}
+
+#endif
@@ -0,0 +1,949 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    asset_pack.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Single archive of assets with hashed table of contents, mapped into memory and read without copies
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <irrKlang/irrKlang.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data.h"
+#include "stb_image.h"
+
+#define APAK_MAGIC 0x4B415041
+#define APAK_VERSION 1
+#define APAK_LZ4 1
+#define LZ4_HASH_BITS 16
+
+/// Header of pack, table of contents and names are at the end of file
+struct AssetPackHeader {
+    uint32_t magic;///<magic "APAK"
+    uint32_t version;///<version of layout
+    uint32_t entries;///<entries number of files
+    uint32_t alignment;///<alignment of file data
+    uint64_t tocOffset;///<tocOffset offset of entries sorted by hash
+    uint64_t namesOffset;///<namesOffset offset of names of files
+    uint64_t namesSize;///<namesSize size of names
+};
+
+/// Entry of table of contents
+struct AssetPackEntry {
+    uint64_t hash;///<hash of normalized path
+    uint64_t offset;///<offset of data in pack
+    uint64_t size;///<size of data in pack
+    uint64_t rawSize;///<rawSize size of file
+    int64_t time;///<time of modification of file when pack was built
+    uint32_t nameOffset;///<nameOffset offset of path in names
+    uint32_t nameLength;///<nameLength length of path
+    uint32_t flags;///<flags APAK_LZ4 when data is compressed
+    uint32_t reserved;///<reserved zero
+};
+
+/// Bytes of asset
+/**
+  Data of stored file points into mapped pack, compressed and loose files are held by storage
+*/
+struct AssetData {
+    const unsigned char* data = nullptr;///<data first byte
+    size_t size = 0;///<size of asset
+    vector<unsigned char> storage;///<storage owned bytes, empty when data points into pack
+    bool packed = false;///<packed asset was found in pack
+
+    AssetData() {}
+    AssetData(const AssetData&) = delete;
+    AssetData& operator=(const AssetData&) = delete;
+    AssetData(AssetData&&) = default;
+    AssetData& operator=(AssetData&&) = default;
+};
+
+/// Pack state
+struct AssetPack {
+    string path = assetPackPath;///<path of pack
+    string buildPath;///<buildPath pack is built into it and program ends
+    const unsigned char* base = nullptr;///<base mapped pack, null when loose files are used
+    size_t size = 0;///<size of pack
+    const AssetPackEntry* entries = nullptr;///<entries sorted by hash
+    uint32_t count = 0;///<count number of entries
+    const char* names = nullptr;///<names of files
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;///<file handle of pack
+    HANDLE mapping = NULL;///<mapping of pack
+#else
+    int file = -1;///<file descriptor of pack
+#endif
+    atomic<long long> packedReads{ 0 };///<packedReads assets served from pack
+    atomic<long long> looseReads{ 0 };///<looseReads assets read from loose files
+    atomic<long long> inflatedBytes{ 0 };///<inflatedBytes bytes decompressed from pack
+};
+AssetPack assetPack;
+
+// Functions prototypes
+bool parseAssetPackArgs(int argc, char** argv);
+bool buildAssetPack(const string& output);
+void listAssetFiles(const string& directory, vector<string>& files);
+bool readLooseFile(const string& path, vector<unsigned char>& data);
+bool openAssetPack();
+void closeAssetPack();
+const AssetPackEntry* findAsset(const string& path);
+bool readAsset(const string& path, AssetData& asset);
+bool readAssetHead(const string& path, void* out, size_t bytes);
+bool assetExists(const string& path);
+bool assetFileStat(const string& path, int64_t& size, int64_t& time);
+unsigned char* loadAssetImage(const string& path, int* width, int* height, int* channels, int desiredChannels);
+void addPackedSound(irrklang::ISoundEngine* engine, const char* path);
+string normalizeAssetPath(const string& path);
+string looseFilePath(const string& path);
+uint64_t assetPathHash(const string& normalized);
+uint64_t contentHash(const unsigned char* data, size_t size);
+bool sameAssetPath(const char* name, size_t length, const string& normalized);
+bool hasExtension(const string& path, const char* extension);
+void lz4Compress(const unsigned char* source, size_t size, vector<unsigned char>& out);
+void lz4Sequence(vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength);
+void lz4Length(vector<unsigned char>& out, size_t length);
+bool lz4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* target, size_t targetSize);
+
+/// Stream of asset for Assimp
+/**
+  Stream reads from bytes of asset, so importer opens nothing when model and materials are in pack
+*/
+class AssetIOStream : public Assimp::IOStream
+{
+public:
+    explicit AssetIOStream(AssetData&& asset) : asset(std::move(asset)), position(0) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        size_t items = min(count, (asset.size - position) / size);
+        memcpy(buffer, asset.data + position, items * size);
+        position += items * size;
+        return items;
+    }
+
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t target;
+        if (origin == aiOrigin_SET)
+            target = offset;
+        else if (origin == aiOrigin_CUR)
+            target = position + offset;
+        else if (offset <= asset.size)
+            target = asset.size - offset;
+        else
+            return aiReturn_FAILURE;
+        if (target > asset.size)
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return asset.size; }
+    void Flush() override {}
+
+private:
+    AssetData asset;///<asset read by stream
+    size_t position;///<position of next read
+};
+
+/// File system of Assimp
+/**
+  Importer gets models, materials and their other files through pack, missing ones are read from disk
+*/
+class AssetIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* file) const override { return assetExists(file); }
+
+    char getOsSeparator() const override { return '/'; }
+
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override
+    {
+        AssetData asset;
+        if (strchr(mode, 'w') || strchr(mode, 'a') || !readAsset(file, asset))
+            return nullptr;
+        return new AssetIOStream(std::move(asset));
+    }
+
+    void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+
+/// Parse arguments
+/**
+  Function that reads "--build-pack out.pak" and "--pack file.pak" from command line, returns false on bad arguments
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseAssetPackArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg != "--build-pack" && arg != "--pack")
+            continue;
+
+        if (i + 1 >= argc)
+        {
+            cout << "Usage: --build-pack <out.pak> | --pack <file.pak>" << endl;
+            return false;
+        }
+        if (arg == "--build-pack")
+            assetPack.buildPath = argv[i + 1];
+        else
+            assetPack.path = argv[i + 1];
+    }
+    return true;
+}
+
+/// Build pack
+/**
+  Function that packs all files of assets directory. Data of files is aligned and kept in order of paths,
+  so files of one model lie together, file is compressed only when it saves at least 1/8 of its size
+
+  \param[in] output path of pack.
+*/
+bool buildAssetPack(const string& output)
+{
+    vector<string> files;
+    listAssetFiles(assetPackSource, files);
+    sort(files.begin(), files.end());
+
+    string temporary = output + ".tmp";
+    ofstream file(temporary, ios::binary | ios::trunc);
+    if (!file)
+    {
+        cout << "Failed to create asset pack " << output << endl;
+        return false;
+    }
+
+    AssetPackHeader header = {};
+    header.magic = APAK_MAGIC;
+    header.version = APAK_VERSION;
+    header.alignment = (uint32_t)assetPackAlignment;
+    file.write((const char*)&header, sizeof(header));
+
+    vector<AssetPackEntry> entries;
+    string names;
+    vector<unsigned char> data, compressed;
+    uint64_t offset = sizeof(header), rawBytes = 0;
+    const char padding[64] = {};
+    for (auto& path : files)
+    {
+        // Temporary files of caches being written
+        if (path.size() > 4 && path.compare(path.size() - 4, 4, ".tmp") == 0)
+            continue;
+        int64_t size, time;
+        if (!assetFileStat(path, size, time) || !readLooseFile(path, data))
+        {
+            cout << "Failed to read " << path << endl;
+            return false;
+        }
+
+        AssetPackEntry entry = {};
+        string normalized = normalizeAssetPath(path);
+        entry.hash = assetPathHash(normalized);
+        entry.rawSize = data.size();
+        entry.time = time;
+        entry.nameOffset = (uint32_t)names.size();
+        entry.nameLength = (uint32_t)normalized.size();
+        names += normalized;
+
+        lz4Compress(data.data(), data.size(), compressed);
+        const vector<unsigned char>& stored = compressed.size() <= data.size() - data.size() / 8 ? compressed : data;
+        entry.flags = &stored == &compressed ? APAK_LZ4 : 0;
+        entry.size = stored.size();
+
+        size_t pad = (size_t)((assetPackAlignment - offset % assetPackAlignment) % assetPackAlignment);
+        for (size_t written = 0; written < pad; written += sizeof(padding))
+            file.write(padding, min(sizeof(padding), pad - written));
+        offset += pad;
+        entry.offset = offset;
+        file.write((const char*)stored.data(), stored.size());
+        offset += stored.size();
+        rawBytes += data.size();
+        entries.push_back(entry);
+    }
+
+    // Same hash of two paths would make one of them unreachable
+    sort(entries.begin(), entries.end(), [](const AssetPackEntry& a, const AssetPackEntry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < entries.size(); i++)
+    {
+        if (entries[i].hash == entries[i - 1].hash)
+        {
+            cout << "Asset pack: paths " << names.substr(entries[i - 1].nameOffset, entries[i - 1].nameLength) << " and "
+                << names.substr(entries[i].nameOffset, entries[i].nameLength) << " have the same hash" << endl;
+            return false;
+        }
+    }
+
+    header.entries = (uint32_t)entries.size();
+    header.tocOffset = offset;
+    header.namesOffset = offset + entries.size() * sizeof(AssetPackEntry);
+    header.namesSize = names.size();
+    file.write((const char*)entries.data(), entries.size() * sizeof(AssetPackEntry));
+    file.write(names.data(), names.size());
+    file.seekp(0);
+    file.write((const char*)&header, sizeof(header));
+    file.close();
+    if (!file)
+    {
+        cout << "Failed to write asset pack " << output << endl;
+        return false;
+    }
+    remove(output.c_str());
+    rename(temporary.c_str(), output.c_str());
+
+    cout << "Asset pack " << output << ": " << entries.size() << " files, " << rawBytes / (1024 * 1024) << " MB -> "
+        << (header.namesOffset + header.namesSize) / (1024 * 1024) << " MB" << endl;
+    return true;
+}
+
+/// List files
+/**
+  Function that appends paths of all files under directory
+
+  \param[in] directory searched directory.
+  \param[out] files found paths.
+*/
+void listAssetFiles(const string& directory, vector<string>& files)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((directory + "/*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE)
+        return;
+    do
+    {
+        string name = found.cFileName;
+        if (name == "." || name == "..")
+            continue;
+        if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            listAssetFiles(directory + "/" + name, files);
+        else
+            files.push_back(directory + "/" + name);
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (!dir)
+        return;
+    while (dirent* found = readdir(dir))
+    {
+        string name = found->d_name;
+        if (name == "." || name == "..")
+            continue;
+        struct stat info;
+        string path = directory + "/" + name;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode))
+            listAssetFiles(path, files);
+        else
+            files.push_back(path);
+    }
+    closedir(dir);
+#endif
+}
+
+/// Read loose file
+/**
+  Function that reads whole file, returns false when it cannot be read
+
+  \param[in] path of file.
+  \param[out] data bytes of file.
+*/
+bool readLooseFile(const string& path, vector<unsigned char>& data)
+{
+    ifstream file(looseFilePath(path), ios::binary | ios::ate);
+    if (!file)
+        return false;
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    return data.empty() || (bool)file.read((char*)data.data(), data.size());
+}
+
+/// Open pack
+/**
+  Function that maps pack into memory, loose files are used when pack is missing or broken
+*/
+bool openAssetPack()
+{
+#ifdef _WIN32
+    assetPack.file = CreateFileA(assetPack.path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (assetPack.file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(assetPack.file, &size);
+    assetPack.size = (size_t)size.QuadPart;
+    assetPack.mapping = CreateFileMappingA(assetPack.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (assetPack.mapping)
+        assetPack.base = (const unsigned char*)MapViewOfFile(assetPack.mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+    assetPack.file = open(assetPack.path.c_str(), O_RDONLY);
+    if (assetPack.file < 0)
+        return false;
+    struct stat info;
+    fstat(assetPack.file, &info);
+    assetPack.size = (size_t)info.st_size;
+    void* mapped = assetPack.size ? mmap(NULL, assetPack.size, PROT_READ, MAP_PRIVATE, assetPack.file, 0) : MAP_FAILED;
+    assetPack.base = mapped == MAP_FAILED ? nullptr : (const unsigned char*)mapped;
+#endif
+
+    const AssetPackHeader* header = (const AssetPackHeader*)assetPack.base;
+    bool valid = assetPack.base && assetPack.size >= sizeof(AssetPackHeader) && header->magic == APAK_MAGIC &&
+        header->version == APAK_VERSION && header->tocOffset + (uint64_t)header->entries * sizeof(AssetPackEntry) <= header->namesOffset &&
+        header->namesOffset + header->namesSize <= assetPack.size;
+    if (valid)
+    {
+        assetPack.entries = (const AssetPackEntry*)(assetPack.base + header->tocOffset);
+        assetPack.count = header->entries;
+        assetPack.names = (const char*)(assetPack.base + header->namesOffset);
+        for (uint32_t i = 0; i < assetPack.count && valid; i++)
+        {
+            const AssetPackEntry& entry = assetPack.entries[i];
+            valid = entry.offset + entry.size <= header->tocOffset && (uint64_t)entry.nameOffset + entry.nameLength <= header->namesSize;
+        }
+    }
+    if (!valid)
+    {
+        cout << "Asset pack " << assetPack.path << " is broken, loose files are used" << endl;
+        closeAssetPack();
+        return false;
+    }
+    cout << "Asset pack " << assetPack.path << ": " << assetPack.count << " files" << endl;
+    return true;
+}
+
+/// Close pack
+/**
+  Function that unmaps pack, it is called after loaders and sounds stopped using it
+*/
+void closeAssetPack()
+{
+    if (assetPack.count > 0)
+        cout << "Asset pack: " << assetPack.packedReads << " packed reads, " << assetPack.looseReads << " loose reads, "
+            << assetPack.inflatedBytes / 1024 << " KB decompressed" << endl;
+#ifdef _WIN32
+    if (assetPack.base)
+        UnmapViewOfFile(assetPack.base);
+    if (assetPack.mapping)
+        CloseHandle(assetPack.mapping);
+    if (assetPack.file != INVALID_HANDLE_VALUE)
+        CloseHandle(assetPack.file);
+    assetPack.mapping = NULL;
+    assetPack.file = INVALID_HANDLE_VALUE;
+#else
+    if (assetPack.base)
+        munmap((void*)assetPack.base, assetPack.size);
+    if (assetPack.file >= 0)
+        close(assetPack.file);
+    assetPack.file = -1;
+#endif
+    assetPack.base = nullptr;
+    assetPack.entries = nullptr;
+    assetPack.count = 0;
+    assetPack.names = nullptr;
+}
+
+/// Find asset
+/**
+  Function that returns entry of file in pack by binary search over hashes, null when file is not packed
+
+  \param[in] path of file, separators and case do not matter.
+*/
+const AssetPackEntry* findAsset(const string& path)
+{
+    if (assetPack.count == 0)
+        return nullptr;
+    string normalized = normalizeAssetPath(path);
+    uint64_t hash = assetPathHash(normalized);
+    const AssetPackEntry* end = assetPack.entries + assetPack.count;
+    const AssetPackEntry* entry = lower_bound(assetPack.entries, end, hash,
+        [](const AssetPackEntry& a, uint64_t hash) { return a.hash < hash; });
+    if (entry == end || entry->hash != hash || !sameAssetPath(assetPack.names + entry->nameOffset, entry->nameLength, normalized))
+        return nullptr;
+    return entry;
+}
+
+/// Read asset
+/**
+  Function that returns bytes of file. Stored file of pack is not copied, compressed one is decompressed,
+  file missing in pack is read from disk. It may be called by several threads
+
+  \param[in] path of file.
+  \param[out] asset bytes of file.
+*/
+bool readAsset(const string& path, AssetData& asset)
+{
+    asset = AssetData();
+    const AssetPackEntry* entry = findAsset(path);
+    if (entry)
+    {
+        const unsigned char* stored = assetPack.base + entry->offset;
+        asset.packed = true;
+        asset.size = (size_t)entry->rawSize;
+        assetPack.packedReads++;
+        if (!(entry->flags & APAK_LZ4))
+        {
+            asset.data = stored;
+            return true;
+        }
+        asset.storage.resize(asset.size);
+        asset.data = asset.storage.data();
+        assetPack.inflatedBytes += entry->rawSize;
+        return lz4Decompress(stored, (size_t)entry->size, asset.storage.data(), asset.size);
+    }
+
+    if (!readLooseFile(path, asset.storage))
+        return false;
+    asset.data = asset.storage.data();
+    asset.size = asset.storage.size();
+    assetPack.looseReads++;
+    return true;
+}
+
+/// Read head of asset
+/**
+  Function that reads first bytes of file without reading the rest, only compressed file of pack is decompressed whole.
+  Returns false when file is missing or shorter
+
+  \param[in] path of file.
+  \param[out] out first bytes of file.
+  \param[in] bytes number of read bytes.
+*/
+bool readAssetHead(const string& path, void* out, size_t bytes)
+{
+    const AssetPackEntry* entry = findAsset(path);
+    if (entry && !(entry->flags & APAK_LZ4))
+    {
+        if (entry->rawSize < bytes)
+            return false;
+        memcpy(out, assetPack.base + entry->offset, bytes);
+        assetPack.packedReads++;
+        return true;
+    }
+    if (entry)
+    {
+        AssetData asset;
+        if (!readAsset(path, asset) || asset.size < bytes)
+            return false;
+        memcpy(out, asset.data, bytes);
+        return true;
+    }
+
+    ifstream file(looseFilePath(path), ios::binary);
+    if (!file.read((char*)out, bytes))
+        return false;
+    assetPack.looseReads++;
+    return true;
+}
+
+/// Asset exists
+/**
+  Function that returns true when file is in pack or on disk
+
+  \param[in] path of file.
+*/
+bool assetExists(const string& path)
+{
+    int64_t size, time;
+    return assetFileStat(path, size, time);
+}
+
+/// Asset stat
+/**
+  Function that returns size and modification time of file, packed file has time of building of pack.
+  Returns false when file does not exist
+
+  \param[in] path of file.
+  \param[out] size of file.
+  \param[out] time of modification.
+*/
+bool assetFileStat(const string& path, int64_t& size, int64_t& time)
+{
+    const AssetPackEntry* entry = findAsset(path);
+    if (entry)
+    {
+        size = (int64_t)entry->rawSize;
+        time = entry->time;
+        return true;
+    }
+    struct stat info;
+    if (stat(looseFilePath(path).c_str(), &info) != 0)
+        return false;
+    size = (int64_t)info.st_size;
+    time = (int64_t)info.st_mtime;
+    return true;
+}
+
+/// Load image
+/**
+  Function that decodes image of asset, result is freed by stbi_image_free like result of stbi_load
+
+  \param[in] path of image file.
+  \param[out] width of image.
+  \param[out] height of image.
+  \param[out] channels of image file.
+  \param[in] desiredChannels number of channels of result, 0 keeps channels of file.
+*/
+unsigned char* loadAssetImage(const string& path, int* width, int* height, int* channels, int desiredChannels)
+{
+    AssetData asset;
+    if (!readAsset(path, asset) || asset.size > (size_t)INT32_MAX)
+        return nullptr;
+    return stbi_load_from_memory(asset.data, (int)asset.size, width, height, channels, desiredChannels);
+}
+
+/// Add sound
+/**
+  Function that gives sound of pack to sound engine under its path, so it is played from mapped memory.
+  Sound missing in pack is loaded by engine from disk as before
+
+  \param[in] engine sound engine, may be null without audio device.
+  \param[in] path of sound file.
+*/
+void addPackedSound(irrklang::ISoundEngine* engine, const char* path)
+{
+    const AssetPackEntry* entry = findAsset(path);
+    if (!engine || !entry)
+        return;
+    if (entry->flags & APAK_LZ4)
+    {
+        AssetData asset;
+        if (readAsset(path, asset))
+            engine->addSoundSourceFromMemory((void*)asset.data, (irrklang::ik_s32)asset.size, path, true);
+        return;
+    }
+    engine->addSoundSourceFromMemory((void*)(assetPack.base + entry->offset), (irrklang::ik_s32)entry->rawSize, path, false);
+}
+
+/// Loose file path
+/**
+  Function that converts Windows separators of path to '/', materials name textures like textures\wood.png
+  and only '/' works on Linux. Windows accepts both
+
+  \param[in] path of file.
+*/
+string looseFilePath(const string& path)
+{
+    string converted = path;
+    replace(converted.begin(), converted.end(), '\\', '/');
+    return converted;
+}
+
+/// Normalize path
+/**
+  Function that converts Windows separators, removes "." and resolves ".." parts of path
+
+  \param[in] path of file.
+*/
+string normalizeAssetPath(const string& path)
+{
+    vector<string> parts;
+    string part;
+    for (size_t i = 0; i <= path.size(); i++)
+    {
+        char c = i < path.size() ? path[i] : '/';
+        if (c != '/' && c != '\\')
+        {
+            part += c;
+            continue;
+        }
+        if (part == ".." && !parts.empty() && parts.back() != "..")
+            parts.pop_back();
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        part.clear();
+    }
+
+    string normalized;
+    for (auto& name : parts)
+    {
+        if (!normalized.empty())
+            normalized += '/';
+        normalized += name;
+    }
+    return normalized;
+}
+
+/// Path hash
+/**
+  Function that returns FNV-1a hash of path, case is ignored like by file system of Windows
+
+  \param[in] normalized path of file.
+*/
+uint64_t assetPathHash(const string& normalized)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : normalized)
+    {
+        hash ^= (unsigned char)tolower((unsigned char)c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/// Content hash
+/**
+  Function that returns 64 bit hash of data, it reads 8 bytes per step
+
+  \param[in] data hashed bytes.
+  \param[in] size of data.
+*/
+uint64_t contentHash(const unsigned char* data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    return hash ^ (hash >> 32);
+}
+
+/// Same path
+/**
+  Function that compares name of pack with path ignoring case
+
+  \param[in] name of file in pack.
+  \param[in] length of name.
+  \param[in] normalized path of file.
+*/
+bool sameAssetPath(const char* name, size_t length, const string& normalized)
+{
+    if (length != normalized.size())
+        return false;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (tolower((unsigned char)name[i]) != tolower((unsigned char)normalized[i]))
+            return false;
+    }
+    return true;
+}
+
+/// Has extension
+/**
+  Function that compares extension of path ignoring case
+
+  \param[in] path of file.
+  \param[in] extension with dot.
+*/
+bool hasExtension(const string& path, const char* extension)
+{
+    size_t length = strlen(extension);
+    if (path.size() < length)
+        return false;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (tolower((unsigned char)path[path.size() - length + i]) != tolower((unsigned char)extension[i]))
+            return false;
+    }
+    return true;
+}
+
+/// LZ4 compress
+/**
+  Function that compresses data into LZ4 block by greedy search of 4 byte matches,
+  it is used only by pack builder, so speed of decompression matters more than ratio
+
+  \param[in] source data.
+  \param[in] size of data.
+  \param[out] out LZ4 block.
+*/
+void lz4Compress(const unsigned char* source, size_t size, vector<unsigned char>& out)
+{
+    out.clear();
+    out.reserve(size + size / 255 + 16);
+    vector<size_t> table((size_t)1 << LZ4_HASH_BITS, 0);
+
+    // Format needs last match to start 12 bytes and end 5 bytes before end of block
+    size_t anchor = 0, position = 0;
+    size_t matchStart = size > 12 ? size - 12 : 0;
+    size_t matchEnd = size > 5 ? size - 5 : 0;
+    while (position < matchStart)
+    {
+        uint32_t sequence;
+        memcpy(&sequence, source + position, 4);
+        size_t slot = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+        size_t candidate = table[slot];
+        table[slot] = position + 1;
+
+        uint32_t previous = 0;
+        if (candidate != 0)
+            memcpy(&previous, source + candidate - 1, 4);
+        if (candidate == 0 || position - (candidate - 1) > 65535 || previous != sequence)
+        {
+            position++;
+            continue;
+        }
+
+        size_t match = candidate - 1;
+        size_t length = 4;
+        while (position + length < matchEnd && source[match + length] == source[position + length])
+            length++;
+        lz4Sequence(out, source + anchor, position - anchor, position - match, length);
+        position += length;
+        anchor = position;
+    }
+    lz4Sequence(out, source + anchor, size - anchor, 0, 0);
+}
+
+/// LZ4 sequence
+/**
+  Function that writes literals followed by match, last sequence has no match
+
+  \param[in,out] out LZ4 block.
+  \param[in] literals first literal.
+  \param[in] literalCount number of literals.
+  \param[in] offset distance of match.
+  \param[in] matchLength length of match, 0 for last sequence.
+*/
+void lz4Sequence(vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength)
+{
+    size_t matchCode = matchLength ? matchLength - 4 : 0;
+    out.push_back((unsigned char)((min(literalCount, (size_t)15) << 4) | min(matchCode, (size_t)15)));
+    if (literalCount >= 15)
+        lz4Length(out, literalCount - 15);
+    out.insert(out.end(), literals, literals + literalCount);
+    if (matchLength == 0)
+        return;
+    out.push_back((unsigned char)(offset & 0xFF));
+    out.push_back((unsigned char)(offset >> 8));
+    if (matchCode >= 15)
+        lz4Length(out, matchCode - 15);
+}
+
+/// LZ4 length
+/**
+  Function that writes rest of length by bytes of 255
+
+  \param[in,out] out LZ4 block.
+  \param[in] length rest of length.
+*/
+void lz4Length(vector<unsigned char>& out, size_t length)
+{
+    while (length >= 255)
+    {
+        out.push_back(255);
+        length -= 255;
+    }
+    out.push_back((unsigned char)length);
+}
+
+/// LZ4 decompress
+/**
+  Function that decompresses LZ4 block, returns false when block is broken or has different size
+
+  \param[in] source LZ4 block.
+  \param[in] sourceSize size of block.
+  \param[out] target decompressed data.
+  \param[in] targetSize size of decompressed data.
+*/
+bool lz4Decompress(const unsigned char* source, size_t sourceSize, unsigned char* target, size_t targetSize)
+{
+    size_t in = 0, out = 0;
+    while (in < sourceSize)
+    {
+        unsigned char token = source[in++];
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if (in >= sourceSize)
+                    return false;
+                extra = source[in++];
+                literals += extra;
+            } while (extra == 255);
+        }
+        if (literals > sourceSize - in || literals > targetSize - out)
+            return false;
+        memcpy(target + out, source + in, literals);
+        in += literals;
+        out += literals;
+        if (in == sourceSize)
+            break;
+
+        if (sourceSize - in < 2)
+            return false;
+        size_t offset = source[in] | (source[in + 1] << 8);
+        in += 2;
+        if (offset == 0 || offset > out)
+            return false;
+        size_t length = token & 15;
+        if (length == 15)
+        {
+            unsigned char extra;
+            do
+            {
+                if (in >= sourceSize)
+                    return false;
+                extra = source[in++];
+                length += extra;
+            } while (extra == 255);
+        }
+        length += 4;
+        if (length > targetSize - out)
+            return false;
+
+        // Match may overlap bytes it writes
+        unsigned char* match = target + out - offset;
+        if (offset >= length)
+            memcpy(target + out, match, length);
+        else
+        {
+            for (size_t i = 0; i < length; i++)
+                target[out + i] = match[i];
+        }
+        out += length;
+    }
+    return out == targetSize;
+}
+
+#endif
@@ -0,0 +1,366 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    benchmark.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Deterministic benchmark which replays camera script and measures frame times
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data.h"
+#include "camera.h"
+#include "depth_prepass.h"
+
+#define N_BENCHMARK_QUERIES 4
+
+/// Camera pose in script
+struct CameraKey {
+    glm::vec3 position;///<position of camera
+    float yaw;///<yaw euler angle of camera
+    float pitch;///<pitch euler angle of camera
+};
+
+/// Part of camera script
+/**
+  Static segment holds one view, fly-through interpolates from one view to another
+*/
+struct BenchmarkSegment {
+    string name;///<name of segment in summary
+    CameraKey from;///<from pose at first frame
+    CameraKey to;///<to pose at last frame
+    int frames;///<frames number of frames in segment
+    bool prepass;///<prepass depth pre-pass is enabled in segment
+};
+
+/// Measured frame
+struct BenchmarkFrame {
+    int segment;///<segment index of segment
+    double cpuMs;///<cpuMs time of frame submission on CPU
+    double gpuMs;///<gpuMs time of frame on GPU, negative until query is read
+};
+
+/// GPU timer of one frame
+struct BenchmarkQuery {
+    unsigned int ID;///<ID of time elapsed query
+    int frame = -1;///<frame index of measured frame, -1 when query is free
+};
+
+/// Benchmark state
+struct Benchmark {
+    bool enable = false;///<enable benchmark mode
+    string csvPath;///<csvPath output of per frame times
+    vector<BenchmarkSegment> script;///<script of camera
+    vector<BenchmarkFrame> frames;///<frames measured frames
+    BenchmarkQuery queries[N_BENCHMARK_QUERIES];///<queries ring of GPU timers
+    int current = 0;///<current frame of script
+    int segment = 0;///<segment current segment
+    int segmentFrame = 0;///<segmentFrame frame inside current segment
+    double segmentSamples[2] = { 0.0, 0.0 };///<segmentSamples shaded fragments at segment start
+    long long segmentFragFrames[2] = { 0, 0 };///<segmentFragFrames measured fragment frames at segment start
+    vector<long long> shaded;///<shaded average fragments per segment, -1 if not measured
+    chrono::steady_clock::time_point frameStart;///<frameStart CPU time of frame start
+};
+Benchmark benchmark;
+
+// Functions prototypes
+bool parseBenchmarkArgs(int argc, char** argv);
+void initBenchmark();
+bool benchmarkRunning();
+void beginBenchmarkFrame(Camera& camera);
+void endBenchmarkFrame();
+void finishBenchmark();
+
+void buildBenchmarkScript();
+CameraKey interpolateKey(const CameraKey& from, const CameraKey& to, float t);
+void readBenchmarkQuery(BenchmarkQuery& query);
+void closeBenchmarkSegment();
+double percentile(vector<double> values, double p);
+void writeBenchmarkCSV();
+void printBenchmarkSummary();
+
+
+/// Parse arguments
+/**
+  Function that reads "--benchmark out.csv" from command line, returns false on bad arguments
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseBenchmarkArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) != "--benchmark")
+            continue;
+
+        if (i + 1 >= argc)
+        {
+            cout << "Usage: --benchmark <output.csv>" << endl;
+            return false;
+        }
+        benchmark.enable = true;
+        benchmark.csvPath = argv[i + 1];
+    }
+    return true;
+}
+
+/// Init benchmark
+/**
+  Function that builds camera script, creates GPU timers and switches scene to fixed clock
+*/
+void initBenchmark()
+{
+    buildBenchmarkScript();
+    for (int i = 0; i < N_BENCHMARK_QUERIES; i++)
+    {
+        glGenQueries(1, &benchmark.queries[i].ID);
+        benchmark.queries[i].frame = -1;
+    }
+    fixedTimeStep = true;
+
+    benchmark.segmentSamples[0] = fragmentStats.samples[0];
+    benchmark.segmentSamples[1] = fragmentStats.samples[1];
+    benchmark.segmentFragFrames[0] = fragmentStats.frames[0];
+    benchmark.segmentFragFrames[1] = fragmentStats.frames[1];
+
+    int total = 0;
+    for (auto& segment : benchmark.script)
+        total += segment.frames;
+    benchmark.frames.reserve(total);
+    benchmark.shaded.reserve(benchmark.script.size());
+    cout << "Benchmark: " << benchmark.script.size() << " segments, " << total << " frames" << endl;
+}
+
+/// Camera script
+/**
+  Function that builds script from static views and fly-throughs between them.
+  Whole script is played without and then with depth pre-pass
+*/
+void buildBenchmarkScript()
+{
+    const CameraKey views[4] = {
+        { staticView1Outside, staticYaw1, staticPitch1 },
+        { staticView2Outside, staticYaw2, staticPitch2 },
+        { staticView3Inside, staticYaw3, staticPitch3 },
+        { staticView4InsideKitchen, staticYaw4, staticPitch4 }
+    };
+    const string names[4] = { "view1_outside", "view2_outside", "view3_inside", "view4_kitchen" };
+
+    for (int prepass = 0; prepass < 2; prepass++)
+    {
+        string mode = prepass ? "/prepass" : "";
+        for (int i = 0; i < 4; i++)
+            benchmark.script.push_back({ names[i] + mode, views[i], views[i], benchmarkStaticFrames, prepass == 1 });
+        for (int i = 0; i < 3; i++)
+            benchmark.script.push_back({ "fly_" + names[i] + "_to_" + names[i + 1] + mode, views[i], views[i + 1],
+                benchmarkFlyFrames, prepass == 1 });
+    }
+}
+
+/// Interpolate camera
+/**
+  Function that returns pose between two keys, yaw goes by the shortest way
+
+  \param[in] from first pose.
+  \param[in] to last pose.
+  \param[in] t interpolation factor from 0 to 1.
+*/
+CameraKey interpolateKey(const CameraKey& from, const CameraKey& to, float t)
+{
+    // Smooth start and stop
+    float s = t * t * (3.0f - 2.0f * t);
+    float yawDelta = fmod(to.yaw - from.yaw + 540.0f, 360.0f) - 180.0f;
+
+    CameraKey key;
+    key.position = glm::mix(from.position, to.position, s);
+    key.yaw = from.yaw + yawDelta * s;
+    key.pitch = from.pitch + (to.pitch - from.pitch) * s;
+    return key;
+}
+
+/// Benchmark running
+/**
+  Function that returns true until all frames of script are rendered
+*/
+bool benchmarkRunning()
+{
+    return benchmark.segment < (int)benchmark.script.size();
+}
+
+/// Begin benchmark frame
+/**
+  Function that sets camera and depth pre-pass from script and starts CPU and GPU timers
+
+  \param[in] camera scene camera.
+*/
+void beginBenchmarkFrame(Camera& camera)
+{
+    BenchmarkSegment& segment = benchmark.script[benchmark.segment];
+    float t = segment.frames > 1 ? (float)benchmark.segmentFrame / (segment.frames - 1) : 0.0f;
+    CameraKey key = interpolateKey(segment.from, segment.to, t);
+    camera.setPose(key.position, key.yaw, key.pitch);
+    depthPrepassEnable = segment.prepass;
+
+    // Reuse the oldest timer, its result is a few frames old, so reading rarely waits
+    BenchmarkQuery& query = benchmark.queries[benchmark.current % N_BENCHMARK_QUERIES];
+    readBenchmarkQuery(query);
+    query.frame = benchmark.current;
+
+    benchmark.frames.push_back({ benchmark.segment, 0.0, -1.0 });
+    benchmark.frameStart = chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, query.ID);
+}
+
+/// End benchmark frame
+/**
+  Function that stops timers and moves script to next frame
+*/
+void endBenchmarkFrame()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    auto frameEnd = chrono::steady_clock::now();
+    benchmark.frames[benchmark.current].cpuMs = chrono::duration<double, milli>(frameEnd - benchmark.frameStart).count();
+
+    benchmark.current++;
+    benchmark.segmentFrame++;
+    if (benchmark.segmentFrame == benchmark.script[benchmark.segment].frames)
+    {
+        closeBenchmarkSegment();
+        benchmark.segment++;
+        benchmark.segmentFrame = 0;
+    }
+}
+
+/// Close segment
+/**
+  Function that stores average shaded fragments of finished segment
+*/
+void closeBenchmarkSegment()
+{
+    int prepass = benchmark.script[benchmark.segment].prepass;
+    double samples = fragmentStats.samples[prepass] - benchmark.segmentSamples[prepass];
+    long long frames = fragmentStats.frames[prepass] - benchmark.segmentFragFrames[prepass];
+    benchmark.shaded.push_back(frames > 0 ? (long long)(samples / frames) : -1);
+
+    for (int i = 0; i < 2; i++)
+    {
+        benchmark.segmentSamples[i] = fragmentStats.samples[i];
+        benchmark.segmentFragFrames[i] = fragmentStats.frames[i];
+    }
+}
+
+/// Read GPU timer
+/**
+  Function that reads elapsed time of query into its frame
+
+  \param[in] query GPU timer.
+*/
+void readBenchmarkQuery(BenchmarkQuery& query)
+{
+    if (query.frame < 0)
+        return;
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(query.ID, GL_QUERY_RESULT, &elapsed);
+    benchmark.frames[query.frame].gpuMs = elapsed / 1.0e6;
+    query.frame = -1;
+}
+
+/// Finish benchmark
+/**
+  Function that reads remaining timers, writes CSV and prints summary
+*/
+void finishBenchmark()
+{
+    for (int i = 0; i < N_BENCHMARK_QUERIES; i++)
+        readBenchmarkQuery(benchmark.queries[i]);
+    writeBenchmarkCSV();
+    printBenchmarkSummary();
+}
+
+/// Percentile
+/**
+  Function that returns nearest rank percentile of values
+
+  \param[in] values measured values.
+  \param[in] p percentile from 0 to 1.
+*/
+double percentile(vector<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+    sort(values.begin(), values.end());
+    int rank = (int)ceil(p * values.size()) - 1;
+    return values[max(0, min(rank, (int)values.size() - 1))];
+}
+
+/// Write CSV
+/**
+  Function that writes CPU and GPU time of every frame
+*/
+void writeBenchmarkCSV()
+{
+    ofstream file(benchmark.csvPath);
+    if (!file)
+    {
+        cout << "Failed to write benchmark to " << benchmark.csvPath << endl;
+        return;
+    }
+    file << "frame,segment,prepass,cpu_ms,gpu_ms" << endl;
+    for (unsigned int i = 0; i < benchmark.frames.size(); i++)
+    {
+        const BenchmarkFrame& frame = benchmark.frames[i];
+        const BenchmarkSegment& segment = benchmark.script[frame.segment];
+        file << i << "," << segment.name << "," << segment.prepass << ","
+             << frame.cpuMs << "," << frame.gpuMs << endl;
+    }
+    cout << "Benchmark frames saved to " << benchmark.csvPath << endl;
+}
+
+/// Print summary
+/**
+  Function that prints p50, p95, p99 and the worst frame of every segment
+*/
+void printBenchmarkSummary()
+{
+    cout << "segment                                   frames   cpu p50/p95/p99/max ms       gpu p50/p95/p99/max ms       shaded frags" << endl;
+    for (unsigned int s = 0; s < benchmark.script.size(); s++)
+    {
+        vector<double> cpu, gpu;
+        for (auto& frame : benchmark.frames)
+        {
+            if (frame.segment != (int)s)
+                continue;
+            cpu.push_back(frame.cpuMs);
+            if (frame.gpuMs >= 0.0)
+                gpu.push_back(frame.gpuMs);
+        }
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-40s %7d   %6.2f %6.2f %6.2f %6.2f   %6.2f %6.2f %6.2f %6.2f   %lld",
+            benchmark.script[s].name.c_str(), (int)cpu.size(),
+            percentile(cpu, 0.50), percentile(cpu, 0.95), percentile(cpu, 0.99), percentile(cpu, 1.0),
+            percentile(gpu, 0.50), percentile(gpu, 0.95), percentile(gpu, 0.99), percentile(gpu, 1.0),
+            s < benchmark.shaded.size() ? benchmark.shaded[s] : -1LL);
+        cout << line << endl;
+    }
+    printFragmentStats();
+}
+
+#endif
@@ -97,6 +97,16 @@ public:
    */
     void updatePosition(int NstaticView);
 
+   /// Set pose   
+   /**
+     Function places camera, used by scripted camera
+
+     \param[in] position of camera.
+     \param[in] yaw euler angle of camera.
+     \param[in] pitch euler angle of camera.
+   */
+    void setPose(glm::vec3 position, float yaw, float pitch);
+
    /// Collisions   
    /**
      Function check if camera does not go beyond the boundaries of the scene
@@ -240,6 +250,14 @@ void Camera::updatePosition(int NstaticView)
     }
 }
 
+void Camera::setPose(glm::vec3 position, float yaw, float pitch)
+{
+    Position = position;
+    Yaw = yaw;
+    Pitch = pitch;
+    updateCameraVectors();
+}
+
 bool Camera::checkCollision(glm::vec3 newPos)
 {
     // Return true if camera tries exit from the boundaries of the scene
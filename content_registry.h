@@ -0,0 +1,228 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    content_registry.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Registries of meshes and textures by hash of content, models with the same data share GL objects
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef CONTENT_REGISTRY_H
+#define CONTENT_REGISTRY_H
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "data.h"
+#include "asset_pack.h"
+#include "memory_ledger.h"
+#include "gl_resource.h"
+
+/// GPU buffers of mesh
+/**
+  Buffers are owned by all meshes with the same vertices and indices, they are released with the last one
+*/
+struct MeshBuffers {
+    GLVertexArray VAO;///<VAO vertex array of all attributes
+    GLBuffer VBO;///<VBO vertex buffer
+    GLBuffer EBO;///<EBO index buffer
+    GLVertexArray depthVAO;///<depthVAO position only stream for depth passes
+    GLBuffer positionVBO;///<positionVBO positions of position only stream
+};
+
+/// Registered mesh
+struct SharedMesh {
+    weak_ptr<MeshBuffers> buffers;///<buffers of first mesh, expired when all meshes are destroyed
+    size_t vertices;///<vertices number of vertices
+    size_t indices;///<indices number of indices
+};
+
+/// Registered texture
+struct SharedTexture {
+    weak_ptr<GLTexture> texture;///<texture of first model, expired when all models are destroyed
+    int reuses = 0;///<reuses number of models given existing texture
+};
+
+/// Hash of image file
+struct FileHash {
+    int64_t size;///<size of file when it was hashed
+    int64_t time;///<time of modification when it was hashed
+    uint64_t hash;///<hash of content
+};
+
+/// Registry state
+struct ContentRegistry {
+    unordered_map<uint64_t, SharedMesh> meshes;///<meshes by hash of vertices and indices
+    unordered_map<uint64_t, SharedTexture> textures;///<textures by hash of image file
+    mutex hashLock;///<hashLock lock of file hashes, loader threads hash images
+    unordered_map<string, FileHash> fileHashes;///<fileHashes hashes of images by normalized path
+    int sharedMeshes = 0;///<sharedMeshes meshes given existing buffers
+    long long meshBytesSaved = 0;///<meshBytesSaved size of buffers not created
+};
+ContentRegistry contentRegistry;
+
+// Functions prototypes
+uint64_t meshContentHash(const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes);
+uint64_t textureContentHash(const string& path, bool normalMap);
+shared_ptr<MeshBuffers> findSharedMesh(uint64_t hash, size_t vertices, size_t indices, long long bytes);
+void registerSharedMesh(uint64_t hash, const shared_ptr<MeshBuffers>& buffers, size_t vertices, size_t indices);
+shared_ptr<GLTexture> findSharedTexture(uint64_t hash);
+void registerSharedTexture(uint64_t hash, const shared_ptr<GLTexture>& texture);
+void printContentRegistry();
+
+
+/// Mesh hash
+/**
+  Function that returns hash of vertex and index streams, 0 is never returned
+
+  \param[in] vertices vertex stream.
+  \param[in] vertexBytes size of vertex stream.
+  \param[in] indices index stream.
+  \param[in] indexBytes size of index stream.
+*/
+uint64_t meshContentHash(const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes)
+{
+    uint64_t hash = contentHash((const unsigned char*)vertices, vertexBytes);
+    hash ^= contentHash((const unsigned char*)indices, indexBytes) * 0x9E3779B97F4A7C15ull;
+    return hash ? hash : 1;
+}
+
+/// Texture hash
+/**
+  Function that returns hash of image file and its use, normal map is another texture than color map of the same image.
+  Hash of file is kept until its size or time changes, so image shared by models is read once.
+  It runs on loader threads, returns 0 when file is missing
+
+  \param[in] path of image file.
+  \param[in] normalMap image is used as normal map.
+*/
+uint64_t textureContentHash(const string& path, bool normalMap)
+{
+    int64_t size, time;
+    if (!assetFileStat(path, size, time))
+        return 0;
+    string key = normalizeAssetPath(path);
+    uint64_t hash = 0;
+    {
+        lock_guard<mutex> guard(contentRegistry.hashLock);
+        auto found = contentRegistry.fileHashes.find(key);
+        if (found != contentRegistry.fileHashes.end() && found->second.size == size && found->second.time == time)
+            hash = found->second.hash;
+    }
+    if (hash == 0)
+    {
+        AssetData image;
+        if (!readAsset(path, image))
+            return 0;
+        hash = contentHash(image.data, image.size);
+        lock_guard<mutex> guard(contentRegistry.hashLock);
+        contentRegistry.fileHashes[key] = { size, time, hash };
+    }
+    hash ^= normalMap ? 0x6E6F726D616C6D70ull : 0;
+    return hash ? hash : 1;
+}
+
+/// Find mesh
+/**
+  Function that returns buffers of registered mesh with the same content, null when there is none
+
+  \param[in] hash of content.
+  \param[in] vertices number of vertices.
+  \param[in] indices number of indices.
+  \param[in] bytes size of buffers of mesh, counted as saved when buffers are found.
+*/
+shared_ptr<MeshBuffers> findSharedMesh(uint64_t hash, size_t vertices, size_t indices, long long bytes)
+{
+    if (hash == 0)
+        return nullptr;
+    auto found = contentRegistry.meshes.find(hash);
+    if (found == contentRegistry.meshes.end() || found->second.vertices != vertices || found->second.indices != indices)
+        return nullptr;
+    shared_ptr<MeshBuffers> buffers = found->second.buffers.lock();
+    if (!buffers)
+    {
+        contentRegistry.meshes.erase(found);
+        return nullptr;
+    }
+    contentRegistry.sharedMeshes++;
+    contentRegistry.meshBytesSaved += bytes;
+    return buffers;
+}
+
+/// Register mesh
+/**
+  Function that remembers buffers of mesh, next mesh with the same content gets them
+
+  \param[in] hash of content.
+  \param[in] buffers of mesh.
+  \param[in] vertices number of vertices.
+  \param[in] indices number of indices.
+*/
+void registerSharedMesh(uint64_t hash, const shared_ptr<MeshBuffers>& buffers, size_t vertices, size_t indices)
+{
+    if (hash != 0)
+        contentRegistry.meshes[hash] = { buffers, vertices, indices };
+}
+
+/// Find texture
+/**
+  Function that returns registered texture with the same content, null when there is none
+
+  \param[in] hash of content.
+*/
+shared_ptr<GLTexture> findSharedTexture(uint64_t hash)
+{
+    if (hash == 0)
+        return nullptr;
+    auto found = contentRegistry.textures.find(hash);
+    if (found == contentRegistry.textures.end())
+        return nullptr;
+    shared_ptr<GLTexture> texture = found->second.texture.lock();
+    if (!texture)
+    {
+        contentRegistry.textures.erase(found);
+        return nullptr;
+    }
+    found->second.reuses++;
+    return texture;
+}
+
+/// Register texture
+/**
+  Function that remembers texture of model, next model with the same image gets it
+
+  \param[in] hash of content.
+  \param[in] texture of model.
+*/
+void registerSharedTexture(uint64_t hash, const shared_ptr<GLTexture>& texture)
+{
+    if (hash != 0)
+        contentRegistry.textures[hash] = { texture, 0 };
+}
+
+/// Print registry
+/**
+  Function that prints how many meshes and textures are shared and how much video memory it saved,
+  size of texture is taken from memory ledger, so it is called after textures are uploaded
+*/
+void printContentRegistry()
+{
+    int sharedTextures = 0;
+    long long textureBytesSaved = 0;
+    for (auto& entry : contentRegistry.textures)
+    {
+        shared_ptr<GLTexture> texture = entry.second.texture.lock();
+        LedgerEntry* ledger = texture ? findLedgerEntry(LEDGER_TEXTURE, texture->get()) : nullptr;
+        sharedTextures += entry.second.reuses;
+        if (ledger)
+            textureBytesSaved += ledger->bytes * entry.second.reuses;
+    }
+    cout << "Shared content: " << contentRegistry.sharedMeshes << " meshes (" << contentRegistry.meshBytesSaved / 1024 << " KB), "
+        << sharedTextures << " textures (" << textureBytesSaved / 1024 << " KB) saved" << endl;
+}
+
+#endif
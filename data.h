@@ -20,12 +20,93 @@
 #define MY_ERROR_RET -1
 #define MY_SUCCESS_RET 0
 #define DUCK_ID 21
+#define N_SHADOW_CASCADES 3
 
 using namespace std;
 
 // Time parmetrs
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
+double sceneTime = 0.0;///< time of animations, it goes by fixed step in headless and benchmark modes
+bool fixedTimeStep = false;
+const float fixedDeltaTime = 1.0f / 60.0f;
+
+// Benchmark frames of static view and fly-through segments
+const int benchmarkStaticFrames = 120;
+const int benchmarkFlyFrames = 240;
+
+// GL statistics are printed every N frames when built with GL_STATS
+const int glStatsReportFrames = 300;
+
+// Allocation tracker prints call sites every N frames, assert mode starts after warm-up frames
+const int allocReportFrames = 300;
+const int allocWarmupFrames = 120;
+
+// Frame arena size of one frame and reserved draws of render queue
+const size_t frameArenaBytes = 256 * 1024;
+const int renderQueueReserve = 64;
+
+// Memory ledger prints the biggest objects and writes all of them into CSV
+const int ledgerTopEntries = 20;
+const char* memoryLedgerPath = "memory_ledger.csv";
+
+// Video memory budget of textures of models, mips coarser by bias than screen size needs are enough,
+// textures keep at least min size
+int textureBudgetMB = 256;
+const int textureMipBias = 1;
+const int textureMinSize = 64;
+
+// Images are decoded by at most N threads into staging buffers of size, at most bytes are copied
+// into textures per frame, reloads of evicted textures share the bytes
+const int textureDecodeThreads = 4;
+const size_t textureStagingBytes = 16 * 1024 * 1024;
+const long long textureUploadBytesPerFrame = 8 * 1024 * 1024;
+
+// Threshold of alpha test in shaders, mips of cutout textures keep share of texels passing it
+const float textureAlphaCutoff = 0.1f;
+
+// Compressed mip chains of textures of models are cached next to images with extension
+const char* textureCacheExtension = ".btex";
+
+// Models are baked next to sources, bake manifest keeps hashes of sources and keys of outputs
+const char* modelBakeExtension = ".bmesh";
+const char* assetBakeManifest = "assets.bake";
+
+// Assets are read from pack when it exists, pack is built from directory, files in it are aligned
+const char* assetPackPath = "assets.pak";
+const char* assetPackSource = "assets";
+const size_t assetPackAlignment = 64;
+
+// OBJ files are parsed by threads in chunks of size, benchmark of OBJ importers takes the best of N runs
+// and accepts differences of vertices and of tangents up to tolerances, temporaries of import are allocated
+// from arena in blocks of size
+const size_t objChunkBytes = 256 * 1024;
+const size_t importArenaBlockBytes = 4 * 1024 * 1024;
+const int objBenchmarkRuns = 3;
+const float objBenchmarkTolerance = 1e-5f;
+const float objBenchmarkTangentTolerance = 1e-3f;
+
+// Regions are prefetched when camera is closer to their doors and evicted when farther from their bounds,
+// imported models are uploaded until N ms of frame are spent. Models are imported from the nearest one,
+// model out of view waits as if it was farther, box of color stands for model until it is uploaded
+const float regionPrefetchDistance = 3.0f;
+const float regionEvictDistance = 6.0f;
+const double regionUploadMsPerFrame = 4.0;
+const float regionHiddenDistance = 10.0f;
+const glm::vec4 placeholderColor = glm::vec4(0.45f, 0.45f, 0.45f, 1.0f);
+
+// Weight of the newest frame in smoothed pass times
+const double profilerSmoothing = 0.1;
+
+// Performance overlay
+const int hudMaxVertices = 6 * 4096;
+const float hudScale = 2.0f;
+const float hudPanelWidth = 480.0f;
+const float hudGraphHeight = 60.0f;
+const float hudGraphMaxMs = 50.0f;
+
+// Framebuffer of the scene, 0 is window, headless mode renders into own framebuffer
+unsigned int sceneFramebuffer = 0;
 
 // Input parametrs
 bool firstMouse = true;
@@ -48,11 +129,20 @@ bool defaultAlpha = false;
 bool windowsAlpha = true;
 bool enableHardcode = true;
 bool disableHardcode = false;
+bool shadowsEnable = true;
+bool shadowStaticDirty = true;
+bool depthPrepassEnable = true;
+bool hudEnable = false;
+bool cullingEnable = true;
 
 // Counters
 int	NlKeyPress = 0;
 int	NfKeyPress = 0;
 int n_static_view = 0;
+bool prepassKeyDown = false;
+bool hudKeyDown = false;
+bool cullingKeyDown = false;
+bool memoryKeyDown = false;
 
 // All paths of textures, shaders, skybox, models and audio effects 
 vector<string> skyboxFacesPaths
@@ -73,6 +163,14 @@ const char* duckVSpath = "assets/shaders/robberDuckVS.txt";
 const char* duckFSpath = "assets/shaders/robberDuckFS.txt";
 const char* butterflyVSpath = "assets/shaders/butterflyVS.txt";
 const char* butterflyFSpath = "assets/shaders/butterflyFS.txt";
+const char* shadowDepthVSpath = "assets/shaders/shadowDepthVS.txt";
+const char* shadowDepthFSpath = "assets/shaders/shadowDepthFS.txt";
+const char* depthPrepassVSpath = "assets/shaders/depthPrepassVS.txt";
+const char* depthPrepassFSpath = "assets/shaders/depthPrepassFS.txt";
+const char* oitCompositeVSpath = "assets/shaders/oitCompositeVS.txt";
+const char* oitCompositeFSpath = "assets/shaders/oitCompositeFS.txt";
+const char* hudVSpath = "assets/shaders/hudVS.txt";
+const char* hudFSpath = "assets/shaders/hudFS.txt";
 
 const char* textureDuck = "assets/rubber_duck.png";
 const char* textureButterfly = "assets/textures/butterfly.png";
@@ -197,6 +295,18 @@ glm::vec3 lightDirAmbient(0.2f, 0.2f, 0.2f);
 glm::vec3 lightDirDiffuse(0.5f, 0.5f, 0.5f);
 glm::vec3 lightDirSpecular(1.0f, 1.0f, 1.0f);
 
+// Shadow parametrs
+const unsigned int SHADOW_MAP_SIZE = 2048;
+const glm::vec3 shadowCenter = glm::vec3(0.0f, 1.0f, 0.0f);
+// Half size of every cascade: rooms of the house, yard, whole scene
+const float shadowCascadeExtents[N_SHADOW_CASCADES] = { 3.5f, 6.0f, 9.5f };
+const float shadowLightDistance = 20.0f;
+const float shadowNear = 0.1f;
+const float shadowFar = 40.0f;
+const float shadowOffsetFactor = 2.0f;
+const float shadowOffsetUnits = 4.0f;
+const int shadowTextureUnit = 13;
+
 // Point light parametrs
 glm::vec3 pointLightPositions[] = {
     // First floor
@@ -320,13 +430,40 @@ const string front_windows_bottom_name = "Ground_floor_glasswall_Cube.007";
 
 const string front_window8 = "water_Cube.041";
 
-const string front_window10 = "Door_glasswall2_Cube.012";
 const string door_window_top_right_teracce = "Door_teracce4.1_Cube.054";
 const string door_window_top_right_teracce2 = "Door_teracce3.1_Cube.053";
 const string door_window_top_left_teracce = "Door_teracce2.1_Cube.052";
 const string door_window_top_left_teracce2 = "Door_teracce1.1_Cube.051";
 const string water = "water_Cube.041";
 
+/// Rule of classification of meshes of models
+struct MeshClassRule {
+    string material;///<material name of material of mesh, empty matches any
+    string name;///<name of mesh, empty matches any
+    bool transparent;///<transparent matching mesh is drawn with windows
+};
+
+// Meshes are classified at import by the first matching rule, meshes matching none are opaque
+const MeshClassRule meshClassRules[] = {
+    { "", back_window_bottom_left_name, true },
+    { "", back_window_bottom_middle_name, true },
+    { "", back_window_bottom_rightest_name, true },
+    { "", back_window_top_rightest_name, true },
+    { "", back_window_top_miidle_name, true },
+    { "", back_window_top_left_name, true },
+    { "", front_window_top_left_name, true },
+    { "", front_window_top_middle_name, true },
+    { "", front_window_top_right_name, true },
+    { "", door_window_front_left_name, true },
+    { "", front_windows_bottom_name, true },
+    { "", door_window_front_right_name, true },
+    { "", door_window_top_right_teracce, true },
+    { "", door_window_top_right_teracce2, true },
+    { "", door_window_top_left_teracce, true },
+    { "", door_window_top_left_teracce2, true },
+    { "", water, true }
+};
+
 // Butterfly parametrs
 glm::vec3 buttefrlyPos1 = glm::vec3(-9.0f, 0.0f, 0.0f);
 glm::vec3 butterflyPos2 = glm::vec3(-0.6f, 0.5f, 4.0f);
@@ -335,6 +472,7 @@ glm::vec3 stopPos = glm::vec3(0.0f);
 // Butterfly animation paramters
 glm::vec3 butterflyRot = glm::vec3(0.0f, 1.0f, 0.0f);
 float speedAnimation = 11.4f;
+const glm::ivec2 butterflySpritePattern = glm::ivec2(10, 2);
 
 // Duck parametrs
 glm::vec3 duckStartPos = glm::vec3(0.6f, 0.0f, 0.0f);
@@ -419,6 +557,20 @@ glm::vec3 modernChairPos = glm::vec3(-1.7f, 0.93f, -0.95f);
 // Police car parametrs
 glm::vec3 policeCarPos = glm::vec3(0.0f, 0.05f, -6.0f);
 
+// Rooms streamed by regions, bounds and doors are in world space
+const glm::vec3 kitchenMin = glm::vec3(-3.0f, 0.0f, -2.0f);
+const glm::vec3 kitchenMax = glm::vec3(-0.5f, 0.9f, 1.3f);
+const vector<glm::vec3> kitchenDoors{ glm::vec3(0.0f, 0.4f, 1.3f), glm::vec3(-0.5f, 0.4f, 0.0f) };
+const glm::vec3 livingRoomMin = glm::vec3(0.5f, 0.0f, -2.0f);
+const glm::vec3 livingRoomMax = glm::vec3(3.0f, 0.9f, 1.3f);
+const vector<glm::vec3> livingRoomDoors{ glm::vec3(0.0f, 0.4f, 1.3f), glm::vec3(0.5f, 0.4f, 0.0f) };
+const glm::vec3 bedroomsMin = glm::vec3(-3.0f, 0.9f, -2.0f);
+const glm::vec3 bedroomsMax = glm::vec3(3.0f, 1.9f, 1.3f);
+const vector<glm::vec3> bedroomsDoors{ glm::vec3(-1.0f, 1.3f, 1.3f), glm::vec3(1.0f, 1.3f, 1.3f), glm::vec3(0.0f, 1.0f, 0.0f) };
+const glm::vec3 terraceMin = glm::vec3(-3.0f, 0.0f, 1.3f);
+const glm::vec3 terraceMax = glm::vec3(3.0f, 0.9f, 4.0f);
+const vector<glm::vec3> terraceDoors{ glm::vec3(0.0f, 0.4f, 1.3f) };
+
 // Windows paramters
 glm::vec3 windowsPos = glm::vec3(0.0f, 0.0f, 0.0f);
 
@@ -0,0 +1,147 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    depth_prepass.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Depth pre-pass state and statistics of shaded fragments
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef DEPTH_PREPASS_H
+#define DEPTH_PREPASS_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "data.h"
+
+#define N_FRAGMENT_QUERIES 4
+
+/// Samples passed query of one frame
+struct FragmentQuery {
+    unsigned int ID;///<ID of query object
+    bool pending;///<pending query was issued and result was not read yet
+    bool prepass;///<prepass depth pre-pass was enabled in that frame
+};
+
+/// Shaded fragments of opaque pass with and without depth pre-pass
+struct FragmentStats {
+    FragmentQuery queries[N_FRAGMENT_QUERIES];///<queries ring, results are read a few frames later
+    int current = 0;///<current query in ring
+    double samples[2] = { 0.0, 0.0 };///<samples sum of shaded fragments, [0] without pre-pass, [1] with pre-pass
+    long long frames[2] = { 0, 0 };///<frames number of measured frames
+    long long lastShaded = -1;///<lastShaded shaded fragments of the latest measured frame
+};
+FragmentStats fragmentStats;
+
+// Functions prototypes
+void initFragmentStats();
+void readFragmentQuery(FragmentQuery& query);
+void beginOpaqueShading();
+void endOpaqueShading();
+void toggleDepthPrepass();
+void printFragmentStats();
+
+
+/// Init fragment statistics
+/**
+  Function that creates query objects
+*/
+void initFragmentStats()
+{
+    for (int i = 0; i < N_FRAGMENT_QUERIES; i++)
+    {
+        glGenQueries(1, &fragmentStats.queries[i].ID);
+        fragmentStats.queries[i].pending = false;
+        fragmentStats.queries[i].prepass = false;
+    }
+}
+
+/// Read query
+/**
+  Function that reads result of query if it is available, it never waits for GPU
+
+  \param[in] query samples passed query.
+*/
+void readFragmentQuery(FragmentQuery& query)
+{
+    if (!query.pending)
+        return;
+    query.pending = false;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(query.ID, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint64 shaded = 0;
+    glGetQueryObjectui64v(query.ID, GL_QUERY_RESULT, &shaded);
+    fragmentStats.samples[query.prepass] += (double)shaded;
+    fragmentStats.frames[query.prepass]++;
+    fragmentStats.lastShaded = (long long)shaded;
+}
+
+/// Begin opaque shading
+/**
+  Function that starts counting shaded fragments of opaque objects.
+  With depth pre-pass depth buffer is already filled, so only fragments equal to stored depth are shaded
+*/
+void beginOpaqueShading()
+{
+    FragmentQuery& query = fragmentStats.queries[fragmentStats.current];
+    readFragmentQuery(query);
+
+    glBeginQuery(GL_SAMPLES_PASSED, query.ID);
+    query.prepass = depthPrepassEnable;
+
+    if (depthPrepassEnable)
+    {
+        glDepthFunc(GL_LEQUAL);
+        glDepthMask(GL_FALSE);
+    }
+}
+
+/// End opaque shading
+/**
+  Function that stops counting shaded fragments and restores depth state
+*/
+void endOpaqueShading()
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    fragmentStats.queries[fragmentStats.current].pending = true;
+    fragmentStats.current = (fragmentStats.current + 1) % N_FRAGMENT_QUERIES;
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+/// Toggle depth pre-pass
+/**
+  Function that prints statistics of current mode and switch depth pre-pass
+*/
+void toggleDepthPrepass()
+{
+    printFragmentStats();
+    depthPrepassEnable = !depthPrepassEnable;
+    cout << "Depth pre-pass " << (depthPrepassEnable ? "ON" : "OFF") << endl;
+}
+
+/// Print statistics
+/**
+  Function that prints average shaded fragments per frame with and without depth pre-pass
+*/
+void printFragmentStats()
+{
+    for (int prepass = 0; prepass < 2; prepass++)
+    {
+        cout << "Shaded fragments per frame, pre-pass " << (prepass ? "ON: " : "OFF: ");
+        if (fragmentStats.frames[prepass] == 0)
+            cout << "not measured" << endl;
+        else
+            cout << (long long)(fragmentStats.samples[prepass] / fragmentStats.frames[prepass])
+                 << " (" << fragmentStats.frames[prepass] << " frames)" << endl;
+    }
+}
+
+#endif
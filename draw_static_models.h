@@ -5,7 +5,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
-#include "model.h"
+#include "Model.h"
 #include "ShaderGen.h"
 
 void draw_house(Model house, ShaderGen sceneShader)
@@ -0,0 +1,238 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    frame_arena.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Linear arena for transient data of one frame with allocator for STL containers
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "data.h"
+
+// Arenas are rotated like frames in flight, data of previous frames stay valid for a while
+#define N_FRAME_ARENAS 3
+
+/// Block of memory with bump allocation
+struct ArenaBlock {
+    char* data = NULL;///<data memory of block
+    size_t capacity = 0;///<capacity size of block in bytes
+    size_t used = 0;///<used allocated bytes
+};
+
+/// Allocation outside of block
+/**
+  Header at start of malloc memory, data follows it aligned
+*/
+struct ArenaOverflow {
+    ArenaOverflow* next;///<next older overflow of the same arena
+};
+
+/// Arena of one frame
+/**
+  Allocations which do not fit into block are served by malloc and freed at reset,
+  block is grown then, so overflow happens only in first frames
+*/
+struct FrameArenaSlot {
+    ArenaBlock block;///<block bump allocated memory
+    ArenaOverflow* overflows = NULL;///<overflows list of allocations outside of block
+    size_t overflowBytes = 0;///<overflowBytes size of overflows
+};
+
+/// Arena state
+struct FrameArena {
+    FrameArenaSlot slots[N_FRAME_ARENAS];///<slots ring of arenas
+    int current = 0;///<current arena of frame
+    size_t lastUsed = 0;///<lastUsed bytes used by previous frame
+    int grows = 0;///<grows number of block growths, reported after the frame loop
+};
+FrameArena frameArena;
+
+// Functions prototypes
+void initFrameArena(size_t bytes);
+void resetFrameArena();
+void* frameAlloc(size_t size, size_t alignment = alignof(max_align_t));
+void* arenaAlloc(ArenaBlock& block, size_t size, size_t alignment);
+ArenaBlock carveSubArena(size_t bytes);
+size_t frameArenaUsed();
+size_t frameArenaCapacity();
+void printFrameArenaStats();
+
+/// Allocator of frame arena
+/**
+  Allocator for STL containers, memory is released all at once by resetFrameArena(),
+  so containers must not outlive the frame. Only render thread allocates from it
+*/
+template <class T>
+struct FrameAllocator {
+    typedef T value_type;
+
+    FrameAllocator() {}
+    template <class U> FrameAllocator(const FrameAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        return (T*)frameAlloc(n * sizeof(T), alignof(T));
+    }
+    void deallocate(T*, size_t) {}
+};
+
+template <class T, class U>
+bool operator==(const FrameAllocator<T>&, const FrameAllocator<U>&) { return true; }
+template <class T, class U>
+bool operator!=(const FrameAllocator<T>&, const FrameAllocator<U>&) { return false; }
+
+// Vector with memory of current frame
+template <class T>
+using FrameVector = vector<T, FrameAllocator<T>>;
+
+
+/// Init arena
+/**
+  Function that allocates blocks of all frames
+
+  \param[in] bytes size of block of one frame.
+*/
+void initFrameArena(size_t bytes)
+{
+    for (auto& slot : frameArena.slots)
+    {
+        slot.block.data = (char*)malloc(bytes);
+        slot.block.capacity = bytes;
+        slot.block.used = 0;
+    }
+}
+
+/// Reset arena
+/**
+  Function that moves to the next arena of ring and releases all its allocations, it is called at frame start
+*/
+void resetFrameArena()
+{
+    frameArena.lastUsed = frameArenaUsed();
+    frameArena.current = (frameArena.current + 1) % N_FRAME_ARENAS;
+    FrameArenaSlot& slot = frameArena.slots[frameArena.current];
+
+    if (slot.overflows)
+    {
+        while (slot.overflows)
+        {
+            ArenaOverflow* next = slot.overflows->next;
+            free(slot.overflows);
+            slot.overflows = next;
+        }
+
+        // Block gets room for everything the frame needed, growth is only counted here,
+        // printing inside of frame loop would allocate
+        size_t capacity = slot.block.capacity * 2 + slot.overflowBytes;
+        free(slot.block.data);
+        slot.block.data = (char*)malloc(capacity);
+        slot.block.capacity = slot.block.data ? capacity : 0;
+        frameArena.grows++;
+
+        slot.overflowBytes = 0;
+    }
+    slot.block.used = 0;
+}
+
+/// Block allocation
+/**
+  Function that bumps pointer of block, returns NULL when block is full
+
+  \param[in] block arena block.
+  \param[in] size of allocation.
+  \param[in] alignment of allocation, power of two.
+*/
+void* arenaAlloc(ArenaBlock& block, size_t size, size_t alignment)
+{
+    uintptr_t begin = (uintptr_t)block.data + block.used;
+    uintptr_t aligned = (begin + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    size_t end = (size_t)(aligned - (uintptr_t)block.data) + size;
+    if (block.data == NULL || end > block.capacity)
+        return NULL;
+    block.used = end;
+    return (void*)aligned;
+}
+
+/// Frame allocation
+/**
+  Function that allocates memory valid until the arena is reused
+
+  \param[in] size of allocation.
+  \param[in] alignment of allocation, power of two.
+*/
+void* frameAlloc(size_t size, size_t alignment)
+{
+    FrameArenaSlot& slot = frameArena.slots[frameArena.current];
+    void* ptr = arenaAlloc(slot.block, size, alignment);
+    if (ptr)
+        return ptr;
+
+    // Block is full, data is placed after header with room for any alignment
+    ArenaOverflow* overflow = (ArenaOverflow*)malloc(sizeof(ArenaOverflow) + alignment - 1 + size);
+    if (!overflow)
+        throw std::bad_alloc();
+    overflow->next = slot.overflows;
+    slot.overflows = overflow;
+    slot.overflowBytes += size;
+    uintptr_t begin = (uintptr_t)(overflow + 1);
+    return (void*)((begin + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+/// Sub-arena
+/**
+  Function that carves block from arena of frame for worker thread, thread bumps it without locks.
+  Block is empty when arena has no room
+
+  \param[in] bytes size of block.
+*/
+ArenaBlock carveSubArena(size_t bytes)
+{
+    ArenaBlock block;
+    block.data = (char*)arenaAlloc(frameArena.slots[frameArena.current].block, bytes, alignof(max_align_t));
+    block.capacity = block.data ? bytes : 0;
+    return block;
+}
+
+/// Used memory
+/**
+  Function that returns bytes allocated in current frame
+*/
+size_t frameArenaUsed()
+{
+    const FrameArenaSlot& slot = frameArena.slots[frameArena.current];
+    return slot.block.used + slot.overflowBytes;
+}
+
+/// Capacity
+/**
+  Function that returns size of all blocks of arena
+*/
+size_t frameArenaCapacity()
+{
+    size_t capacity = 0;
+    for (auto& slot : frameArena.slots)
+        capacity += slot.block.capacity;
+    return capacity;
+}
+
+/// Print statistics
+/**
+  Function that prints growths of arena, it is called after the frame loop
+*/
+void printFrameArenaStats()
+{
+    cout << "Frame arena: " << frameArenaCapacity() / 1024 << " KB, grown " << frameArena.grows
+        << " times, last frame used " << frameArena.lastUsed / 1024 << " KB" << endl;
+}
+
+#endif
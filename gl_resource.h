@@ -0,0 +1,256 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    gl_resource.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Move-only handles of GL objects and deletion deferred until GPU finished frames using them
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef GL_RESOURCE_H
+#define GL_RESOURCE_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <vector>
+
+#include "data.h"
+#include "memory_ledger.h"
+#include "texture_residency.h"
+#include "texture_pipeline.h"
+
+/// Kind of GL object
+enum GLResourceKind {
+    GL_RESOURCE_BUFFER,
+    GL_RESOURCE_VERTEX_ARRAY,
+    GL_RESOURCE_TEXTURE,
+    GL_RESOURCE_PROGRAM,
+    GL_RESOURCE_FRAMEBUFFER,
+    GL_RESOURCE_RENDERBUFFER,
+    GL_RESOURCE_QUERY
+};
+
+/// Object waiting for deletion
+struct GLDeletion {
+    GLResourceKind kind;///<kind of object
+    unsigned int ID;///<ID of object
+};
+
+/// Objects released in one frame, they are deleted when fence of that frame is signaled
+struct GLDeletionBatch {
+    GLsync fence;///<fence inserted after last use of objects
+    vector<GLDeletion> resources;///<resources released in frame
+};
+
+/// Deletion queue state
+struct GLResources {
+    bool contextAlive = false;///<contextAlive deletions are ignored without context, it destroys everything itself
+    vector<GLDeletion> pending;///<pending objects released in current frame
+    vector<GLDeletionBatch> batches;///<batches of previous frames, the oldest first
+    long long deleted = 0;///<deleted number of deleted objects
+};
+GLResources glResources;
+
+// Functions prototypes
+void initGLResources();
+unsigned int generateGLResource(GLResourceKind kind);
+void releaseGLResource(GLResourceKind kind, unsigned int ID);
+void deleteGLResource(const GLDeletion& resource);
+void endResourceFrame();
+void collectGLResources();
+void shutdownGLResources();
+
+/// Handle of GL object
+/**
+  Handle owns one GL object and releases it into deletion queue when destroyed.
+  It cannot be copied, so only one owner exists, ownership is moved
+*/
+template <GLResourceKind Kind>
+class GLHandle
+{
+public:
+    GLHandle() : ID(0) {}
+    explicit GLHandle(unsigned int ID) : ID(ID) {}
+    ~GLHandle() { reset(); }
+
+    GLHandle(const GLHandle&) = delete;
+    GLHandle& operator=(const GLHandle&) = delete;
+
+    GLHandle(GLHandle&& other) noexcept : ID(other.release()) {}
+    GLHandle& operator=(GLHandle&& other) noexcept
+    {
+        if (this != &other)
+            reset(other.release());
+        return *this;
+    }
+
+    /// Generate object, previous one is released
+    void create() { reset(generateGLResource(Kind)); }
+
+    /// Release owned object and take new one
+    void reset(unsigned int newID = 0)
+    {
+        if (ID != 0)
+            releaseGLResource(Kind, ID);
+        ID = newID;
+    }
+
+    /// Give up ownership without deletion
+    unsigned int release()
+    {
+        unsigned int old = ID;
+        ID = 0;
+        return old;
+    }
+
+    unsigned int get() const { return ID; }
+    operator unsigned int() const { return ID; }
+
+private:
+    unsigned int ID;///<ID of owned object, 0 is none
+};
+
+typedef GLHandle<GL_RESOURCE_BUFFER> GLBuffer;
+typedef GLHandle<GL_RESOURCE_VERTEX_ARRAY> GLVertexArray;
+typedef GLHandle<GL_RESOURCE_TEXTURE> GLTexture;
+typedef GLHandle<GL_RESOURCE_PROGRAM> GLProgram;
+typedef GLHandle<GL_RESOURCE_FRAMEBUFFER> GLFramebuffer;
+typedef GLHandle<GL_RESOURCE_RENDERBUFFER> GLRenderbuffer;
+typedef GLHandle<GL_RESOURCE_QUERY> GLQuery;
+
+/// Vertex array with its buffers, it converts to VAO for drawing
+struct GLGeometry {
+    GLVertexArray VAO;///<VAO vertex array
+    GLBuffer VBO;///<VBO vertex buffer
+    GLBuffer EBO;///<EBO index buffer, may be empty
+
+    operator unsigned int() const { return VAO; }
+};
+
+
+/// Init resources
+/**
+  Function that enables deletions, it is called when GL context is current
+*/
+void initGLResources()
+{
+    glResources.contextAlive = true;
+}
+
+/// Generate object
+/**
+  Function that creates GL object of kind
+
+  \param[in] kind of object.
+*/
+unsigned int generateGLResource(GLResourceKind kind)
+{
+    unsigned int ID = 0;
+    switch (kind)
+    {
+    case GL_RESOURCE_BUFFER: glGenBuffers(1, &ID); break;
+    case GL_RESOURCE_VERTEX_ARRAY: glGenVertexArrays(1, &ID); break;
+    case GL_RESOURCE_TEXTURE: glGenTextures(1, &ID); break;
+    case GL_RESOURCE_PROGRAM: ID = glCreateProgram(); break;
+    case GL_RESOURCE_FRAMEBUFFER: glGenFramebuffers(1, &ID); break;
+    case GL_RESOURCE_RENDERBUFFER: glGenRenderbuffers(1, &ID); break;
+    case GL_RESOURCE_QUERY: glGenQueries(1, &ID); break;
+    }
+    return ID;
+}
+
+/// Release object
+/**
+  Function that puts object into queue of current frame, commands already issued may still use it
+
+  \param[in] kind of object.
+  \param[in] ID of object.
+*/
+void releaseGLResource(GLResourceKind kind, unsigned int ID)
+{
+    if (!glResources.contextAlive)
+        return;
+    glResources.pending.push_back({ kind, ID });
+}
+
+/// Delete object
+/**
+  Function that deletes GL object and removes it from memory ledger, texture budget and texture pipeline
+
+  \param[in] resource deleted object.
+*/
+void deleteGLResource(const GLDeletion& resource)
+{
+    unsigned int ID = resource.ID;
+    switch (resource.kind)
+    {
+    case GL_RESOURCE_BUFFER:
+        glDeleteBuffers(1, &ID);
+        ledgerRelease(LEDGER_BUFFER, ID);
+        break;
+    case GL_RESOURCE_VERTEX_ARRAY: glDeleteVertexArrays(1, &ID); break;
+    case GL_RESOURCE_TEXTURE:
+        glDeleteTextures(1, &ID);
+        ledgerRelease(LEDGER_TEXTURE, ID);
+        unregisterResidentTexture(ID);
+        cancelTextureUploads(ID);
+        break;
+    case GL_RESOURCE_PROGRAM: glDeleteProgram(ID); break;
+    case GL_RESOURCE_FRAMEBUFFER: glDeleteFramebuffers(1, &ID); break;
+    case GL_RESOURCE_RENDERBUFFER: glDeleteRenderbuffers(1, &ID); break;
+    case GL_RESOURCE_QUERY: glDeleteQueries(1, &ID); break;
+    }
+    glResources.deleted++;
+}
+
+/// End frame
+/**
+  Function that closes objects released in frame by fence, it is called after last command of frame
+*/
+void endResourceFrame()
+{
+    if (glResources.pending.empty())
+        return;
+    GLDeletionBatch batch;
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    batch.resources.swap(glResources.pending);
+    glResources.batches.push_back(std::move(batch));
+}
+
+/// Collect objects
+/**
+  Function that deletes objects of frames finished by GPU, it never waits
+*/
+void collectGLResources()
+{
+    int finished = 0;
+    for (auto& batch : glResources.batches)
+    {
+        GLenum status = glClientWaitSync(batch.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            break;
+        for (auto& resource : batch.resources)
+            deleteGLResource(resource);
+        glDeleteSync(batch.fence);
+        finished++;
+    }
+    if (finished > 0)
+        glResources.batches.erase(glResources.batches.begin(), glResources.batches.begin() + finished);
+}
+
+/// Shutdown
+/**
+  Function that waits for GPU and deletes all released objects, it is called before context is destroyed.
+  Handles destroyed later are ignored
+*/
+void shutdownGLResources()
+{
+    endResourceFrame();
+    glFinish();
+    collectGLResources();
+    cout << "GL objects deleted: " << glResources.deleted << endl;
+    glResources.contextAlive = false;
+}
+
+#endif
@@ -0,0 +1,277 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    gl_stats.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Counters of GL calls and state changes per frame, enabled by GL_STATS define
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef GL_STATS_H
+#define GL_STATS_H
+
+#include <glad/glad.h>
+
+#include "data.h"
+#include "profiler.h"
+
+#ifdef GL_STATS
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+/// Counters of one pass
+struct GLCounters {
+    long long draws = 0;///<draws number of draw calls
+    long long triangles = 0;///<triangles number of drawn triangles
+    long long programs = 0;///<programs number of glUseProgram calls
+    long long textures = 0;///<textures number of glBindTexture calls
+    long long vertexArrays = 0;///<vertexArrays number of glBindVertexArray calls
+    long long uniforms = 0;///<uniforms number of glUniform* calls
+    long long uniformLocations = 0;///<uniformLocations number of glGetUniformLocation calls
+    long long bufferBytes = 0;///<bufferBytes bytes uploaded into buffers
+    long long textureBytes = 0;///<textureBytes bytes uploaded into textures
+};
+
+/// Counters of pass, pass is the innermost profiler scope
+struct GLPassCounters {
+    const char* pass;///<pass name of profiler scope
+    GLCounters counters;///<counters of pass
+};
+
+/// Statistics state
+struct GLStats {
+    vector<GLPassCounters> passes;///<passes counters summed over report interval
+    GLCounters frame;///<frame counters of current frame
+    GLCounters lastFrame;///<lastFrame counters of previous frame
+    int frames = 0;///<frames number of frames in report interval
+    GLuint unpackBuffer = 0;///<unpackBuffer bound pixel unpack buffer, textures are uploaded from it
+};
+GLStats glStats;
+
+// Functions prototypes
+void installGLStats();
+void beginGLStatsFrame();
+void printGLStats();
+GLCounters& glStatsPass();
+void addGLCounters(GLCounters& sum, const GLCounters& add);
+long long primitivesOf(GLenum mode, GLsizei count);
+long long pixelBytes(GLenum format, GLenum type);
+
+/// Pass counters
+/**
+  Function that returns counters of current profiler scope
+*/
+GLCounters& glStatsPass()
+{
+    for (auto& pass : glStats.passes)
+    {
+        if (pass.pass == profilerScope)
+            return pass.counters;
+    }
+    glStats.passes.push_back({ profilerScope, GLCounters() });
+    return glStats.passes.back().counters;
+}
+
+/// Primitives
+/**
+  Function that returns number of triangles of draw call
+
+  \param[in] mode primitive type.
+  \param[in] count number of vertices.
+*/
+long long primitivesOf(GLenum mode, GLsizei count)
+{
+    if (mode == GL_TRIANGLES)
+        return count / 3;
+    if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+        return count > 2 ? count - 2 : 0;
+    return 0;
+}
+
+/// Pixel size
+/**
+  Function that returns bytes of one uploaded pixel
+
+  \param[in] format of pixels.
+  \param[in] type of components.
+*/
+long long pixelBytes(GLenum format, GLenum type)
+{
+    long long components = 4;
+    if (format == GL_RED || format == GL_DEPTH_COMPONENT)
+        components = 1;
+    else if (format == GL_RG)
+        components = 2;
+    else if (format == GL_RGB)
+        components = 3;
+    if (type == GL_FLOAT)
+        return components * 4;
+    if (type == GL_HALF_FLOAT)
+        return components * 2;
+    return components;
+}
+
+// Every hook counts call into frame and pass counters and calls real function
+#define GL_STATS_COUNT(counter, value) \
+    { glStats.frame.counter += (value); glStatsPass().counter += (value); }
+
+#define GL_STATS_HOOK(name, params, args, counting) \
+    decltype(glad_##name) real_##name = NULL; \
+    void APIENTRY hook_##name params { counting; real_##name args; }
+
+#define GL_STATS_INSTALL(name) \
+    real_##name = glad_##name; glad_##name = hook_##name;
+
+GL_STATS_HOOK(glDrawArrays, (GLenum mode, GLint first, GLsizei count), (mode, first, count),
+    GL_STATS_COUNT(draws, 1) GL_STATS_COUNT(triangles, primitivesOf(mode, count)))
+GL_STATS_HOOK(glDrawElements, (GLenum mode, GLsizei count, GLenum type, const void* indices), (mode, count, type, indices),
+    GL_STATS_COUNT(draws, 1) GL_STATS_COUNT(triangles, primitivesOf(mode, count)))
+GL_STATS_HOOK(glUseProgram, (GLuint program), (program),
+    GL_STATS_COUNT(programs, 1))
+GL_STATS_HOOK(glBindTexture, (GLenum target, GLuint texture), (target, texture),
+    GL_STATS_COUNT(textures, 1))
+GL_STATS_HOOK(glBindVertexArray, (GLuint array), (array),
+    GL_STATS_COUNT(vertexArrays, 1))
+GL_STATS_HOOK(glUniform1i, (GLint location, GLint v0), (location, v0),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniform1f, (GLint location, GLfloat v0), (location, v0),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniform2f, (GLint location, GLfloat v0, GLfloat v1), (location, v0, v1),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniform2fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniform3fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniform4fv, (GLint location, GLsizei count, const GLfloat* value), (location, count, value),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glUniformMatrix4fv, (GLint location, GLsizei count, GLboolean transpose, const GLfloat* value),
+    (location, count, transpose, value),
+    GL_STATS_COUNT(uniforms, 1))
+GL_STATS_HOOK(glBindBuffer, (GLenum target, GLuint buffer), (target, buffer),
+    if (target == GL_PIXEL_UNPACK_BUFFER) glStats.unpackBuffer = buffer)
+GL_STATS_HOOK(glBufferData, (GLenum target, GLsizeiptr size, const void* data, GLenum usage), (target, size, data, usage),
+    if (data) GL_STATS_COUNT(bufferBytes, size))
+GL_STATS_HOOK(glBufferSubData, (GLenum target, GLintptr offset, GLsizeiptr size, const void* data), (target, offset, size, data),
+    GL_STATS_COUNT(bufferBytes, size))
+GL_STATS_HOOK(glTexImage2D, (GLenum target, GLint level, GLint internalformat, GLsizei width, GLsizei height,
+    GLint border, GLenum format, GLenum type, const void* pixels),
+    (target, level, internalformat, width, height, border, format, type, pixels),
+    if (pixels || glStats.unpackBuffer) GL_STATS_COUNT(textureBytes, (long long)width * height * pixelBytes(format, type)))
+GL_STATS_HOOK(glTexSubImage2D, (GLenum target, GLint level, GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+    GLenum format, GLenum type, const void* pixels),
+    (target, level, xoffset, yoffset, width, height, format, type, pixels),
+    GL_STATS_COUNT(textureBytes, (long long)width * height * pixelBytes(format, type)))
+GL_STATS_HOOK(glCompressedTexImage2D, (GLenum target, GLint level, GLenum internalformat, GLsizei width, GLsizei height,
+    GLint border, GLsizei imageSize, const void* data),
+    (target, level, internalformat, width, height, border, imageSize, data),
+    if (data || glStats.unpackBuffer) GL_STATS_COUNT(textureBytes, imageSize))
+
+// The only hooked function with result
+decltype(glad_glGetUniformLocation) real_glGetUniformLocation = NULL;
+GLint APIENTRY hook_glGetUniformLocation(GLuint program, const GLchar* name)
+{
+    GL_STATS_COUNT(uniformLocations, 1)
+    return real_glGetUniformLocation(program, name);
+}
+
+/// Install hooks
+/**
+  Function that replaces loaded glad pointers by counting hooks, it is called after glad is loaded
+*/
+void installGLStats()
+{
+    GL_STATS_INSTALL(glDrawArrays)
+    GL_STATS_INSTALL(glDrawElements)
+    GL_STATS_INSTALL(glUseProgram)
+    GL_STATS_INSTALL(glBindTexture)
+    GL_STATS_INSTALL(glBindVertexArray)
+    GL_STATS_INSTALL(glUniform1i)
+    GL_STATS_INSTALL(glUniform1f)
+    GL_STATS_INSTALL(glUniform2f)
+    GL_STATS_INSTALL(glUniform2fv)
+    GL_STATS_INSTALL(glUniform3fv)
+    GL_STATS_INSTALL(glUniform4fv)
+    GL_STATS_INSTALL(glUniformMatrix4fv)
+    GL_STATS_INSTALL(glBindBuffer)
+    GL_STATS_INSTALL(glBufferData)
+    GL_STATS_INSTALL(glBufferSubData)
+    GL_STATS_INSTALL(glTexImage2D)
+    GL_STATS_INSTALL(glTexSubImage2D)
+    GL_STATS_INSTALL(glCompressedTexImage2D)
+    GL_STATS_INSTALL(glGetUniformLocation)
+    cout << "GL statistics enabled" << endl;
+}
+
+/// Sum counters
+/**
+  Function that adds counters to sum
+
+  \param[in] sum result counters.
+  \param[in] add added counters.
+*/
+void addGLCounters(GLCounters& sum, const GLCounters& add)
+{
+    sum.draws += add.draws;
+    sum.triangles += add.triangles;
+    sum.programs += add.programs;
+    sum.textures += add.textures;
+    sum.vertexArrays += add.vertexArrays;
+    sum.uniforms += add.uniforms;
+    sum.uniformLocations += add.uniformLocations;
+    sum.bufferBytes += add.bufferBytes;
+    sum.textureBytes += add.textureBytes;
+}
+
+/// Begin frame
+/**
+  Function that closes counters of previous frame and prints report every glStatsReportFrames frames
+*/
+void beginGLStatsFrame()
+{
+    glStats.lastFrame = glStats.frame;
+    glStats.frame = GLCounters();
+    glStats.frames++;
+    if (glStats.frames == glStatsReportFrames)
+        printGLStats();
+}
+
+/// Print statistics
+/**
+  Function that prints average counters per frame of every pass and resets them
+*/
+void printGLStats()
+{
+    if (glStats.frames == 0)
+        return;
+
+    GLCounters total;
+    cout << "GL calls per frame, average of " << glStats.frames << " frames" << endl;
+    cout << "pass                      draws  triangles  programs  textures  VAOs  uniforms  locations  buffer KB  texture KB" << endl;
+    for (auto& pass : glStats.passes)
+    {
+        const GLCounters& c = pass.counters;
+        double n = glStats.frames;
+        char line[256];
+        snprintf(line, sizeof(line), "%-24s %6.0f %10.0f %9.0f %9.0f %5.0f %9.0f %10.0f %10.1f %11.1f",
+            pass.pass, c.draws / n, c.triangles / n, c.programs / n, c.textures / n, c.vertexArrays / n,
+            c.uniforms / n, c.uniformLocations / n, c.bufferBytes / n / 1024.0, c.textureBytes / n / 1024.0);
+        cout << line << endl;
+        addGLCounters(total, c);
+    }
+    cout << "total: " << total.draws / glStats.frames << " draws, " << total.uniformLocations / glStats.frames
+         << " uniform lookups per frame" << endl;
+
+    glStats.passes.clear();
+    glStats.frames = 0;
+}
+
+#else
+// Without GL_STATS statistics cost nothing
+void installGLStats() {}
+void beginGLStatsFrame() {}
+void printGLStats() {}
+#endif
+
+#endif
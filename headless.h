@@ -0,0 +1,285 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    headless.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Offscreen rendering without display through EGL context and framebuffer
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include "data.h"
+
+/// Headless run parametrs
+struct HeadlessRun {
+    bool enable = false;///<enable render without window
+    int frames = 0;///<frames number of rendered frames before exit
+    int frame = 0;///<frame current frame
+    string output;///<output path of .ppm file with the last frame, empty to skip
+    unsigned int colorRBO = 0;///<colorRBO color of offscreen framebuffer
+    unsigned int depthRBO = 0;///<depthRBO depth and stencil of offscreen framebuffer
+#ifdef __linux__
+    EGLDisplay display = EGL_NO_DISPLAY;///<display of EGL
+    EGLContext context = EGL_NO_CONTEXT;///<context of EGL
+    EGLSurface surface = EGL_NO_SURFACE;///<surface pbuffer or none for surfaceless context
+#endif
+};
+HeadlessRun headlessRun;
+
+// Functions prototypes
+bool parseHeadlessArgs(int argc, char** argv);
+bool initHeadless(int width, int height);
+bool headlessRunning();
+void headlessFrameDone();
+void saveFramePPM(const string& path, int width, int height);
+void terminateHeadless();
+bool createHeadlessContext(int width, int height);
+void createHeadlessFramebuffer(int width, int height);
+
+
+/// Parse arguments
+/**
+  Function that reads "--headless N [out.ppm]" from command line, returns false on bad arguments
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseHeadlessArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) != "--headless")
+            continue;
+
+        if (i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+        {
+            cout << "Usage: --headless <frames> [output.ppm]" << endl;
+            return false;
+        }
+        headlessRun.enable = true;
+        headlessRun.frames = atoi(argv[i + 1]);
+        if (i + 2 < argc && argv[i + 2][0] != '-')
+            headlessRun.output = argv[i + 2];
+    }
+    return true;
+}
+
+/// Init headless
+/**
+  Function that creates context without window, loads OpenGl functions and framebuffer
+  which replaces default framebuffer, returns false on error
+
+  \param[in] width of framebuffer.
+  \param[in] height of framebuffer.
+*/
+bool initHeadless(int width, int height)
+{
+    if (!createHeadlessContext(width, height))
+        return false;
+    createHeadlessFramebuffer(width, height);
+    glViewport(0, 0, width, height);
+    fixedTimeStep = true;
+    return true;
+}
+
+#ifdef __linux__
+/// Headless context
+/**
+  Function that creates OpenGl 3.3 core context by EGL. Surfaceless platform of Mesa
+  is preferred, default display with pbuffer is used otherwise
+
+  \param[in] width of pbuffer.
+  \param[in] height of pbuffer.
+*/
+bool createHeadlessContext(int width, int height)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    bool surfaceless = false;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (getPlatformDisplay)
+    {
+        headlessRun.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        surfaceless = headlessRun.display != EGL_NO_DISPLAY;
+    }
+#endif
+    if (headlessRun.display == EGL_NO_DISPLAY)
+        headlessRun.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major, minor;
+    if (headlessRun.display == EGL_NO_DISPLAY || !eglInitialize(headlessRun.display, &major, &minor))
+    {
+        cout << "Failed to initialize EGL" << endl;
+        return false;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24, EGL_STENCIL_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint nConfigs = 0;
+    if (!eglChooseConfig(headlessRun.display, configAttribs, &config, 1, &nConfigs) || nConfigs == 0)
+    {
+        cout << "Failed to choose EGL config" << endl;
+        return false;
+    }
+
+    if (!surfaceless)
+    {
+        const EGLint pbufferAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        headlessRun.surface = eglCreatePbufferSurface(headlessRun.display, config, pbufferAttribs);
+        if (headlessRun.surface == EGL_NO_SURFACE)
+        {
+            cout << "Failed to create EGL pbuffer" << endl;
+            return false;
+        }
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    headlessRun.context = eglCreateContext(headlessRun.display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (headlessRun.context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(headlessRun.display, headlessRun.surface, headlessRun.surface, headlessRun.context))
+    {
+        cout << "Failed to create EGL context" << endl;
+        return false;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        return false;
+    }
+    cout << "Headless renderer: " << glGetString(GL_RENDERER) << (surfaceless ? " (surfaceless)" : " (pbuffer)") << endl;
+    return true;
+}
+
+/// Terminate headless
+/**
+  Function that destroys EGL context
+*/
+void terminateHeadless()
+{
+    eglMakeCurrent(headlessRun.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (headlessRun.context != EGL_NO_CONTEXT)
+        eglDestroyContext(headlessRun.display, headlessRun.context);
+    if (headlessRun.surface != EGL_NO_SURFACE)
+        eglDestroySurface(headlessRun.display, headlessRun.surface);
+    eglTerminate(headlessRun.display);
+}
+#else
+bool createHeadlessContext(int width, int height)
+{
+    cout << "Headless rendering is supported only on Linux" << endl;
+    return false;
+}
+
+void terminateHeadless()
+{
+}
+#endif
+
+/// Headless framebuffer
+/**
+  Function that creates framebuffer with color, depth and stencil, all passes render into it
+  instead of default framebuffer
+
+  \param[in] width of framebuffer.
+  \param[in] height of framebuffer.
+*/
+void createHeadlessFramebuffer(int width, int height)
+{
+    glGenRenderbuffers(1, &headlessRun.colorRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessRun.colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &headlessRun.depthRBO);
+    glBindRenderbuffer(GL_RENDERBUFFER, headlessRun.depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glGenFramebuffers(1, &sceneFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessRun.colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, headlessRun.depthRBO);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        cout << "ERROR: HEADLESS FRAMEBUFFER NOT COMPLETE" << endl;
+}
+
+/// Headless running
+/**
+  Function that returns true until all requested frames are rendered
+*/
+bool headlessRunning()
+{
+    return headlessRun.frame < headlessRun.frames;
+}
+
+/// Headless frame done
+/**
+  Function that finishes frame instead of swapping buffers and saves the last frame
+*/
+void headlessFrameDone()
+{
+    glFinish();
+    headlessRun.frame++;
+    if (!headlessRunning() && !headlessRun.output.empty())
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        saveFramePPM(headlessRun.output, viewport[2], viewport[3]);
+    }
+}
+
+/// Save frame
+/**
+  Function that reads color of scene framebuffer and writes it as binary .ppm
+
+  \param[in] path of output file.
+  \param[in] width of frame.
+  \param[in] height of frame.
+*/
+void saveFramePPM(const string& path, int width, int height)
+{
+    vector<unsigned char> pixels(width * height * 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    ofstream file(path, ios::binary);
+    if (!file)
+    {
+        cout << "Failed to write frame to " << path << endl;
+        return;
+    }
+    file << "P6\n" << width << " " << height << "\n255\n";
+    // OpenGl rows go from bottom to top
+    for (int y = height - 1; y >= 0; y--)
+        file.write((const char*)&pixels[y * width * 3], width * 3);
+    cout << "Frame saved to " << path << endl;
+}
+
+#endif
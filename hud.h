@@ -0,0 +1,395 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    hud.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Performance overlay drawn by one batched draw call from baked font atlas
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef HUD_H
+#define HUD_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "data.h"
+#include "ShaderGen.h"
+#include "profiler.h"
+#include "gl_stats.h"
+#include "alloc_tracker.h"
+#include "render_queue.h"
+#include "regions.h"
+#include "memory_ledger.h"
+
+#define N_HUD_GRAPH 120
+#define HUD_GLYPH_FIRST 32
+#define HUD_GLYPH_COUNT 64
+#define HUD_ATLAS_COLUMNS 16
+#define HUD_CELL_WIDTH 6
+#define HUD_CELL_HEIGHT 8
+
+/// Vertex of overlay
+struct HudVertex {
+    float x, y;///<x, y position in pixels from top left corner
+    float u, v;///<u, v coordinates in font atlas
+    float r, g, b, a;///<r, g, b, a color
+};
+
+/// Overlay state
+struct Hud {
+    unsigned int VAO;///<VAO of overlay
+    unsigned int VBO;///<VBO streamed vertices
+    unsigned int atlas;///<atlas texture of font
+    unsigned int program;///<program shader program of overlay
+    int atlasWidth;///<atlasWidth width of atlas in texels
+    int atlasHeight;///<atlasHeight height of atlas in texels
+    vector<HudVertex> vertices;///<vertices batch of current frame
+    float frameTimes[N_HUD_GRAPH];///<frameTimes graph of frame times in ms
+    int graphPos = 0;///<graphPos next position in graph
+    chrono::steady_clock::time_point lastFrame;///<lastFrame time of previous overlay
+};
+Hud hud;
+
+// 5x7 glyphs of ASCII 32..95, every byte is one row, bit 4 is the left column
+const unsigned char hudFont[HUD_GLYPH_COUNT][7] = {
+    {0x00,0x00,0x00,0x00,0x00,0x00,0x00}, {0x04,0x04,0x04,0x04,0x00,0x00,0x04}, // space !
+    {0x0A,0x0A,0x0A,0x00,0x00,0x00,0x00}, {0x0A,0x0A,0x1F,0x0A,0x1F,0x0A,0x0A}, // " #
+    {0x04,0x0F,0x14,0x0E,0x05,0x1E,0x04}, {0x18,0x19,0x02,0x04,0x08,0x13,0x03}, // $ %
+    {0x0C,0x12,0x14,0x08,0x15,0x12,0x0D}, {0x0C,0x04,0x08,0x00,0x00,0x00,0x00}, // & '
+    {0x02,0x04,0x08,0x08,0x08,0x04,0x02}, {0x08,0x04,0x02,0x02,0x02,0x04,0x08}, // ( )
+    {0x00,0x04,0x15,0x0E,0x15,0x04,0x00}, {0x00,0x04,0x04,0x1F,0x04,0x04,0x00}, // * +
+    {0x00,0x00,0x00,0x00,0x0C,0x04,0x08}, {0x00,0x00,0x00,0x1F,0x00,0x00,0x00}, // , -
+    {0x00,0x00,0x00,0x00,0x00,0x0C,0x0C}, {0x00,0x01,0x02,0x04,0x08,0x10,0x00}, // . /
+    {0x0E,0x11,0x13,0x15,0x19,0x11,0x0E}, {0x04,0x0C,0x04,0x04,0x04,0x04,0x0E}, // 0 1
+    {0x0E,0x11,0x01,0x02,0x04,0x08,0x1F}, {0x1F,0x02,0x04,0x02,0x01,0x11,0x0E}, // 2 3
+    {0x02,0x06,0x0A,0x12,0x1F,0x02,0x02}, {0x1F,0x10,0x1E,0x01,0x01,0x11,0x0E}, // 4 5
+    {0x06,0x08,0x10,0x1E,0x11,0x11,0x0E}, {0x1F,0x01,0x02,0x04,0x08,0x08,0x08}, // 6 7
+    {0x0E,0x11,0x11,0x0E,0x11,0x11,0x0E}, {0x0E,0x11,0x11,0x0F,0x01,0x02,0x0C}, // 8 9
+    {0x00,0x0C,0x0C,0x00,0x0C,0x0C,0x00}, {0x00,0x0C,0x0C,0x00,0x0C,0x04,0x08}, // : ;
+    {0x02,0x04,0x08,0x10,0x08,0x04,0x02}, {0x00,0x00,0x1F,0x00,0x1F,0x00,0x00}, // < =
+    {0x08,0x04,0x02,0x01,0x02,0x04,0x08}, {0x0E,0x11,0x01,0x02,0x04,0x00,0x04}, // > ?
+    {0x0E,0x11,0x01,0x0D,0x15,0x15,0x0E}, {0x0E,0x11,0x11,0x11,0x1F,0x11,0x11}, // @ A
+    {0x1E,0x11,0x11,0x1E,0x11,0x11,0x1E}, {0x0E,0x11,0x10,0x10,0x10,0x11,0x0E}, // B C
+    {0x1C,0x12,0x11,0x11,0x11,0x12,0x1C}, {0x1F,0x10,0x10,0x1E,0x10,0x10,0x1F}, // D E
+    {0x1F,0x10,0x10,0x1E,0x10,0x10,0x10}, {0x0E,0x11,0x10,0x17,0x11,0x11,0x0F}, // F G
+    {0x11,0x11,0x11,0x1F,0x11,0x11,0x11}, {0x0E,0x04,0x04,0x04,0x04,0x04,0x0E}, // H I
+    {0x07,0x02,0x02,0x02,0x02,0x12,0x0C}, {0x11,0x12,0x14,0x18,0x14,0x12,0x11}, // J K
+    {0x10,0x10,0x10,0x10,0x10,0x10,0x1F}, {0x11,0x1B,0x15,0x15,0x11,0x11,0x11}, // L M
+    {0x11,0x11,0x19,0x15,0x13,0x11,0x11}, {0x0E,0x11,0x11,0x11,0x11,0x11,0x0E}, // N O
+    {0x1E,0x11,0x11,0x1E,0x10,0x10,0x10}, {0x0E,0x11,0x11,0x11,0x15,0x12,0x0D}, // P Q
+    {0x1E,0x11,0x11,0x1E,0x14,0x12,0x11}, {0x0F,0x10,0x10,0x0E,0x01,0x01,0x1E}, // R S
+    {0x1F,0x04,0x04,0x04,0x04,0x04,0x04}, {0x11,0x11,0x11,0x11,0x11,0x11,0x0E}, // T U
+    {0x11,0x11,0x11,0x11,0x11,0x0A,0x04}, {0x11,0x11,0x11,0x15,0x15,0x15,0x0A}, // V W
+    {0x11,0x11,0x0A,0x04,0x0A,0x11,0x11}, {0x11,0x11,0x11,0x0A,0x04,0x04,0x04}, // X Y
+    {0x1F,0x01,0x02,0x04,0x08,0x10,0x1F}, {0x0E,0x08,0x08,0x08,0x08,0x08,0x0E}, // Z [
+    {0x00,0x10,0x08,0x04,0x02,0x01,0x00}, {0x0E,0x02,0x02,0x02,0x02,0x02,0x0E}, // \ ]
+    {0x04,0x0A,0x11,0x00,0x00,0x00,0x00}, {0x00,0x00,0x00,0x00,0x00,0x00,0x1F}  // ^ _
+};
+
+// Functions prototypes
+void initHud(ShaderGen& hudShader);
+void toggleHud();
+void drawHud();
+
+void bakeHudFont();
+void hudQuad(float x, float y, float w, float h, glm::vec4 color);
+float hudText(float x, float y, const char* text, glm::vec4 color);
+void hudGlyph(float x, float y, int cell, glm::vec4 color);
+void buildHud(int height);
+
+
+/// Init overlay
+/**
+  Function that bakes font atlas and creates streamed vertex buffer
+
+  \param[in] hudShader shader of overlay.
+*/
+void initHud(ShaderGen& hudShader)
+{
+    hud.program = hudShader.ID;
+    hudShader.use();
+    glUniform1i(glGetUniformLocation(hudShader.ID, "atlas"), 0);
+
+    bakeHudFont();
+
+    glGenVertexArrays(1, &hud.VAO);
+    glGenBuffers(1, &hud.VBO);
+    glBindVertexArray(hud.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, hud.VBO);
+    glBufferData(GL_ARRAY_BUFFER, hudMaxVertices * sizeof(HudVertex), NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, r));
+    glBindVertexArray(0);
+
+    hud.vertices.reserve(hudMaxVertices);
+    for (int i = 0; i < N_HUD_GRAPH; i++)
+        hud.frameTimes[i] = 0.0f;
+    hud.lastFrame = chrono::steady_clock::now();
+}
+
+/// Bake font
+/**
+  Function that draws glyphs into atlas, the last cell is solid for quads
+*/
+void bakeHudFont()
+{
+    int rows = (HUD_GLYPH_COUNT + 1 + HUD_ATLAS_COLUMNS - 1) / HUD_ATLAS_COLUMNS;
+    hud.atlasWidth = HUD_ATLAS_COLUMNS * HUD_CELL_WIDTH;
+    hud.atlasHeight = rows * HUD_CELL_HEIGHT;
+    vector<unsigned char> texels(hud.atlasWidth * hud.atlasHeight, 0);
+
+    for (int cell = 0; cell <= HUD_GLYPH_COUNT; cell++)
+    {
+        int x0 = (cell % HUD_ATLAS_COLUMNS) * HUD_CELL_WIDTH;
+        int y0 = (cell / HUD_ATLAS_COLUMNS) * HUD_CELL_HEIGHT;
+        for (int y = 0; y < HUD_CELL_HEIGHT; y++)
+        {
+            for (int x = 0; x < HUD_CELL_WIDTH; x++)
+            {
+                bool on;
+                if (cell == HUD_GLYPH_COUNT)
+                    on = true;
+                else
+                    on = x < 5 && y < 7 && (hudFont[cell][y] >> (4 - x)) & 1;
+                texels[(y0 + y) * hud.atlasWidth + x0 + x] = on ? 255 : 0;
+            }
+        }
+    }
+
+    glGenTextures(1, &hud.atlas);
+    glBindTexture(GL_TEXTURE_2D, hud.atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, hud.atlasWidth, hud.atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, texels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+/// Toggle overlay
+/**
+  Function that shows or hides overlay, profiler records pass times while overlay is shown
+*/
+void toggleHud()
+{
+    hudEnable = !hudEnable;
+    profiler.enable = hudEnable || !profiler.tracePath.empty();
+}
+
+/// Glyph
+/**
+  Function that adds one atlas cell into batch
+
+  \param[in] x left position in pixels.
+  \param[in] y top position in pixels.
+  \param[in] cell index of atlas cell.
+  \param[in] color of glyph.
+*/
+void hudGlyph(float x, float y, int cell, glm::vec4 color)
+{
+    float u0 = (float)((cell % HUD_ATLAS_COLUMNS) * HUD_CELL_WIDTH) / hud.atlasWidth;
+    float v0 = (float)((cell / HUD_ATLAS_COLUMNS) * HUD_CELL_HEIGHT) / hud.atlasHeight;
+    float u1 = u0 + 5.0f / hud.atlasWidth;
+    float v1 = v0 + 7.0f / hud.atlasHeight;
+    float x1 = x + 5.0f * hudScale;
+    float y1 = y + 7.0f * hudScale;
+
+    if (hud.vertices.size() + 6 > (size_t)hudMaxVertices)
+        return;
+    hud.vertices.push_back({ x, y, u0, v0, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x1, y, u1, v0, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x1, y1, u1, v1, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x, y, u0, v0, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x1, y1, u1, v1, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x, y1, u0, v1, color.r, color.g, color.b, color.a });
+}
+
+/// Quad
+/**
+  Function that adds solid rectangle into batch
+
+  \param[in] x left position in pixels.
+  \param[in] y top position in pixels.
+  \param[in] w width in pixels.
+  \param[in] h height in pixels.
+  \param[in] color of rectangle.
+*/
+void hudQuad(float x, float y, float w, float h, glm::vec4 color)
+{
+    // Center of solid cell, so nearest filtering never touches glyphs
+    float u = ((HUD_GLYPH_COUNT % HUD_ATLAS_COLUMNS) * HUD_CELL_WIDTH + 3.0f) / hud.atlasWidth;
+    float v = ((HUD_GLYPH_COUNT / HUD_ATLAS_COLUMNS) * HUD_CELL_HEIGHT + 4.0f) / hud.atlasHeight;
+
+    if (hud.vertices.size() + 6 > (size_t)hudMaxVertices)
+        return;
+    hud.vertices.push_back({ x, y, u, v, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x + w, y, u, v, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x + w, y + h, u, v, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x, y, u, v, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x + w, y + h, u, v, color.r, color.g, color.b, color.a });
+    hud.vertices.push_back({ x, y + h, u, v, color.r, color.g, color.b, color.a });
+}
+
+/// Text
+/**
+  Function that adds line of text into batch and returns its right end, lower case is drawn as upper case
+
+  \param[in] x left position in pixels.
+  \param[in] y top position in pixels.
+  \param[in] text drawn text.
+  \param[in] color of text.
+*/
+float hudText(float x, float y, const char* text, glm::vec4 color)
+{
+    for (const char* c = text; *c; c++)
+    {
+        int ch = *c;
+        if (ch >= 'a' && ch <= 'z')
+            ch -= 'a' - 'A';
+        if (ch > HUD_GLYPH_FIRST && ch < HUD_GLYPH_FIRST + HUD_GLYPH_COUNT)
+            hudGlyph(x, y, ch - HUD_GLYPH_FIRST, color);
+        x += HUD_CELL_WIDTH * hudScale;
+    }
+    return x;
+}
+
+/// Build overlay
+/**
+  Function that fills batch with panel, frame graph, pass times, counters and toggles
+
+  \param[in] height of viewport, panel has fixed width.
+*/
+void buildHud(int height)
+{
+    const glm::vec4 white(1.0f), gray(0.7f, 0.7f, 0.7f, 1.0f);
+    const glm::vec4 green(0.3f, 0.9f, 0.3f, 1.0f), yellow(0.95f, 0.85f, 0.2f, 1.0f), red(0.95f, 0.3f, 0.25f, 1.0f);
+    float line = HUD_CELL_HEIGHT * hudScale + 2.0f;
+    float x = 10.0f, y = 10.0f;
+    char text[128];
+
+    hud.vertices.clear();
+    hudQuad(0.0f, 0.0f, hudPanelWidth, height, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f));
+
+    // Frame time and graph, 16.6 ms line is 60 FPS
+    float frameMs = hud.frameTimes[(hud.graphPos + N_HUD_GRAPH - 1) % N_HUD_GRAPH];
+    snprintf(text, sizeof(text), "FRAME %5.2f MS  %4.0f FPS", frameMs, frameMs > 0.0f ? 1000.0f / frameMs : 0.0f);
+    hudText(x, y, text, white);
+    y += line;
+
+    float barWidth = (hudPanelWidth - 20.0f) / N_HUD_GRAPH;
+    hudQuad(x, y + hudGraphHeight * (1.0f - 16.6f / hudGraphMaxMs), hudPanelWidth - 20.0f, 1.0f, gray);
+    for (int i = 0; i < N_HUD_GRAPH; i++)
+    {
+        float ms = hud.frameTimes[(hud.graphPos + i) % N_HUD_GRAPH];
+        float h = min(ms / hudGraphMaxMs, 1.0f) * hudGraphHeight;
+        glm::vec4 color = ms < 16.7f ? green : (ms < 33.4f ? yellow : red);
+        hudQuad(x + i * barWidth, y + hudGraphHeight - h, max(barWidth - 1.0f, 1.0f), h, color);
+    }
+    y += hudGraphHeight + line / 2;
+
+    // Pass times from profiler
+    hudText(x, y, "PASS                  CPU MS  GPU MS", gray);
+    y += line;
+    for (auto& pass : profiler.passes)
+    {
+        snprintf(text, sizeof(text), "%-20.20s %7.3f %7.3f", pass.name, pass.cpuMs, pass.gpuMs);
+        hudText(x, y, text, white);
+        y += line;
+    }
+    y += line / 2;
+
+    // Counters of GL calls
+#ifdef GL_STATS
+    snprintf(text, sizeof(text), "DRAWS %lld  TRIS %lld", glStats.lastFrame.draws, glStats.lastFrame.triangles);
+    hudText(x, y, text, white);
+    y += line;
+    snprintf(text, sizeof(text), "PROGRAMS %lld  TEXTURES %lld  UNIFORMS %lld",
+        glStats.lastFrame.programs, glStats.lastFrame.textures, glStats.lastFrame.uniforms);
+    hudText(x, y, text, white);
+    y += line;
+#else
+    hudText(x, y, "DRAWS N/A (BUILD WITH GL_STATS)", gray);
+    y += line;
+#endif
+#ifdef ALLOC_TRACKER
+    snprintf(text, sizeof(text), "ALLOCS %lld  %.1f KB", allocTracker.lastCount, allocTracker.lastBytes / 1024.0);
+    hudText(x, y, text, allocTracker.lastCount == 0 ? green : yellow);
+    y += line;
+#endif
+    y += line / 2;
+
+    // Feature toggles
+    snprintf(text, sizeof(text), "FOG %s  LIGHTER %s", fogEnable ? "ON" : "OFF", lighterEnable ? "ON" : "OFF");
+    hudText(x, y, text, white);
+    y += line;
+    snprintf(text, sizeof(text), "SHADOWS %s  PREPASS %s", shadowsEnable ? "ON" : "OFF", depthPrepassEnable ? "ON" : "OFF");
+    hudText(x, y, text, white);
+    y += line;
+    snprintf(text, sizeof(text), "CULLING %s  VISIBLE %d/%d", cullingEnable ? "ON" : "OFF",
+        (int)houseQueue.visible.size(), (int)houseQueue.items.size());
+    hudText(x, y, text, white);
+    y += line;
+    snprintf(text, sizeof(text), "FRAME ARENA %.1f/%.0f KB", frameArenaUsed() / 1024.0, frameArenaCapacity() / N_FRAME_ARENAS / 1024.0);
+    hudText(x, y, text, white);
+    y += line;
+    const double MB = 1024.0 * 1024.0;
+    snprintf(text, sizeof(text), "TEX %.0f MB  BUF %.0f MB  CPU %.0f MB", memoryLedger.textureBytes / MB,
+        memoryLedger.bufferBytes / MB, memoryLedger.cpuBytes / MB);
+    hudText(x, y, text, white);
+    y += line;
+    snprintf(text, sizeof(text), "TEX BUDGET %.0f/%d MB  DROPS %d  EVICTS %d  LOADS %d", textureResidency.residentBytes / MB,
+        textureBudgetMB, textureResidency.mipDrops, textureResidency.evictions, textureResidency.reloads);
+    hudText(x, y, text, textureResidency.residentBytes > (long long)textureBudgetMB * 1024 * 1024 ? yellow : white);
+    y += line;
+    snprintf(text, sizeof(text), "REGIONS %d/%d  LOADS %d  EVICTS %d", loadedRegions(), (int)regionStreaming.regions.size(),
+        regionStreaming.loads, regionStreaming.evictions);
+    hudText(x, y, text, white);
+}
+
+/// Draw overlay
+/**
+  Function that draws overlay over the frame by one draw call
+*/
+void drawHud()
+{
+    auto now = chrono::steady_clock::now();
+    hud.frameTimes[hud.graphPos] = chrono::duration<float, milli>(now - hud.lastFrame).count();
+    hud.graphPos = (hud.graphPos + 1) % N_HUD_GRAPH;
+    hud.lastFrame = now;
+
+    if (!hudEnable)
+        return;
+    PROFILE_SCOPE("draw_hud");
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    buildHud(viewport[3]);
+
+    glDisable(GL_DEPTH_TEST);
+    glStencilMask(0x00);
+    glUseProgram(hud.program);
+    glUniform2f(glGetUniformLocation(hud.program, "screenSize"), (float)viewport[2], (float)viewport[3]);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hud.atlas);
+
+    // Orphan buffer, so driver does not wait for previous frame
+    glBindBuffer(GL_ARRAY_BUFFER, hud.VBO);
+    glBufferData(GL_ARRAY_BUFFER, hudMaxVertices * sizeof(HudVertex), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, hud.vertices.size() * sizeof(HudVertex), hud.vertices.data());
+    glBindVertexArray(hud.VAO);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)hud.vertices.size());
+    glBindVertexArray(0);
+
+    glStencilMask(0xFF);
+    glEnable(GL_DEPTH_TEST);
+}
+
+#endif
@@ -0,0 +1,166 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    import_arena.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Arena for temporaries of one model import with allocator for STL containers, peak memory of process
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef IMPORT_ARENA_H
+#define IMPORT_ARENA_H
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "data.h"
+#include "frame_arena.h"
+
+/// Arena of one import
+/**
+  Temporaries of import are bump allocated from blocks and freed together with arena, so parsing does not
+  call allocator for every vector. Threads of one import allocate from it, so allocation is locked
+*/
+struct ImportArena {
+    vector<ArenaBlock> blocks;///<blocks of arena, the last one is filled
+    mutex lock;///<lock of blocks
+    size_t bytes = 0;///<bytes size of all blocks
+
+    ImportArena() {}
+    ImportArena(const ImportArena&) = delete;
+    ImportArena& operator=(const ImportArena&) = delete;
+    ~ImportArena();
+};
+
+// Arena of import running on thread, containers created by thread allocate from it
+thread_local ImportArena* boundImportArena = nullptr;
+
+// Functions prototypes
+void* importAlloc(ImportArena* arena, size_t size, size_t alignment);
+ImportArena* bindImportArena(ImportArena* arena);
+long long peakProcessMemory();
+
+
+/// Allocator of import arena
+/**
+  Allocator for STL containers, it takes arena bound to thread which creates container. Without bound arena
+  it uses heap, so code of import runs unchanged outside of it
+*/
+template <class T>
+struct ImportAllocator {
+    typedef T value_type;
+    ImportArena* arena;///<arena of allocations, null for heap
+
+    ImportAllocator() : arena(boundImportArena) {}
+    template <class U> ImportAllocator(const ImportAllocator<U>& other) : arena(other.arena) {}
+    T* allocate(size_t n)
+    {
+        if (!arena)
+            return (T*)::operator new(n * sizeof(T));
+        return (T*)importAlloc(arena, n * sizeof(T), alignof(T));
+    }
+    void deallocate(T* ptr, size_t)
+    {
+        if (!arena)
+            ::operator delete(ptr);
+    }
+};
+
+template <class T, class U>
+bool operator==(const ImportAllocator<T>& a, const ImportAllocator<U>& b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const ImportAllocator<T>& a, const ImportAllocator<U>& b) { return a.arena != b.arena; }
+
+// Vector with memory of import
+template <class T>
+using ImportVector = vector<T, ImportAllocator<T>>;
+
+ImportArena::~ImportArena()
+{
+    for (auto& block : blocks)
+        free(block.data);
+}
+
+/// Import allocation
+/**
+  Function that allocates memory valid until arena is destroyed, new block is at least importArenaBlockBytes
+  and large allocation gets block of its own size
+
+  \param[in] arena import arena.
+  \param[in] size of allocation.
+  \param[in] alignment of allocation, power of two.
+*/
+void* importAlloc(ImportArena* arena, size_t size, size_t alignment)
+{
+    lock_guard<mutex> guard(arena->lock);
+    void* ptr = arena->blocks.empty() ? NULL : arenaAlloc(arena->blocks.back(), size, alignment);
+    if (ptr)
+        return ptr;
+
+    ArenaBlock block;
+    block.capacity = max(importArenaBlockBytes, size + alignment);
+    block.data = (char*)malloc(block.capacity);
+    if (!block.data)
+        throw std::bad_alloc();
+    // Large block is put before the last one, so rest of the last one is still used
+    arena->bytes += block.capacity;
+    if (!arena->blocks.empty() && block.capacity > importArenaBlockBytes)
+    {
+        arena->blocks.insert(arena->blocks.end() - 1, block);
+        return arenaAlloc(arena->blocks[arena->blocks.size() - 2], size, alignment);
+    }
+    arena->blocks.push_back(block);
+    return arenaAlloc(arena->blocks.back(), size, alignment);
+}
+
+/// Bind arena
+/**
+  Function that makes containers created by calling thread allocate from arena, returns previous arena
+
+  \param[in] arena import arena, null for heap.
+*/
+ImportArena* bindImportArena(ImportArena* arena)
+{
+    ImportArena* previous = boundImportArena;
+    boundImportArena = arena;
+    return previous;
+}
+
+/// Peak memory
+/**
+  Function that returns peak resident memory of process in bytes, 0 when it is unknown
+*/
+long long peakProcessMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (long long)counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+    return (long long)usage.ru_maxrss * 1024;
+#endif
+}
+
+#endif
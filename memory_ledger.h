@@ -0,0 +1,369 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    memory_ledger.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Ledger of GPU buffers and textures with their sizes, owners and CPU copies
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef MEMORY_LEDGER_H
+#define MEMORY_LEDGER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+// Loader of GL 3.3 core has no S3TC enums, drivers expose them by extension
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/// Kind of GPU allocation
+enum LedgerKind {
+    LEDGER_BUFFER,
+    LEDGER_TEXTURE
+};
+
+/// One buffer or texture
+struct LedgerEntry {
+    LedgerKind kind;///<kind buffer or texture
+    unsigned int ID;///<ID of GL object
+    long long bytes;///<bytes estimated size in video memory
+    string format;///<format of texels or content of buffer
+    int width;///<width of texture, 0 for buffer
+    int height;///<height of texture, 0 for buffer
+    int layers;///<layers faces of cubemap, 1 otherwise
+    int mipLevels;///<mipLevels number of mip levels
+    string group;///<group model file or "scene"
+    string owner;///<owner mesh or texture file
+    long long cpuBytes;///<cpuBytes size of copy kept in CPU memory, 0 when there is no copy
+};
+
+/// Ledger state
+struct MemoryLedger {
+    vector<LedgerEntry> entries;///<entries live allocations
+    string group = "scene";///<group owner of allocations created now, set by model loading
+    long long textureBytes = 0;///<textureBytes sum of textures
+    long long bufferBytes = 0;///<bufferBytes sum of buffers
+    long long cpuBytes = 0;///<cpuBytes sum of CPU copies
+};
+MemoryLedger memoryLedger;
+
+// Functions prototypes
+void ledgerBuffer(unsigned int ID, long long bytes, const string& format, const string& owner, long long cpuBytes);
+void ledgerTexture(unsigned int ID, GLenum internalFormat, int width, int height, int layers, bool mipmapped, const string& owner);
+void ledgerTextureResize(unsigned int ID, GLenum internalFormat, int width, int height, int levels);
+void ledgerCpuCopy(LedgerKind kind, unsigned int ID, long long cpuBytes);
+void ledgerRelease(LedgerKind kind, unsigned int ID);
+LedgerEntry* findLedgerEntry(LedgerKind kind, unsigned int ID);
+int mipLevelsOf(int width, int height);
+long long textureSize(GLenum internalFormat, int width, int height, int levels);
+int texelBytes(GLenum internalFormat);
+int compressedBlockBytes(GLenum internalFormat);
+const char* formatName(GLenum internalFormat);
+void dumpMemoryLedger();
+
+
+/// Record buffer
+/**
+  Function that adds buffer into ledger
+
+  \param[in] ID of buffer.
+  \param[in] bytes size of buffer.
+  \param[in] format content of buffer.
+  \param[in] owner mesh of buffer.
+  \param[in] cpuBytes size of CPU copy of content.
+*/
+void ledgerBuffer(unsigned int ID, long long bytes, const string& format, const string& owner, long long cpuBytes)
+{
+    memoryLedger.entries.push_back({ LEDGER_BUFFER, ID, bytes, format, 0, 0, 1, 1, memoryLedger.group, owner, cpuBytes });
+    memoryLedger.bufferBytes += bytes;
+    memoryLedger.cpuBytes += cpuBytes;
+}
+
+/// Record texture
+/**
+  Function that adds texture into ledger, size includes full mip chain of all layers
+
+  \param[in] ID of texture.
+  \param[in] internalFormat of texture.
+  \param[in] width of level 0.
+  \param[in] height of level 0.
+  \param[in] layers number of faces.
+  \param[in] mipmapped texture has mip chain.
+  \param[in] owner file of texture.
+*/
+void ledgerTexture(unsigned int ID, GLenum internalFormat, int width, int height, int layers, bool mipmapped, const string& owner)
+{
+    int levels = mipmapped ? mipLevelsOf(width, height) : 1;
+    long long bytes = textureSize(internalFormat, width, height, levels) * layers;
+
+    memoryLedger.entries.push_back({ LEDGER_TEXTURE, ID, bytes, formatName(internalFormat), width, height, layers, levels,
+        memoryLedger.group, owner, 0 });
+    memoryLedger.textureBytes += bytes;
+}
+
+/// Find entry
+/**
+  Function that returns entry of GL object or NULL
+
+  \param[in] kind of object.
+  \param[in] ID of object.
+*/
+LedgerEntry* findLedgerEntry(LedgerKind kind, unsigned int ID)
+{
+    for (auto& entry : memoryLedger.entries)
+    {
+        if (entry.kind == kind && entry.ID == ID)
+            return &entry;
+    }
+    return NULL;
+}
+
+/// Resize texture
+/**
+  Function that changes size of texture whose storage was respecified, like after dropping of mips
+
+  \param[in] ID of texture.
+  \param[in] internalFormat of texture.
+  \param[in] width of new level 0.
+  \param[in] height of new level 0.
+  \param[in] levels number of mip levels.
+*/
+void ledgerTextureResize(unsigned int ID, GLenum internalFormat, int width, int height, int levels)
+{
+    LedgerEntry* entry = findLedgerEntry(LEDGER_TEXTURE, ID);
+    if (!entry)
+        return;
+    long long bytes = textureSize(internalFormat, width, height, levels) * entry->layers;
+    memoryLedger.textureBytes += bytes - entry->bytes;
+    entry->bytes = bytes;
+    entry->width = width;
+    entry->height = height;
+    entry->mipLevels = levels;
+}
+
+/// Update CPU copy
+/**
+  Function that changes size of CPU copy of object, it is called when copy is released
+
+  \param[in] kind of object.
+  \param[in] ID of object.
+  \param[in] cpuBytes new size of CPU copy.
+*/
+void ledgerCpuCopy(LedgerKind kind, unsigned int ID, long long cpuBytes)
+{
+    LedgerEntry* entry = findLedgerEntry(kind, ID);
+    if (!entry)
+        return;
+    memoryLedger.cpuBytes += cpuBytes - entry->cpuBytes;
+    entry->cpuBytes = cpuBytes;
+}
+
+/// Release entry
+/**
+  Function that removes deleted object from ledger
+
+  \param[in] kind of object.
+  \param[in] ID of object.
+*/
+void ledgerRelease(LedgerKind kind, unsigned int ID)
+{
+    LedgerEntry* entry = findLedgerEntry(kind, ID);
+    if (!entry)
+        return;
+    if (kind == LEDGER_TEXTURE)
+        memoryLedger.textureBytes -= entry->bytes;
+    else
+        memoryLedger.bufferBytes -= entry->bytes;
+    memoryLedger.cpuBytes -= entry->cpuBytes;
+    *entry = memoryLedger.entries.back();
+    memoryLedger.entries.pop_back();
+}
+
+/// Mip levels
+/**
+  Function that returns number of levels of full mip chain
+
+  \param[in] width of level 0.
+  \param[in] height of level 0.
+*/
+int mipLevelsOf(int width, int height)
+{
+    int levels = 1;
+    for (int size = max(width, height); size > 1; size >>= 1)
+        levels++;
+    return levels;
+}
+
+/// Texture size
+/**
+  Function that returns bytes of mip chain of one layer, compressed levels are stored in 4x4 blocks
+
+  \param[in] internalFormat of texture.
+  \param[in] width of level 0.
+  \param[in] height of level 0.
+  \param[in] levels number of mip levels.
+*/
+long long textureSize(GLenum internalFormat, int width, int height, int levels)
+{
+    long long bytes = 0;
+    int blockBytes = compressedBlockBytes(internalFormat);
+    for (int level = 0; level < levels; level++)
+    {
+        int levelWidth = max(1, width >> level), levelHeight = max(1, height >> level);
+        if (blockBytes)
+            bytes += (long long)((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * blockBytes;
+        else
+            bytes += (long long)levelWidth * levelHeight * texelBytes(internalFormat);
+    }
+    return bytes;
+}
+
+/// Texel size
+/**
+  Function that returns bytes of texel in video memory, drivers pad 3 channel formats to 4
+
+  \param[in] internalFormat of texture.
+*/
+int texelBytes(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_RED:
+    case GL_R8:
+        return 1;
+    case GL_RG:
+    case GL_RG8:
+    case GL_R16F:
+        return 2;
+    case GL_RGBA16F:
+        return 8;
+    case GL_RGBA32F:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+/// Block size
+/**
+  Function that returns bytes of 4x4 block of compressed format, 0 for uncompressed formats
+
+  \param[in] internalFormat of texture.
+*/
+int compressedBlockBytes(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+/// Format name
+/**
+  Function that returns readable name of internal format
+
+  \param[in] internalFormat of texture.
+*/
+const char* formatName(GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+    case GL_RED: return "RED";
+    case GL_R8: return "R8";
+    case GL_RG: return "RG";
+    case GL_RG8: return "RG8";
+    case GL_RGB: return "RGB";
+    case GL_RGB8: return "RGB8";
+    case GL_RGBA: return "RGBA";
+    case GL_RGBA8: return "RGBA8";
+    case GL_R16F: return "R16F";
+    case GL_RGBA16F: return "RGBA16F";
+    case GL_RGBA32F: return "RGBA32F";
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT: return "BC1";
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT: return "BC3";
+    case GL_COMPRESSED_RED_RGTC1: return "BC4";
+    case GL_COMPRESSED_RG_RGTC2: return "BC5";
+    default: return "OTHER";
+    }
+}
+
+/// Dump ledger
+/**
+  Function that prints totals, sums of groups and the biggest allocations, all entries are written into CSV
+*/
+void dumpMemoryLedger()
+{
+    const double MB = 1024.0 * 1024.0;
+    char line[256];
+    snprintf(line, sizeof(line), "Memory ledger: textures %.1f MB, buffers %.1f MB, CPU copies %.1f MB, %d objects",
+        memoryLedger.textureBytes / MB, memoryLedger.bufferBytes / MB, memoryLedger.cpuBytes / MB, (int)memoryLedger.entries.size());
+    cout << line << endl;
+
+    vector<LedgerEntry> sorted = memoryLedger.entries;
+    sort(sorted.begin(), sorted.end(), [](const LedgerEntry& a, const LedgerEntry& b) { return a.bytes > b.bytes; });
+
+    // Sums of groups
+    vector<pair<string, long long>> groups;
+    for (auto& entry : sorted)
+    {
+        auto group = find_if(groups.begin(), groups.end(), [&entry](const pair<string, long long>& g) { return g.first == entry.group; });
+        if (group == groups.end())
+            groups.push_back({ entry.group, entry.bytes + entry.cpuBytes });
+        else
+            group->second += entry.bytes + entry.cpuBytes;
+    }
+    sort(groups.begin(), groups.end(), [](const pair<string, long long>& a, const pair<string, long long>& b) { return a.second > b.second; });
+    cout << "group                                              GPU+CPU MB" << endl;
+    for (auto& group : groups)
+    {
+        snprintf(line, sizeof(line), "%-50.50s %10.2f", group.first.c_str(), group.second / MB);
+        cout << line << endl;
+    }
+
+    cout << "biggest objects                     kind     format     size        mips       GPU MB     CPU MB" << endl;
+    for (int i = 0; i < (int)sorted.size() && i < ledgerTopEntries; i++)
+    {
+        const LedgerEntry& entry = sorted[i];
+        snprintf(line, sizeof(line), "%-35.35s %-8s %-10.10s %5dx%-5d x%-2d %4d %10.2f %10.2f", entry.owner.c_str(),
+            entry.kind == LEDGER_TEXTURE ? "texture" : "buffer", entry.format.c_str(), entry.width, entry.height, entry.layers,
+            entry.mipLevels, entry.bytes / MB, entry.cpuBytes / MB);
+        cout << line << endl;
+    }
+
+    ofstream file(memoryLedgerPath);
+    if (!file)
+    {
+        cout << "Failed to write memory ledger to " << memoryLedgerPath << endl;
+        return;
+    }
+    file << "kind,id,group,owner,format,width,height,layers,mips,gpu_bytes,cpu_bytes" << endl;
+    for (auto& entry : sorted)
+    {
+        file << (entry.kind == LEDGER_TEXTURE ? "texture" : "buffer") << "," << entry.ID << "," << entry.group << "," << entry.owner
+             << "," << entry.format << "," << entry.width << "," << entry.height << "," << entry.layers << "," << entry.mipLevels
+             << "," << entry.bytes << "," << entry.cpuBytes << endl;
+    }
+    cout << "Memory ledger saved to " << memoryLedgerPath << endl;
+}
+
+#endif
@@ -0,0 +1,310 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    mip_chain.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Mip chains built on CPU by gamma-correct box filter with preserved alpha coverage
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef MIP_CHAIN_H
+#define MIP_CHAIN_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SSE2
+#endif
+
+#include "data.h"
+#include "memory_ledger.h"
+
+#define SRGB_TABLE_SIZE 4096
+
+/// Conversion tables between sRGB bytes and linear floats
+struct SrgbTables {
+    float toLinear[256];///<toLinear linear value of sRGB byte
+    unsigned char toSrgb[SRGB_TABLE_SIZE];///<toSrgb sRGB byte of linear value quantized to table size
+    SrgbTables();
+};
+
+// Functions prototypes
+const SrgbTables& srgbTables();
+size_t mipChainOffset(int width, int height, int channels, int level);
+void buildMipChain(const unsigned char* data, int width, int height, int channels, bool srgb, vector<unsigned char>& chain);
+void expandLevel(const unsigned char* data, size_t count, int channels, bool srgb, vector<float>& out);
+int colorChannelsOf(int channels, bool srgb);
+int alphaChannelOf(int channels);
+void packLevel(const vector<float>& level, int channels, bool srgb, unsigned char* out);
+void downsampleLevel(const vector<float>& source, int width, int height, int channels, vector<float>& target);
+float alphaCoverage(const unsigned char* data, size_t count, int channels, float cutoff, float scale);
+void preserveAlphaCoverage(unsigned char* data, size_t count, int channels, float coverage);
+
+
+SrgbTables::SrgbTables()
+{
+    for (int i = 0; i < 256; i++)
+    {
+        float value = i / 255.0f;
+        toLinear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+    }
+    for (int i = 0; i < SRGB_TABLE_SIZE; i++)
+    {
+        float value = i / (float)(SRGB_TABLE_SIZE - 1);
+        float srgb = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+        toSrgb[i] = (unsigned char)(srgb * 255.0f + 0.5f);
+    }
+}
+
+/// sRGB tables
+/**
+  Function that returns conversion tables, they are built by first call, workers may call it together
+*/
+const SrgbTables& srgbTables()
+{
+    static const SrgbTables tables;
+    return tables;
+}
+
+/// Chain offset
+/**
+  Function that returns offset of level in chain of tightly packed levels, offset of levels count is size of chain
+
+  \param[in] width of level 0.
+  \param[in] height of level 0.
+  \param[in] channels number of channels.
+  \param[in] level mip level.
+*/
+size_t mipChainOffset(int width, int height, int channels, int level)
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+        offset += (size_t)max(1, width >> i) * max(1, height >> i) * channels;
+    return offset;
+}
+
+/// Build chain
+/**
+  Function that builds all levels of image, the finest first. Filter averages 2x2 blocks in linear space,
+  levels are converted back only for storage, so error does not grow down the chain.
+  Alpha of cutout images is scaled, so the same share of texels passes alpha test at every level
+
+  \param[in] data pixels of level 0.
+  \param[in] width of level 0.
+  \param[in] height of level 0.
+  \param[in] channels number of channels.
+  \param[in] srgb color channels are sRGB, normal maps and masks are filtered as they are.
+  \param[out] chain tightly packed levels.
+*/
+void buildMipChain(const unsigned char* data, int width, int height, int channels, bool srgb, vector<unsigned char>& chain)
+{
+    int levels = mipLevelsOf(width, height);
+    int baseWidth = width, baseHeight = height;
+    chain.resize(mipChainOffset(width, height, channels, levels));
+    size_t count = (size_t)width * height;
+    memcpy(chain.data(), data, count * channels);
+
+    // Only images with texels cut by alpha test keep coverage, blended ones are filtered plainly
+    float coverage = alphaChannelOf(channels) >= 0 ? alphaCoverage(data, count, channels, textureAlphaCutoff, 1.0f) : 1.0f;
+    bool cutout = coverage > 0.0f && coverage < 1.0f;
+
+    vector<float> level, half;
+    expandLevel(data, count, channels, srgb, level);
+    for (int i = 1; i < levels; i++)
+    {
+        downsampleLevel(level, width, height, channels, half);
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+        level.swap(half);
+
+        unsigned char* out = chain.data() + mipChainOffset(baseWidth, baseHeight, channels, i);
+        packLevel(level, channels, srgb, out);
+        if (cutout)
+            preserveAlphaCoverage(out, (size_t)width * height, channels, coverage);
+    }
+}
+
+/// Expand level
+/**
+  Function that converts bytes into floats 0..1, color channels of sRGB image into linear space
+
+  \param[in] data pixels of level.
+  \param[in] count number of texels.
+  \param[in] channels number of channels.
+  \param[in] srgb color channels are sRGB.
+  \param[out] out floats of level.
+*/
+void expandLevel(const unsigned char* data, size_t count, int channels, bool srgb, vector<float>& out)
+{
+    const SrgbTables& tables = srgbTables();
+    int colorChannels = colorChannelsOf(channels, srgb);
+    out.resize(count * channels);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int c = 0; c < channels; c++)
+        {
+            unsigned char value = data[i * channels + c];
+            out[i * channels + c] = c < colorChannels ? tables.toLinear[value] : value / 255.0f;
+        }
+    }
+}
+
+/// Color channels
+/**
+  Function that returns number of leading channels stored in sRGB, grey of grey + alpha image is color,
+  alpha stays linear
+
+  \param[in] channels number of channels.
+  \param[in] srgb color channels are sRGB.
+*/
+int colorChannelsOf(int channels, bool srgb)
+{
+    if (!srgb)
+        return 0;
+    return channels >= 3 ? 3 : 1;
+}
+
+/// Alpha channel
+/**
+  Function that returns index of alpha channel, -1 for images without alpha
+
+  \param[in] channels number of channels.
+*/
+int alphaChannelOf(int channels)
+{
+    return channels == 2 || channels == 4 ? channels - 1 : -1;
+}
+
+/// Pack level
+/**
+  Function that converts floats back into bytes
+
+  \param[in] level floats of level.
+  \param[in] channels number of channels.
+  \param[in] srgb color channels are sRGB.
+  \param[out] out pixels of level.
+*/
+void packLevel(const vector<float>& level, int channels, bool srgb, unsigned char* out)
+{
+    const SrgbTables& tables = srgbTables();
+    int colorChannels = colorChannelsOf(channels, srgb);
+    for (size_t i = 0; i < level.size(); i++)
+    {
+        float value = min(max(level[i], 0.0f), 1.0f);
+        if ((int)(i % channels) < colorChannels)
+            out[i] = tables.toSrgb[(int)(value * (SRGB_TABLE_SIZE - 1) + 0.5f)];
+        else
+            out[i] = (unsigned char)(value * 255.0f + 0.5f);
+    }
+}
+
+/// Downsample level
+/**
+  Function that averages 2x2 blocks of texels, odd last row and column are repeated.
+  Rows are summed by SSE, texels of RGBA images are summed by SSE too
+
+  \param[in] source floats of level.
+  \param[in] width of level.
+  \param[in] height of level.
+  \param[in] channels number of channels.
+  \param[out] target floats of half level.
+*/
+void downsampleLevel(const vector<float>& source, int width, int height, int channels, vector<float>& target)
+{
+    int halfWidth = max(1, width / 2);
+    int halfHeight = max(1, height / 2);
+    target.resize((size_t)halfWidth * halfHeight * channels);
+    size_t rowFloats = (size_t)width * channels;
+    vector<float> rows(rowFloats);
+
+    for (int y = 0; y < halfHeight; y++)
+    {
+        const float* row0 = &source[(size_t)min(2 * y, height - 1) * rowFloats];
+        const float* row1 = &source[(size_t)min(2 * y + 1, height - 1) * rowFloats];
+        size_t i = 0;
+#ifdef MIP_SSE2
+        for (; i + 4 <= rowFloats; i += 4)
+            _mm_storeu_ps(&rows[i], _mm_add_ps(_mm_loadu_ps(row0 + i), _mm_loadu_ps(row1 + i)));
+#endif
+        for (; i < rowFloats; i++)
+            rows[i] = row0[i] + row1[i];
+
+        float* out = &target[(size_t)y * halfWidth * channels];
+        for (int x = 0; x < halfWidth; x++)
+        {
+            const float* texel0 = &rows[(size_t)min(2 * x, width - 1) * channels];
+            const float* texel1 = &rows[(size_t)min(2 * x + 1, width - 1) * channels];
+#ifdef MIP_SSE2
+            if (channels == 4)
+            {
+                _mm_storeu_ps(out + x * 4, _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(texel0), _mm_loadu_ps(texel1)), _mm_set1_ps(0.25f)));
+                continue;
+            }
+#endif
+            for (int c = 0; c < channels; c++)
+                out[x * channels + c] = (texel0[c] + texel1[c]) * 0.25f;
+        }
+    }
+}
+
+/// Alpha coverage
+/**
+  Function that returns share of texels whose alpha scaled by scale passes alpha test
+
+  \param[in] data pixels of level.
+  \param[in] count number of texels.
+  \param[in] channels number of channels, alpha is the last one.
+  \param[in] cutoff threshold of alpha test.
+  \param[in] scale of alpha.
+*/
+float alphaCoverage(const unsigned char* data, size_t count, int channels, float cutoff, float scale)
+{
+    size_t passed = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (data[i * channels + channels - 1] / 255.0f * scale >= cutoff)
+            passed++;
+    }
+    return count ? (float)passed / count : 1.0f;
+}
+
+/// Preserve coverage
+/**
+  Function that scales alpha of level so share of texels passing alpha test is the nearest to coverage of level 0,
+  scale is found by bisection
+
+  \param[in,out] data pixels of level.
+  \param[in] count number of texels.
+  \param[in] channels number of channels, alpha is the last one.
+  \param[in] coverage share of level 0.
+*/
+void preserveAlphaCoverage(unsigned char* data, size_t count, int channels, float coverage)
+{
+    float low = 0.0f, high = 4.0f, scale = 1.0f;
+    float bestError = fabsf(alphaCoverage(data, count, channels, textureAlphaCutoff, 1.0f) - coverage);
+    for (int step = 0; step < 10; step++)
+    {
+        float middle = (low + high) * 0.5f;
+        float current = alphaCoverage(data, count, channels, textureAlphaCutoff, middle);
+        if (fabsf(current - coverage) < bestError)
+        {
+            scale = middle;
+            bestError = fabsf(current - coverage);
+        }
+        if (current > coverage)
+            high = middle;
+        else
+            low = middle;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        unsigned char& alpha = data[i * channels + channels - 1];
+        alpha = (unsigned char)min(alpha * scale + 0.5f, 255.0f);
+    }
+}
+
+#endif
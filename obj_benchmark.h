@@ -0,0 +1,186 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    obj_benchmark.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Benchmark which compares native OBJ loader with Assimp on every model of assets
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef OBJ_BENCHMARK_H
+#define OBJ_BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data.h"
+#include "asset_pack.h"
+#include "obj_loader.h"
+#include "Model.h"
+
+/// Differences of two imports of model
+struct ObjImportDiff {
+    string structure;///<structure first difference of meshes, indices or textures, empty when there is none
+    float position = 0.0f;///<position largest difference of positions
+    float normal = 0.0f;///<normal largest difference of normals
+    float texCoord = 0.0f;///<texCoord largest difference of texture coordinates
+    float color = 0.0f;///<color largest difference of colors
+    float tangent = 0.0f;///<tangent largest difference of tangents and bitangents
+};
+
+// Functions prototypes
+bool benchmarkObjLoader();
+double timeObjImport(const string& path, bool native, ModelImport& data);
+ObjImportDiff compareObjImports(const ModelImport& assimp, const ModelImport& native);
+
+
+/// Benchmark OBJ loader
+/**
+  Function that imports every OBJ model of asset directory by Assimp and by native loader,
+  prints the best time of both and whether their meshes are the same. Returns false when some model differs
+*/
+bool benchmarkObjLoader()
+{
+    vector<string> files;
+    listAssetFiles(assetPackSource, files);
+    sort(files.begin(), files.end());
+
+    bool identical = true;
+    double assimpTotal = 0.0, nativeTotal = 0.0;
+    for (auto& path : files)
+    {
+        if (!hasExtension(path, ".obj"))
+            continue;
+        ModelImport assimp, native;
+        double assimpMs = timeObjImport(path, false, assimp);
+        double nativeMs = timeObjImport(path, true, native);
+        if (assimpMs < 0.0 || nativeMs < 0.0)
+        {
+            cout << path << ": import failed" << endl;
+            identical = false;
+            continue;
+        }
+        assimpTotal += assimpMs;
+        nativeTotal += nativeMs;
+
+        ObjImportDiff diff = compareObjImports(assimp, native);
+        bool same = diff.structure.empty() && diff.position <= objBenchmarkTolerance && diff.normal <= objBenchmarkTolerance &&
+            diff.texCoord <= objBenchmarkTolerance && diff.color <= objBenchmarkTolerance && diff.tangent <= objBenchmarkTangentTolerance;
+        identical = identical && same;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%8.2f ms Assimp %8.2f ms native %5.2fx, %zu meshes, ", assimpMs, nativeMs,
+            nativeMs > 0.0 ? assimpMs / nativeMs : 0.0, assimp.meshes.size());
+        cout << path << ": " << line << (same ? "identical" : "differs");
+        if (!diff.structure.empty())
+            cout << " (" << diff.structure << ")";
+        else if (!same)
+        {
+            cout << " (position " << diff.position << ", normal " << diff.normal << ", uv " << diff.texCoord
+                << ", color " << diff.color << ", tangent " << diff.tangent << ")";
+        }
+        cout << endl;
+    }
+    cout << "OBJ loader: " << assimpTotal << " ms Assimp, " << nativeTotal << " ms native";
+    if (nativeTotal > 0.0)
+        cout << ", " << assimpTotal / nativeTotal << "x";
+    cout << endl;
+    return identical;
+}
+
+/// Time import
+/**
+  Function that imports model several times and returns the best time in milliseconds, -1 when import failed
+
+  \param[in] path of OBJ model.
+  \param[in] native model is read by native loader, otherwise by Assimp.
+  \param[out] data model of last run.
+*/
+double timeObjImport(const string& path, bool native, ModelImport& data)
+{
+    double best = -1.0;
+    for (int run = 0; run < objBenchmarkRuns; run++)
+    {
+        data = ModelImport();
+        auto start = chrono::steady_clock::now();
+        bool imported = native ? Model::importObjModel(path, data) : Model::importAssimpModel(path, data);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!imported)
+            return -1.0;
+        best = best < 0.0 ? ms : min(best, ms);
+    }
+    return best;
+}
+
+/// Compare imports
+/**
+  Function that compares meshes, indices and textures exactly and vertices by largest difference.
+  Tangents are compared only where both loaders give finite ones
+
+  \param[in] assimp model imported by Assimp.
+  \param[in] native model imported by native loader.
+*/
+ObjImportDiff compareObjImports(const ModelImport& assimp, const ModelImport& native)
+{
+    ObjImportDiff diff;
+    auto largest = [](float& value, const glm::vec4& a, const glm::vec4& b)
+    {
+        glm::vec4 d = glm::abs(a - b);
+        value = max(value, max(max(d.x, d.y), max(d.z, d.w)));
+    };
+
+    if (assimp.meshes.size() != native.meshes.size())
+    {
+        diff.structure = "meshes " + to_string(assimp.meshes.size()) + " / " + to_string(native.meshes.size());
+        return diff;
+    }
+    for (size_t i = 0; i < assimp.meshes.size(); i++)
+    {
+        const MeshImport& a = assimp.meshes[i];
+        const MeshImport& b = native.meshes[i];
+        string name = a.name.C_Str();
+        if (name != b.name.C_Str() || a.material != b.material || a.window != b.window)
+            diff.structure = "mesh " + name + " / " + b.name.C_Str();
+        else if (a.vertices.size() != b.vertices.size())
+            diff.structure = "vertices of " + name + " " + to_string(a.vertices.size()) + " / " + to_string(b.vertices.size());
+        else if (a.indices != b.indices)
+            diff.structure = "indices of " + name;
+        else if (a.textures.size() != b.textures.size())
+            diff.structure = "textures of " + name;
+        for (size_t t = 0; diff.structure.empty() && t < a.textures.size(); t++)
+        {
+            if (a.textures[t].path != b.textures[t].path || a.textures[t].type != b.textures[t].type || a.textures[t].id != b.textures[t].id)
+                diff.structure = "texture " + a.textures[t].path + " / " + b.textures[t].path;
+        }
+        if (!diff.structure.empty())
+            return diff;
+
+        for (size_t v = 0; v < a.vertices.size(); v++)
+        {
+            const Vertex& va = a.vertices[v];
+            const Vertex& vb = b.vertices[v];
+            largest(diff.position, glm::vec4(va.Position, 0.0f), glm::vec4(vb.Position, 0.0f));
+            largest(diff.normal, glm::vec4(va.Normal, 0.0f), glm::vec4(vb.Normal, 0.0f));
+            largest(diff.texCoord, glm::vec4(va.TexCoords, 0.0f, 0.0f), glm::vec4(vb.TexCoords, 0.0f, 0.0f));
+            largest(diff.color, glm::vec4(va.color.x, va.color.y, va.color.z, va.useDiffuseTexture),
+                glm::vec4(vb.color.x, vb.color.y, vb.color.z, vb.useDiffuseTexture));
+            // Assimp leaves tangents of mesh without texture coordinates unset, native loader gives zero ones
+            bool tangents = vb.Tangent != glm::vec3(0.0f) || vb.Bitangent != glm::vec3(0.0f);
+            if (tangents && !glm::any(glm::isnan(va.Tangent)) && !glm::any(glm::isnan(va.Bitangent)))
+            {
+                largest(diff.tangent, glm::vec4(va.Tangent, 0.0f), glm::vec4(vb.Tangent, 0.0f));
+                largest(diff.tangent, glm::vec4(va.Bitangent, 0.0f), glm::vec4(vb.Bitangent, 0.0f));
+            }
+        }
+    }
+    return diff;
+}
+
+#endif
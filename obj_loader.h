@@ -0,0 +1,1406 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    obj_loader.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Native loader of Wavefront OBJ and MTL files, chunks of mapped file are parsed in parallel
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OBJ_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "data.h"
+#include "Mesh.h"
+#include "asset_pack.h"
+#include "import_arena.h"
+
+/// Kind of line of OBJ file
+enum ObjLineKind {
+    OBJ_LINE_OTHER,///< comment, smoothing group and unsupported statements
+    OBJ_LINE_POSITION,///< "v"
+    OBJ_LINE_TEXCOORD,///< "vt"
+    OBJ_LINE_NORMAL,///< "vn"
+    OBJ_LINE_FACE,///< "f"
+    OBJ_LINE_OBJECT,///< "o"
+    OBJ_LINE_GROUP,///< "g"
+    OBJ_LINE_USE_MATERIAL,///< "usemtl"
+    OBJ_LINE_MATERIAL_LIBRARY///< "mtllib"
+};
+
+/// Corner of face, indices into positions, texture coordinates and normals of file, -1 when corner has none
+struct ObjCorner {
+    int position;///<position index of position
+    int texCoord;///<texCoord index of texture coordinate
+    int normal;///<normal index of normal
+};
+
+/// Statement which changes meshes, statements of all chunks are replayed in order of file
+struct ObjStatement {
+    ObjLineKind kind;///<kind face, object, group, material or library
+    size_t first;///<first corner of face in chunk or offset of name in file
+    size_t count;///<count number of corners of face or length of name
+};
+
+/// Part of file parsed by one thread
+struct ObjChunk {
+    const char* begin;///<begin first line of chunk
+    const char* end;///<end of last line of chunk
+    size_t positions = 0;///<positions number of positions of chunk
+    size_t texCoords = 0;///<texCoords number of texture coordinates of chunk
+    size_t normals = 0;///<normals number of normals of chunk
+    size_t firstPosition = 0;///<firstPosition index of first position of chunk in file
+    size_t firstTexCoord = 0;///<firstTexCoord index of first texture coordinate of chunk in file
+    size_t firstNormal = 0;///<firstNormal index of first normal of chunk in file
+    size_t cornerCount = 0;///<cornerCount number of corners of faces of chunk, found by count
+    size_t statementCount = 0;///<statementCount number of statements of chunk, found by count
+    ImportVector<ObjCorner> corners;///<corners of faces of chunk
+    ImportVector<ObjStatement> statements;///<statements of chunk in order
+    bool failed = false;///<failed chunk has line which Assimp does not accept
+};
+
+/// Material of MTL library
+struct ObjMaterial {
+    string name;///<name of material
+    glm::vec3 diffuse = glm::vec3(0.6f);///<diffuse color "Kd", Assimp gives 0.6 when it is missing
+    string diffuseMap;///<diffuseMap "map_Kd"
+    string specularMap;///<specularMap "map_Ks"
+    string ambientMap;///<ambientMap "map_Ka"
+    string bumpMap;///<bumpMap "map_bump" or "bump"
+};
+
+/// Face of mesh
+struct ObjFace {
+    const ObjCorner* corners;///<corners of face in its chunk
+    size_t count;///<count number of corners
+};
+
+/// Mesh of model, like Assimp every object, group and change of material starts new one
+struct ObjMesh {
+    string name;///<name of object, group or material
+    int material = -1;///<material index of material, -1 until it is set, default material is the first one
+    ImportVector<ObjFace> faces;///<faces of mesh
+    bool normals = false;///<normals some face has normals
+    bool texCoords = false;///<texCoords some face has texture coordinates
+    vector<Vertex> vertices;///<vertices of mesh, one per corner like by Assimp
+    vector<unsigned int> indices;///<indices of triangles
+};
+
+/// Object of model
+struct ObjObject {
+    string name;///<name of object or group
+    vector<size_t> meshes;///<meshes indices of meshes of object
+};
+
+/// Mapped OBJ file, file of pack points into pack
+struct ObjFileView {
+    const char* data = nullptr;///<data first byte of file
+    size_t size = 0;///<size of file
+    AssetData asset;///<asset packed or read file when file was not mapped
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;///<file handle of mapped file
+    HANDLE mapping = NULL;///<mapping of mapped file
+#else
+    void* mapped = nullptr;///<mapped file
+#endif
+
+    ObjFileView() {}
+    ObjFileView(const ObjFileView&) = delete;
+    ObjFileView& operator=(const ObjFileView&) = delete;
+    ~ObjFileView();
+};
+
+/// Parsed model
+struct ObjModel {
+    string path;///<path of model file
+    ObjFileView file;///<file mapped file
+    ImportVector<glm::vec3> positions;///<positions of file
+    ImportVector<glm::vec2> texCoords;///<texCoords texture coordinates of file
+    ImportVector<glm::vec3> normals;///<normals of file
+    vector<ObjChunk> chunks;///<chunks of file
+    vector<ObjMaterial> materials;///<materials default one and materials of library
+    vector<ObjMesh> meshes;///<meshes in order of objects, meshes without faces are removed
+};
+
+/// Loader state
+struct ObjLoader {
+    bool assimp = false;///<assimp OBJ files are imported by Assimp
+    bool benchmark = false;///<benchmark both importers are timed and compared on every model and program ends
+};
+ObjLoader objLoader;
+
+// Functions prototypes
+bool parseObjLoaderArgs(int argc, char** argv);
+bool loadObjModel(const string& path, ObjModel& model);
+bool mapObjFile(const string& path, ObjFileView& file);
+void splitObjChunks(ObjModel& model);
+void countObjChunk(ObjChunk& chunk);
+void parseObjChunk(ObjModel& model, ObjChunk& chunk);
+bool replayObjStatements(ObjModel& model);
+void loadObjMaterials(ObjModel& model, const string& name, int currentMesh, vector<ObjMesh>& meshes, int& currentMaterial,
+    unordered_map<string, int>& materialIndices);
+bool buildObjMesh(ObjModel& model, ObjMesh& mesh);
+void triangulateObjFace(const vector<Vertex>& vertices, unsigned int first, unsigned int count, vector<unsigned int>& indices,
+    ImportVector<glm::vec2>& points, ImportVector<bool>& done);
+void computeObjTangents(ObjMesh& mesh);
+void runObjJobs(size_t count, const function<void(size_t)>& job);
+ObjLineKind objLineKind(const char*& c, const char* end);
+bool parseObjFace(const char* c, const char* end, size_t positions, size_t texCoords, size_t normals, ImportVector<ObjCorner>& corners);
+int parseObjFloats(const char* c, const char* end, float* values, int maxValues);
+bool parseObjFloat(const char*& c, const char* end, float& value);
+uint64_t parseObjDigits(const char*& c, const char* end, unsigned int maxDigits, unsigned int& digits);
+uint64_t objEightDigits(uint64_t digits);
+double objArea2D(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c);
+bool objPointInTriangle(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& point);
+void objNormalizeSafe(glm::vec3& vector);
+string objName(const ObjModel& model, const ObjStatement& statement);
+string trimLine(const string& line);
+string textureOptionsSkipped(const string& rest);
+
+
+/// Parse arguments
+/**
+  Function that reads "--assimp-obj" and "--obj-benchmark" from command line
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseObjLoaderArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--assimp-obj")
+            objLoader.assimp = true;
+        else if (string(argv[i]) == "--obj-benchmark")
+            objLoader.benchmark = true;
+    }
+    return true;
+}
+
+/// Load model
+/**
+  Function that reads OBJ file with its MTL library without Assimp. Output is the same as output of Assimp with
+  aiProcess_Triangulate, aiProcess_FlipUVs and aiProcess_CalcTangentSpace, meshes are ready for Mesh.
+  File is split into chunks at lines, chunks are counted and parsed in parallel, statements which change meshes
+  are then replayed in order of file and meshes are triangulated in parallel. Returns false when Assimp fails too
+
+  \param[in] path of model file.
+  \param[out] model parsed model.
+*/
+bool loadObjModel(const string& path, ObjModel& model)
+{
+    model.path = path;
+    if (!mapObjFile(path, model.file))
+    {
+        cout << "ERROR OBJ: cannot read " << path << endl;
+        return false;
+    }
+    splitObjChunks(model);
+
+    // Indices of faces are global, so every chunk needs numbers of vertices of chunks before it
+    runObjJobs(model.chunks.size(), [&](size_t i) { countObjChunk(model.chunks[i]); });
+    size_t positions = 0, texCoords = 0, normals = 0;
+    for (auto& chunk : model.chunks)
+    {
+        chunk.firstPosition = positions;
+        chunk.firstTexCoord = texCoords;
+        chunk.firstNormal = normals;
+        positions += chunk.positions;
+        texCoords += chunk.texCoords;
+        normals += chunk.normals;
+    }
+    model.positions.resize(positions);
+    model.texCoords.resize(texCoords);
+    model.normals.resize(normals);
+
+    runObjJobs(model.chunks.size(), [&](size_t i) { parseObjChunk(model, model.chunks[i]); });
+    for (auto& chunk : model.chunks)
+    {
+        if (chunk.failed)
+        {
+            cout << "ERROR OBJ: " << path << " has statement which cannot be read" << endl;
+            return false;
+        }
+    }
+    if (!replayObjStatements(model))
+        return false;
+
+    atomic<bool> failed{ false };
+    runObjJobs(model.meshes.size(), [&](size_t i)
+    {
+        if (!buildObjMesh(model, model.meshes[i]))
+            failed = true;
+    });
+    if (failed)
+        cout << "ERROR OBJ: " << path << " has index out of range" << endl;
+    return !failed;
+}
+
+ObjFileView::~ObjFileView()
+{
+#ifdef _WIN32
+    if (mapping)
+    {
+        UnmapViewOfFile(data);
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+#else
+    if (mapped)
+        munmap(mapped, size);
+#endif
+}
+
+/// Map file
+/**
+  Function that gives bytes of file without copy, file of pack points into mapped pack and loose file is mapped.
+  File which cannot be mapped is read
+
+  \param[in] path of file.
+  \param[out] file mapped file.
+*/
+bool mapObjFile(const string& path, ObjFileView& file)
+{
+    if (!findAsset(path))
+    {
+#ifdef _WIN32
+        file.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        LARGE_INTEGER size;
+        if (file.file != INVALID_HANDLE_VALUE && GetFileSizeEx(file.file, &size) && size.QuadPart > 0)
+        {
+            file.mapping = CreateFileMappingA(file.file, NULL, PAGE_READONLY, 0, 0, NULL);
+            file.data = file.mapping ? (const char*)MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            file.size = (size_t)size.QuadPart;
+            if (file.data)
+                return true;
+        }
+#else
+        int descriptor = open(looseFilePath(path).c_str(), O_RDONLY);
+        struct stat info;
+        if (descriptor >= 0 && fstat(descriptor, &info) == 0 && info.st_size > 0)
+        {
+            void* mapped = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+            if (mapped != MAP_FAILED)
+            {
+                // Lines are read from start to end
+                madvise(mapped, (size_t)info.st_size, MADV_SEQUENTIAL);
+                file.mapped = mapped;
+                file.data = (const char*)mapped;
+                file.size = (size_t)info.st_size;
+            }
+        }
+        if (descriptor >= 0)
+            close(descriptor);
+        if (file.data)
+            return true;
+#endif
+    }
+    if (!readAsset(path, file.asset))
+        return false;
+    file.data = (const char*)file.asset.data;
+    file.size = file.asset.size;
+    return true;
+}
+
+/// Split chunks
+/**
+  Function that splits file into chunks of whole lines for threads
+
+  \param[in,out] model parsed model.
+*/
+void splitObjChunks(ObjModel& model)
+{
+    const char* data = model.file.data;
+    const char* end = data + model.file.size;
+    size_t count = max<size_t>(1, min<size_t>(model.file.size / objChunkBytes, max(thread::hardware_concurrency(), 1u) * 4));
+    size_t step = model.file.size / count + 1;
+    const char* begin = data;
+    while (begin < end)
+    {
+        const char* split = begin + min(step, (size_t)(end - begin));
+        const char* newline = split < end ? (const char*)memchr(split, '\n', end - split) : nullptr;
+        split = newline ? newline + 1 : end;
+
+        ObjChunk chunk;
+        chunk.begin = begin;
+        chunk.end = split;
+        model.chunks.push_back(std::move(chunk));
+        begin = split;
+    }
+}
+
+/// Count chunk
+/**
+  Function that counts positions, texture coordinates and normals of chunk, only keywords of lines are read
+
+  \param[in,out] chunk part of file.
+*/
+void countObjChunk(ObjChunk& chunk)
+{
+    for (const char* line = chunk.begin; line < chunk.end;)
+    {
+        const char* newline = (const char*)memchr(line, '\n', chunk.end - line);
+        const char* end = newline ? newline : chunk.end;
+        const char* c = line;
+        switch (objLineKind(c, end))
+        {
+        case OBJ_LINE_POSITION:
+            chunk.positions++;
+            break;
+        case OBJ_LINE_TEXCOORD:
+            chunk.texCoords++;
+            break;
+        case OBJ_LINE_NORMAL:
+            chunk.normals++;
+            break;
+        case OBJ_LINE_FACE:
+            // Every word of face is one corner
+            for (; c < end; c++)
+            {
+                if (*c != ' ' && *c != '\t' && *c != '\r' && (c[-1] == ' ' || c[-1] == '\t'))
+                    chunk.cornerCount++;
+            }
+            chunk.statementCount++;
+            break;
+        case OBJ_LINE_OBJECT:
+        case OBJ_LINE_GROUP:
+        case OBJ_LINE_USE_MATERIAL:
+        case OBJ_LINE_MATERIAL_LIBRARY:
+            chunk.statementCount++;
+            break;
+        default:
+            break;
+        }
+        line = end + 1;
+    }
+}
+
+/// Parse chunk
+/**
+  Function that writes vertices of chunk into arrays of model and records faces and statements which change meshes
+
+  \param[in,out] model parsed model, its arrays are sized already.
+  \param[in,out] chunk part of file.
+*/
+void parseObjChunk(ObjModel& model, ObjChunk& chunk)
+{
+    size_t positions = chunk.firstPosition, texCoords = chunk.firstTexCoord, normals = chunk.firstNormal;
+    chunk.corners.reserve(chunk.cornerCount);
+    chunk.statements.reserve(chunk.statementCount);
+    for (const char* line = chunk.begin; line < chunk.end && !chunk.failed;)
+    {
+        const char* newline = (const char*)memchr(line, '\n', chunk.end - line);
+        const char* end = newline ? newline : chunk.end;
+        const char* c = line;
+        ObjLineKind kind = objLineKind(c, end);
+        line = end + 1;
+
+        float values[7];
+        int count;
+        switch (kind)
+        {
+        case OBJ_LINE_POSITION:
+            // Homogeneous position is divided by w, color after position is skipped
+            count = parseObjFloats(c, end, values, 7);
+            chunk.failed = count < 3 || (count == 4 && values[3] == 0.0f);
+            if (!chunk.failed)
+                model.positions[positions++] = count == 4 ? glm::vec3(values[0], values[1], values[2]) / values[3] : glm::vec3(values[0], values[1], values[2]);
+            break;
+        case OBJ_LINE_TEXCOORD:
+            count = parseObjFloats(c, end, values, 7);
+            chunk.failed = count != 2 && count != 3;
+            if (!chunk.failed)
+                model.texCoords[texCoords++] = glm::vec2(isfinite(values[0]) ? values[0] : 0.0f, isfinite(values[1]) ? values[1] : 0.0f);
+            break;
+        case OBJ_LINE_NORMAL:
+            count = parseObjFloats(c, end, values, 7);
+            chunk.failed = count < 3;
+            if (!chunk.failed)
+                model.normals[normals++] = glm::vec3(values[0], values[1], values[2]);
+            break;
+        case OBJ_LINE_FACE:
+        {
+            size_t first = chunk.corners.size();
+            chunk.failed = !parseObjFace(c, end, positions, texCoords, normals, chunk.corners);
+            if (!chunk.failed && chunk.corners.size() > first)
+                chunk.statements.push_back({ kind, first, chunk.corners.size() - first });
+            break;
+        }
+        case OBJ_LINE_OBJECT:
+        case OBJ_LINE_GROUP:
+        case OBJ_LINE_USE_MATERIAL:
+        case OBJ_LINE_MATERIAL_LIBRARY:
+        {
+            // Object is named by first word, others by rest of line
+            while (c < end && (*c == ' ' || *c == '\t'))
+                c++;
+            const char* nameEnd = end;
+            if (kind == OBJ_LINE_OBJECT)
+            {
+                nameEnd = c;
+                while (nameEnd < end && *nameEnd != ' ' && *nameEnd != '\t' && *nameEnd != '\r')
+                    nameEnd++;
+            }
+            while (nameEnd > c && (nameEnd[-1] == ' ' || nameEnd[-1] == '\t' || nameEnd[-1] == '\r'))
+                nameEnd--;
+            chunk.statements.push_back({ kind, (size_t)(c - model.file.data), (size_t)(nameEnd - c) });
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+/// Replay statements
+/**
+  Function that builds meshes from statements of all chunks like parser of Assimp does. Object and group start
+  object with mesh, change of material starts mesh when current one has faces. Material library sets material
+  of current mesh by every new material, Assimp does so too
+
+  \param[in,out] model parsed model.
+*/
+bool replayObjStatements(ObjModel& model)
+{
+    vector<ObjObject> objects;
+    vector<ObjMesh> meshes;
+    unordered_map<string, int> materialIndices;
+    int currentObject = -1, currentMesh = -1, currentMaterial = -1;
+    string activeGroup;
+
+    ObjMaterial defaultMaterial;
+    defaultMaterial.name = "DefaultMaterial";
+    model.materials.push_back(defaultMaterial);
+    materialIndices[defaultMaterial.name] = 0;
+
+    auto createMesh = [&](const string& name)
+    {
+        ObjMesh mesh;
+        mesh.name = name;
+        meshes.push_back(std::move(mesh));
+        currentMesh = (int)meshes.size() - 1;
+        if (currentObject >= 0)
+            objects[currentObject].meshes.push_back(currentMesh);
+    };
+    auto createObject = [&](const string& name)
+    {
+        objects.push_back({ name, {} });
+        currentObject = (int)objects.size() - 1;
+        createMesh(name);
+        if (currentMaterial >= 0)
+            meshes[currentMesh].material = currentMaterial;
+    };
+
+    for (auto& chunk : model.chunks)
+    {
+        for (auto& statement : chunk.statements)
+        {
+            if (statement.kind == OBJ_LINE_FACE)
+            {
+                if (currentObject < 0)
+                    createObject("defaultobject");
+                if (currentMesh < 0)
+                    createMesh("defaultobject");
+                ObjMesh& mesh = meshes[currentMesh];
+                const ObjCorner* corners = chunk.corners.data() + statement.first;
+                mesh.faces.push_back({ corners, statement.count });
+                for (size_t i = 0; i < statement.count; i++)
+                {
+                    mesh.normals = mesh.normals || corners[i].normal >= 0;
+                    mesh.texCoords = mesh.texCoords || corners[i].texCoord >= 0;
+                }
+                continue;
+            }
+
+            string name = objName(model, statement);
+            if (statement.kind == OBJ_LINE_OBJECT && !name.empty())
+            {
+                auto found = find_if(objects.begin(), objects.end(), [&](const ObjObject& object) { return object.name == name; });
+                if (found != objects.end())
+                    currentObject = (int)(found - objects.begin());
+                else
+                    createObject(name);
+            }
+            else if (statement.kind == OBJ_LINE_GROUP && name != activeGroup)
+            {
+                createObject(name);
+                activeGroup = name;
+            }
+            else if (statement.kind == OBJ_LINE_USE_MATERIAL && !name.empty())
+            {
+                if (currentMaterial >= 0 && model.materials[currentMaterial].name == name)
+                    continue;
+                auto found = materialIndices.find(name);
+                if (found == materialIndices.end())
+                {
+                    // Material missing in library keeps its name and default values
+                    ObjMaterial material;
+                    material.name = name;
+                    model.materials.push_back(material);
+                    found = materialIndices.insert({ name, (int)model.materials.size() - 1 }).first;
+                }
+                currentMaterial = found->second;
+                if (currentMesh < 0 || (meshes[currentMesh].material >= 0 && meshes[currentMesh].material != currentMaterial &&
+                    !meshes[currentMesh].faces.empty()))
+                    createMesh(activeGroup.empty() ? name : activeGroup);
+                meshes[currentMesh].material = currentMaterial;
+            }
+            else if (statement.kind == OBJ_LINE_MATERIAL_LIBRARY && !name.empty())
+                loadObjMaterials(model, name, currentMesh, meshes, currentMaterial, materialIndices);
+        }
+    }
+
+    for (auto& object : objects)
+    {
+        for (size_t index : object.meshes)
+        {
+            if (meshes[index].faces.empty())
+                continue;
+            if (meshes[index].material < 0)
+                meshes[index].material = 0;
+            model.meshes.push_back(std::move(meshes[index]));
+        }
+    }
+    return true;
+}
+
+/// Load materials
+/**
+  Function that reads MTL library next to model, library named like model is read when it is missing
+
+  \param[in,out] model parsed model.
+  \param[in] name of library in "mtllib".
+  \param[in] currentMesh index of current mesh, -1 when there is none.
+  \param[in,out] meshes meshes of model.
+  \param[in,out] currentMaterial index of current material.
+  \param[in,out] materialIndices indices of materials by name.
+*/
+void loadObjMaterials(ObjModel& model, const string& name, int currentMesh, vector<ObjMesh>& meshes, int& currentMaterial,
+    unordered_map<string, int>& materialIndices)
+{
+    AssetData library;
+    string directory = model.path.substr(0, model.path.find_last_of("/\\"));
+    if (!readAsset(directory + '/' + name, library) && !readAsset(model.path.substr(0, model.path.size() - 3) + "mtl", library))
+    {
+        cout << "ERROR OBJ: cannot read material library " << name << endl;
+        return;
+    }
+
+    const char* text = (const char*)library.data;
+    size_t size = library.size;
+    for (size_t begin = 0; begin < size;)
+    {
+        const char* newline = (const char*)memchr(text + begin, '\n', size - begin);
+        size_t end = newline ? newline - text : size;
+        string line = trimLine(string(text + begin, end - begin));
+        begin = end + 1;
+
+        size_t space = line.find_first_of(" \t");
+        string keyword = line.substr(0, space);
+        for (auto& c : keyword)
+            c = (char)tolower((unsigned char)c);
+        string rest = space == string::npos ? string() : trimLine(line.substr(space + 1));
+
+        if (keyword == "newmtl")
+        {
+            string materialName = rest.empty() ? "DefaultMaterial" : rest;
+            auto found = materialIndices.find(materialName);
+            if (found != materialIndices.end())
+            {
+                currentMaterial = found->second;
+                continue;
+            }
+            ObjMaterial material;
+            material.name = materialName;
+            model.materials.push_back(material);
+            currentMaterial = (int)model.materials.size() - 1;
+            materialIndices[materialName] = currentMaterial;
+            if (currentMesh >= 0)
+                meshes[currentMesh].material = currentMaterial;
+            continue;
+        }
+        if (currentMaterial < 0)
+            continue;
+
+        ObjMaterial& material = model.materials[currentMaterial];
+        if (keyword == "kd")
+        {
+            // Single value is red only, Assimp reads it so
+            float values[3] = { 0.0f, 0.0f, 0.0f };
+            parseObjFloats(rest.data(), rest.data() + rest.size(), values, 3);
+            material.diffuse = glm::vec3(values[0], values[1], values[2]);
+        }
+        else if (keyword == "map_kd")
+            material.diffuseMap = textureOptionsSkipped(rest);
+        else if (keyword == "map_ks")
+            material.specularMap = textureOptionsSkipped(rest);
+        else if (keyword == "map_ka")
+            material.ambientMap = textureOptionsSkipped(rest);
+        else if (keyword == "map_bump" || keyword == "bump")
+            material.bumpMap = textureOptionsSkipped(rest);
+    }
+}
+
+/// Build mesh
+/**
+  Function that creates vertex for every corner of faces, triangulates faces and computes tangents.
+  Returns false when face points to missing position
+
+  \param[in] model parsed model.
+  \param[in,out] mesh mesh of model.
+*/
+bool buildObjMesh(ObjModel& model, ObjMesh& mesh)
+{
+    // Polygon of n corners gives n - 2 triangles, so vertices and indices are sized once
+    size_t count = 0, triangles = 0;
+    for (auto& face : mesh.faces)
+    {
+        count += face.count;
+        triangles += face.count >= 3 ? face.count - 2 : 0;
+    }
+    mesh.vertices.resize(count);
+    mesh.indices.reserve(triangles * 3);
+
+    // Mesh with broken normal or texture coordinate index has none of them, like in Assimp
+    const ObjMaterial& material = model.materials[mesh.material];
+    bool normals = mesh.normals && !model.normals.empty();
+    bool texCoords = mesh.texCoords && !model.texCoords.empty();
+    size_t index = 0;
+    for (auto& face : mesh.faces)
+    {
+        for (size_t i = 0; i < face.count; i++, index++)
+        {
+            const ObjCorner& corner = face.corners[i];
+            Vertex& vertex = mesh.vertices[index];
+            if (corner.position < 0 || (size_t)corner.position >= model.positions.size())
+                return false;
+            vertex.Position = model.positions[corner.position];
+            vertex.Normal = glm::vec3(0.0f);
+            vertex.TexCoords = glm::vec2(0.0f);
+            if (corner.normal >= 0)
+            {
+                normals = normals && (size_t)corner.normal < model.normals.size();
+                if (normals)
+                    vertex.Normal = model.normals[corner.normal];
+            }
+            if (corner.texCoord >= 0)
+            {
+                texCoords = texCoords && (size_t)corner.texCoord < model.texCoords.size();
+                if (texCoords)
+                    vertex.TexCoords = model.texCoords[corner.texCoord];
+            }
+            vertex.color = glm::vec4(material.diffuse, 1.0f);
+            vertex.useDiffuseTexture = material.diffuseMap.empty() ? 0.0f : 1.0f;
+            vertex.Tangent = glm::vec3(0.0f);
+            vertex.Bitangent = glm::vec3(0.0f);
+        }
+    }
+    for (auto& vertex : mesh.vertices)
+    {
+        if (!normals)
+            vertex.Normal = glm::vec3(0.0f);
+        // aiProcess_FlipUVs
+        vertex.TexCoords = texCoords ? glm::vec2(vertex.TexCoords.x, 1.0f - vertex.TexCoords.y) : glm::vec2(0.0f);
+    }
+
+    unsigned int first = 0;
+    ImportVector<glm::vec2> points;
+    ImportVector<bool> done;
+    for (auto& face : mesh.faces)
+    {
+        triangulateObjFace(mesh.vertices, first, (unsigned int)face.count, mesh.indices, points, done);
+        first += (unsigned int)face.count;
+    }
+
+    if (normals && texCoords)
+        computeObjTangents(mesh);
+    return true;
+}
+
+/// Triangulate face
+/**
+  Function that splits face into triangles like aiProcess_Triangulate. Quad is split from its concave corner,
+  larger polygon is cut by ears in plane of its Newell normal and is fanned when no ear is found.
+  Points and lines are dropped
+
+  \param[in] vertices of mesh.
+  \param[in] first vertex of face.
+  \param[in] count number of vertices of face.
+  \param[in,out] indices of triangles.
+  \param[in,out] points scratch of projected vertices, kept between faces of mesh.
+  \param[in,out] done scratch of cut vertices, kept between faces of mesh.
+*/
+void triangulateObjFace(const vector<Vertex>& vertices, unsigned int first, unsigned int count, vector<unsigned int>& indices,
+    ImportVector<glm::vec2>& points, ImportVector<bool>& done)
+{
+    if (count < 3)
+        return;
+    if (count == 3)
+    {
+        indices.insert(indices.end(), { first, first + 1, first + 2 });
+        return;
+    }
+    if (count == 4)
+    {
+        // Quad has at most one concave corner, triangles fan from it
+        unsigned int start = 0;
+        for (unsigned int i = 0; i < 4; i++)
+        {
+            const glm::vec3& v = vertices[first + i].Position;
+            glm::vec3 left = vertices[first + (i + 3) % 4].Position - v;
+            glm::vec3 diagonal = vertices[first + (i + 2) % 4].Position - v;
+            glm::vec3 right = vertices[first + (i + 1) % 4].Position - v;
+            objNormalizeSafe(left);
+            objNormalizeSafe(diagonal);
+            objNormalizeSafe(right);
+            float angle = acos(left.x * diagonal.x + left.y * diagonal.y + left.z * diagonal.z) +
+                acos(right.x * diagonal.x + right.y * diagonal.y + right.z * diagonal.z);
+            if (angle > 3.14159265358979323846f)
+            {
+                start = i;
+                break;
+            }
+        }
+        indices.insert(indices.end(), { first + start, first + (start + 1) % 4, first + (start + 2) % 4,
+            first + start, first + (start + 2) % 4, first + (start + 3) % 4 });
+        return;
+    }
+
+    // Newell normal, sums run over vertices with their neighbours
+    int max = (int)count;
+    glm::vec3 normal(0.0f);
+    for (int i = 0; i < max; i++)
+    {
+        const glm::vec3& previous = vertices[first + (i + max - 1) % max].Position;
+        const glm::vec3& current = vertices[first + i].Position;
+        const glm::vec3& next = vertices[first + (i + 1) % max].Position;
+        normal.z += current.x * (next.y - previous.y);
+        normal.x += current.y * (next.z - previous.z);
+        normal.y += current.z * (next.x - previous.x);
+    }
+    // Axis of largest component of normal is dropped, negative one swaps axes, so polygon stays counterclockwise
+    int a = 0, b = 1;
+    float inverse = normal.z;
+    float ax = fabs(normal.x), ay = fabs(normal.y), az = fabs(normal.z);
+    if (ax > ay)
+    {
+        if (ax > az)
+        {
+            a = 1;
+            b = 2;
+            inverse = normal.x;
+        }
+    }
+    else if (ay > az)
+    {
+        a = 2;
+        b = 0;
+        inverse = normal.y;
+    }
+    if (inverse < 0.0f)
+        swap(a, b);
+    points.resize(max);
+    done.assign(max, false);
+    for (int i = 0; i < max; i++)
+        points[i] = glm::vec2(vertices[first + i].Position[a], vertices[first + i].Position[b]);
+
+    size_t firstIndex = indices.size();
+    int remaining = max, ear = 0, previous = max - 1, next = 0;
+    while (remaining > 3)
+    {
+        int loops = 0;
+        for (ear = next;; previous = ear, ear = next)
+        {
+            // Stop after two loops without ear
+            for (next = ear + 1; done[next >= max ? next = 0 : next]; next++);
+            if (next < ear && ++loops == 2)
+                break;
+            // Ear is convex corner, no other point lies in it
+            if (objArea2D(points[previous], points[ear], points[next]) > 0.0)
+                continue;
+            int other = 0;
+            for (; other < max; other++)
+            {
+                const glm::vec2& point = points[other];
+                if (point != points[ear] && point != points[next] && point != points[previous] &&
+                    objPointInTriangle(points[previous], points[ear], points[next], point))
+                    break;
+            }
+            if (other == max)
+                break;
+        }
+        if (loops == 2)
+        {
+            // Polygon is not simple, it is fanned from its first vertex
+            indices.resize(firstIndex);
+            for (unsigned int i = 0; i + 2 < count; i++)
+                indices.insert(indices.end(), { first, first + i + 1, first + i + 2 });
+            return;
+        }
+        indices.insert(indices.end(), { first + previous, first + ear, first + next });
+        done[ear] = true;
+        remaining--;
+    }
+
+    int last[3], found = 0;
+    for (int i = 0; i < max; i++)
+    {
+        if (!done[i])
+            last[found++] = i;
+    }
+    indices.insert(indices.end(), { first + last[0], first + last[1], first + last[2] });
+}
+
+/// Compute tangents
+/**
+  Function that computes tangents and bitangents like aiProcess_CalcTangentSpace. Tangent of triangle is projected
+  into plane of normal of every its vertex, then tangents of vertices at the same position with the same normal
+  and close directions are averaged
+
+  \param[in,out] mesh mesh with normals and texture coordinates.
+*/
+void computeObjTangents(ObjMesh& mesh)
+{
+    vector<Vertex>& vertices = mesh.vertices;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+    {
+        const Vertex& v0 = vertices[mesh.indices[i]];
+        const Vertex& v1 = vertices[mesh.indices[i + 1]];
+        const Vertex& v2 = vertices[mesh.indices[i + 2]];
+        glm::vec3 v = v1.Position - v0.Position, w = v2.Position - v0.Position;
+        float sx = v1.TexCoords.x - v0.TexCoords.x, sy = v1.TexCoords.y - v0.TexCoords.y;
+        float tx = v2.TexCoords.x - v0.TexCoords.x, ty = v2.TexCoords.y - v0.TexCoords.y;
+        float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+        // Texture coordinates in one point give default directions
+        if (sx * ty == sy * tx)
+        {
+            sx = 0.0f;
+            sy = 1.0f;
+            tx = 1.0f;
+            ty = 0.0f;
+        }
+        glm::vec3 tangent = (w * sy - v * ty) * direction;
+        glm::vec3 bitangent = (w * sx - v * tx) * direction;
+
+        for (size_t j = i; j < i + 3; j++)
+        {
+            Vertex& vertex = vertices[mesh.indices[j]];
+            const glm::vec3& n = vertex.Normal;
+            glm::vec3 localTangent = tangent - n * (tangent.x * n.x + tangent.y * n.y + tangent.z * n.z);
+            glm::vec3 localBitangent = bitangent - n * (bitangent.x * n.x + bitangent.y * n.y + bitangent.z * n.z);
+            objNormalizeSafe(localTangent);
+            objNormalizeSafe(localBitangent);
+
+            // Broken direction is rebuilt from the other one
+            bool tangentValid = isfinite(localTangent.x) && isfinite(localTangent.y) && isfinite(localTangent.z);
+            bool bitangentValid = isfinite(localBitangent.x) && isfinite(localBitangent.y) && isfinite(localBitangent.z);
+            if (!tangentValid && bitangentValid)
+            {
+                localTangent = glm::cross(n, localBitangent);
+                objNormalizeSafe(localTangent);
+            }
+            else if (tangentValid && !bitangentValid)
+            {
+                localBitangent = glm::cross(localTangent, n);
+                objNormalizeSafe(localBitangent);
+            }
+            vertex.Tangent = localTangent;
+            vertex.Bitangent = localBitangent;
+        }
+    }
+
+    // Vertices are sorted by distance along oblique axis, close vertices are found by window of sorted distances
+    if (vertices.empty())
+        return;
+    glm::vec3 minPos = vertices[0].Position, maxPos = vertices[0].Position;
+    for (auto& vertex : vertices)
+    {
+        minPos = glm::min(minPos, vertex.Position);
+        maxPos = glm::max(maxPos, vertex.Position);
+    }
+    float epsilon = glm::length(maxPos - minPos) * 1e-4f;
+    glm::vec3 axis = glm::normalize(glm::vec3(0.8523f, 0.0005f, 0.5217f));
+    ImportVector<pair<float, unsigned int>> sorted(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+        sorted[i] = { glm::dot(vertices[i].Position, axis), (unsigned int)i };
+    sort(sorted.begin(), sorted.end());
+
+    const float normalLimit = 0.9999f;
+    const float angleLimit = cos(glm::radians(45.0f));
+    ImportVector<bool> done(vertices.size(), false);
+    ImportVector<unsigned int> close;
+    for (size_t a = 0; a < vertices.size(); a++)
+    {
+        if (done[a])
+            continue;
+        const Vertex& origin = vertices[a];
+        float distance = glm::dot(origin.Position, axis);
+        close.assign(1, (unsigned int)a);
+        auto it = lower_bound(sorted.begin(), sorted.end(), make_pair(distance - epsilon, 0u));
+        for (; it != sorted.end() && it->first < distance + epsilon; ++it)
+        {
+            unsigned int b = it->second;
+            glm::vec3 offset = vertices[b].Position - origin.Position;
+            if (done[b] || glm::dot(offset, offset) >= epsilon * epsilon)
+                continue;
+            // Vertex itself is found too, it is summed twice like in Assimp
+            if (glm::dot(vertices[b].Normal, origin.Normal) < normalLimit || glm::dot(vertices[b].Tangent, origin.Tangent) < angleLimit ||
+                glm::dot(vertices[b].Bitangent, origin.Bitangent) < angleLimit)
+                continue;
+            close.push_back(b);
+            done[b] = true;
+        }
+
+        glm::vec3 tangent(0.0f), bitangent(0.0f);
+        for (unsigned int b : close)
+        {
+            tangent += vertices[b].Tangent;
+            bitangent += vertices[b].Bitangent;
+        }
+        objNormalizeSafe(tangent);
+        objNormalizeSafe(bitangent);
+        for (unsigned int b : close)
+        {
+            vertices[b].Tangent = tangent;
+            vertices[b].Bitangent = bitangent;
+        }
+    }
+}
+
+/// Run jobs
+/**
+  Function that runs jobs on all cores and waits for them, single job runs on calling thread
+
+  \param[in] count number of jobs.
+  \param[in] job function of job index.
+*/
+void runObjJobs(size_t count, const function<void(size_t)>& job)
+{
+    if (count <= 1)
+    {
+        if (count == 1)
+            job(0);
+        return;
+    }
+    atomic<size_t> next{ 0 };
+    size_t workers = min<size_t>(max(thread::hardware_concurrency(), 1u), count);
+    // Workers allocate from arena of import which started them
+    ImportArena* arena = boundImportArena;
+    vector<thread> threads;
+    for (size_t i = 1; i < workers; i++)
+    {
+        threads.push_back(thread([&]
+        {
+            bindImportArena(arena);
+            for (size_t index = next++; index < count; index = next++)
+                job(index);
+        }));
+    }
+    for (size_t index = next++; index < count; index = next++)
+        job(index);
+    for (auto& worker : threads)
+        worker.join();
+}
+
+/// Line kind
+/**
+  Function that returns kind of line by its keyword and moves pointer after keyword
+
+  \param[in,out] c first character of line, then character after keyword.
+  \param[in] end of line.
+*/
+ObjLineKind objLineKind(const char*& c, const char* end)
+{
+    while (c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    const char* keyword = c;
+    while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+        c++;
+    size_t length = c - keyword;
+    if (length == 0 || c == end || *c == '\r')
+        return OBJ_LINE_OTHER;
+
+    switch (keyword[0])
+    {
+    case 'v':
+        if (length == 1)
+            return OBJ_LINE_POSITION;
+        if (length == 2 && keyword[1] == 't')
+            return OBJ_LINE_TEXCOORD;
+        if (length == 2 && keyword[1] == 'n')
+            return OBJ_LINE_NORMAL;
+        break;
+    case 'f':
+        if (length == 1)
+            return OBJ_LINE_FACE;
+        break;
+    case 'o':
+        if (length == 1)
+            return OBJ_LINE_OBJECT;
+        break;
+    case 'g':
+        if (length == 1)
+            return OBJ_LINE_GROUP;
+        break;
+    case 'u':
+        if (length == 6 && memcmp(keyword, "usemtl", 6) == 0)
+            return OBJ_LINE_USE_MATERIAL;
+        break;
+    case 'm':
+        if (length == 6 && memcmp(keyword, "mtllib", 6) == 0)
+            return OBJ_LINE_MATERIAL_LIBRARY;
+        break;
+    }
+    return OBJ_LINE_OTHER;
+}
+
+/// Parse face
+/**
+  Function that reads corners "v", "v/vt", "v//vn" and "v/vt/vn" of face. Negative index counts from last vertex read
+  before face. Index without texture coordinates in file is normal, Assimp reads it so
+
+  \param[in] c first character after keyword.
+  \param[in] end of line.
+  \param[in] positions number of positions before face.
+  \param[in] texCoords number of texture coordinates before face.
+  \param[in] normals number of normals before face.
+  \param[in,out] corners corners of chunk.
+*/
+bool parseObjFace(const char* c, const char* end, size_t positions, size_t texCoords, size_t normals, ImportVector<ObjCorner>& corners)
+{
+    ObjCorner corner = { -1, -1, -1 };
+    int slot = 0;
+    bool started = false;
+    for (; c <= end; c++)
+    {
+        if (c == end || *c == ' ' || *c == '\t' || *c == '\r')
+        {
+            if (started)
+                corners.push_back(corner);
+            corner = { -1, -1, -1 };
+            slot = 0;
+            started = false;
+            continue;
+        }
+        if (*c == '/')
+        {
+            slot++;
+            continue;
+        }
+
+        bool negative = *c == '-';
+        if (negative || *c == '+')
+            c++;
+        unsigned int digits;
+        long long value = (long long)parseObjDigits(c, end, 10, digits);
+        if (digits == 0 || value == 0)
+            return false;
+        c--;
+        if (slot == 1 && texCoords == 0 && normals > 0)
+            slot = 2;
+        size_t count = slot == 0 ? positions : slot == 1 ? texCoords : normals;
+        long long index = negative ? (long long)count - value : value - 1;
+        if (slot > 2 || index < 0 || index > INT32_MAX)
+            return false;
+        (slot == 0 ? corner.position : slot == 1 ? corner.texCoord : corner.normal) = (int)index;
+        started = true;
+    }
+    return true;
+}
+
+/// Parse floats
+/**
+  Function that reads numbers separated by spaces until end of line, returns their count
+
+  \param[in] c first character.
+  \param[in] end of line.
+  \param[out] values read numbers, numbers after maxValues are counted only.
+  \param[in] maxValues size of values.
+*/
+int parseObjFloats(const char* c, const char* end, float* values, int maxValues)
+{
+    int count = 0;
+    float value;
+    while (true)
+    {
+        while (c < end && (*c == ' ' || *c == '\t' || *c == '\r'))
+            c++;
+        if (c == end || !parseObjFloat(c, end, value))
+            return count;
+        if (count < maxValues)
+            values[count] = value;
+        count++;
+        // Rest of word is skipped like by Assimp
+        while (c < end && *c != ' ' && *c != '\t' && *c != '\r')
+            c++;
+    }
+}
+
+/// Parse float
+/**
+  Function that reads number with the same rounding as fast_atof of Assimp: integer part and first 15 digits of fraction
+  are read as integers by SSE, fraction is scaled in double. Comma is decimal point too
+
+  \param[in,out] c first character of number, then character after it.
+  \param[in] end of line.
+  \param[out] value read number.
+*/
+bool parseObjFloat(const char*& c, const char* end, float& value)
+{
+    static const double decimalScale[16] = { 0.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001, 0.00000001, 0.000000001,
+        0.0000000001, 0.00000000001, 0.000000000001, 0.0000000000001, 0.00000000000001, 0.000000000000001 };
+    bool negative = c < end && *c == '-';
+    if (c < end && (*c == '-' || *c == '+'))
+        c++;
+    if (end - c >= 3 && (c[0] == 'n' || c[0] == 'N') && (c[1] == 'a' || c[1] == 'A') && (c[2] == 'n' || c[2] == 'N'))
+    {
+        value = numeric_limits<float>::quiet_NaN();
+        c += 3;
+        return true;
+    }
+    if (end - c >= 3 && (c[0] == 'i' || c[0] == 'I') && (c[1] == 'n' || c[1] == 'N') && (c[2] == 'f' || c[2] == 'F'))
+    {
+        value = negative ? -numeric_limits<float>::infinity() : numeric_limits<float>::infinity();
+        c += 3;
+        return true;
+    }
+
+    bool digit = c < end && *c >= '0' && *c <= '9';
+    bool point = end - c >= 2 && (*c == '.' || *c == ',') && c[1] >= '0' && c[1] <= '9';
+    if (!digit && !point)
+        return false;
+    float result = 0.0f;
+    unsigned int digits;
+    if (digit)
+        result = (float)parseObjDigits(c, end, UINT32_MAX, digits);
+    if (end - c >= 2 && (*c == '.' || *c == ',') && c[1] >= '0' && c[1] <= '9')
+    {
+        c++;
+        double fraction = (double)parseObjDigits(c, end, 15, digits);
+        while (c < end && *c >= '0' && *c <= '9')
+            c++;
+        result += (float)(fraction * decimalScale[digits]);
+    }
+    else if (c < end && *c == '.')
+        c++;
+
+    if (c < end && (*c == 'e' || *c == 'E'))
+    {
+        c++;
+        bool negativeExponent = c < end && *c == '-';
+        if (c < end && (*c == '-' || *c == '+'))
+            c++;
+        float exponent = (float)parseObjDigits(c, end, UINT32_MAX, digits);
+        if (digits == 0)
+            return false;
+        result *= pow(10.0f, negativeExponent ? -exponent : exponent);
+    }
+    value = negative ? -result : result;
+    return true;
+}
+
+/// Parse digits
+/**
+  Function that reads decimal integer of at most maxDigits digits. With SSE2 run of digits is found by one compare
+  of 16 characters and up to 8 digits are converted at once
+
+  \param[in,out] c first digit, then character after read digits.
+  \param[in] end of line.
+  \param[in] maxDigits maximum number of read digits.
+  \param[out] digits number of read digits.
+*/
+uint64_t parseObjDigits(const char*& c, const char* end, unsigned int maxDigits, unsigned int& digits)
+{
+    static const uint64_t powers[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+    uint64_t value = 0;
+    digits = 0;
+#ifdef OBJ_SSE2
+    while (end - c >= 16 && digits < maxDigits)
+    {
+        __m128i characters = _mm_loadu_si128((const __m128i*)c);
+        __m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(characters, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(characters, _mm_set1_epi8('9' + 1)));
+        unsigned int notDigits = ~(unsigned int)_mm_movemask_epi8(isDigit);
+#ifdef _MSC_VER
+        unsigned long run;
+        _BitScanForward(&run, notDigits);
+#else
+        unsigned int run = __builtin_ctz(notDigits);
+#endif
+        unsigned int take = min<unsigned int>(min<unsigned int>((unsigned int)run, 8), maxDigits - digits);
+        if (take == 0)
+            return value;
+
+        // Digits are moved to high bytes, so missing ones are leading zeros
+        uint64_t word;
+        memcpy(&word, c, sizeof(word));
+        word = (word - 0x3030303030303030ull) << (8 * (8 - take));
+        value = value * powers[take] + objEightDigits(word);
+        c += take;
+        digits += take;
+        if (take < 8)
+            return value;
+    }
+#endif
+    while (c < end && *c >= '0' && *c <= '9' && digits < maxDigits)
+    {
+        value = value * 10 + (uint64_t)(*c - '0');
+        c++;
+        digits++;
+    }
+    return value;
+}
+
+/// Eight digits
+/**
+  Function that converts 8 digits stored in bytes, the first one in the lowest byte, by three multiplications
+
+  \param[in] digits values 0..9 of digits.
+*/
+uint64_t objEightDigits(uint64_t digits)
+{
+    const uint64_t mask = 0x000000FF000000FFull;
+    const uint64_t multiplier1 = 100 + (1000000ull << 32);
+    const uint64_t multiplier2 = 1 + (10000ull << 32);
+    digits = digits * 10 + (digits >> 8);
+    return (((digits & mask) * multiplier1) + (((digits >> 16) & mask) * multiplier2)) >> 32;
+}
+
+/// Area 2D
+/**
+  Function that returns signed area of triangle like Assimp, it is negative for counterclockwise triangle
+
+  \param[in] a first point.
+  \param[in] b second point.
+  \param[in] c third point.
+*/
+double objArea2D(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c)
+{
+    return 0.5 * (a.x * ((double)c.y - b.y) + b.x * ((double)a.y - c.y) + c.x * ((double)b.y - a.y));
+}
+
+/// Point in triangle
+/**
+  Function that tests point against inside of triangle by barycentric coordinates
+
+  \param[in] p0 first point of triangle.
+  \param[in] p1 second point of triangle.
+  \param[in] p2 third point of triangle.
+  \param[in] point tested point.
+*/
+bool objPointInTriangle(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& point)
+{
+    glm::vec2 v0 = p1 - p0, v1 = p2 - p0, v2 = point - p0;
+    double dot00 = v0.x * v0.x + v0.y * v0.y;
+    double dot01 = v0.x * v1.x + v0.y * v1.y;
+    double dot02 = v0.x * v2.x + v0.y * v2.y;
+    double dot11 = v1.x * v1.x + v1.y * v1.y;
+    double dot12 = v1.x * v2.x + v1.y * v2.y;
+    double inverse = 1 / (dot00 * dot11 - dot01 * dot01);
+    double u = (dot11 * dot02 - dot01 * dot12) * inverse;
+    double v = (dot00 * dot12 - dot01 * dot02) * inverse;
+    return u > 0 && v > 0 && u + v < 1;
+}
+
+/// Normalize safe
+/**
+  Function that normalizes vector, zero vector stays zero
+
+  \param[in,out] vector normalized vector.
+*/
+void objNormalizeSafe(glm::vec3& vector)
+{
+    float length = sqrt(vector.x * vector.x + vector.y * vector.y + vector.z * vector.z);
+    if (length > 0.0f)
+        vector *= 1.0f / length;
+}
+
+/// Name
+/**
+  Function that returns name of statement
+
+  \param[in] model parsed model.
+  \param[in] statement object, group, material or library.
+*/
+string objName(const ObjModel& model, const ObjStatement& statement)
+{
+    return string(model.file.data + statement.first, statement.count);
+}
+
+/// Trim line
+/**
+  Function that removes spaces and carriage return around line
+
+  \param[in] line of text.
+*/
+string trimLine(const string& line)
+{
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == string::npos)
+        return string();
+    size_t end = line.find_last_not_of(" \t\r");
+    return line.substr(begin, end - begin + 1);
+}
+
+/// Skip texture options
+/**
+  Function that returns name of texture after options of statement, like "-bm 0.5 normal.png"
+
+  \param[in] rest of statement after keyword.
+*/
+string textureOptionsSkipped(const string& rest)
+{
+    // Number of values of options
+    static const pair<const char*, int> options[] = {
+        { "-blendu", 1 }, { "-blendv", 1 }, { "-boost", 1 }, { "-cc", 1 }, { "-clamp", 1 }, { "-imfchan", 1 },
+        { "-texres", 1 }, { "-type", 1 }, { "-bm", 1 }, { "-mm", 2 }, { "-o", 3 }, { "-s", 3 }, { "-t", 3 }
+    };
+    string name = rest;
+    bool skipped = true;
+    while (skipped && !name.empty() && name[0] == '-')
+    {
+        skipped = false;
+        for (auto& option : options)
+        {
+            size_t length = strlen(option.first);
+            if (name.compare(0, length, option.first) != 0 || (name.size() > length && name[length] != ' ' && name[length] != '\t'))
+                continue;
+            size_t position = length;
+            for (int value = 0; value <= option.second && position != string::npos; value++)
+            {
+                position = name.find_first_not_of(" \t", position);
+                if (value < option.second && position != string::npos)
+                    position = name.find_first_of(" \t", position);
+            }
+            name = position == string::npos ? string() : name.substr(position);
+            skipped = true;
+            break;
+        }
+    }
+    return name;
+}
+
+#endif
@@ -0,0 +1,181 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    oit.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Weighted blended order-independent transparency for windows and water
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef OIT_H
+#define OIT_H
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "data.h"
+#include "ShaderGen.h"
+
+/// Targets of transparent pass
+/**
+  accumTexture.rgb holds sum of weighted premultiplied colors and accumTexture.a holds revealage
+  (product of 1 - alpha), weightTexture.r holds sum of weighted alphas.
+  Both targets use one blend function, because GL 3.3 has no blend function per draw buffer.
+*/
+struct OITBuffers {
+    unsigned int FBO;///<FBO framebuffer of transparent pass
+    unsigned int accumTexture;///<accumTexture RGBA16F color accumulation and revealage
+    unsigned int weightTexture;///<weightTexture R16F accumulation of weights
+    unsigned int depthRBO;///<depthRBO copy of opaque depth and stencil
+    unsigned int quadVAO;///<quadVAO fullscreen quad for composite
+    unsigned int compositeProgram;///<compositeProgram shader program of composite
+    int width = 0;///<width of targets
+    int height = 0;///<height of targets
+};
+OITBuffers oitBuffers;
+
+// Functions prototypes
+void initOIT(ShaderGen& compositeShader);
+void resizeOIT(int width, int height);
+void beginTransparentPass();
+void endTransparentPass();
+void compositeTransparent();
+
+
+/// Init OIT
+/**
+  Function that creates framebuffer and fullscreen quad of transparent pass
+
+  \param[in] compositeShader shader that resolves transparent pass into scene.
+*/
+void initOIT(ShaderGen& compositeShader)
+{
+    glGenFramebuffers(1, &oitBuffers.FBO);
+    glGenTextures(1, &oitBuffers.accumTexture);
+    glGenTextures(1, &oitBuffers.weightTexture);
+    glGenRenderbuffers(1, &oitBuffers.depthRBO);
+
+    oitBuffers.compositeProgram = compositeShader.ID;
+    compositeShader.use();
+    glUniform1i(glGetUniformLocation(compositeShader.ID, "accumTexture"), 0);
+    glUniform1i(glGetUniformLocation(compositeShader.ID, "weightTexture"), 1);
+
+    // Fullscreen quad as two triangles
+    float quadVertices[] = {
+        -1.0f, -1.0f,   1.0f, -1.0f,   1.0f,  1.0f,
+        -1.0f, -1.0f,   1.0f,  1.0f,  -1.0f,  1.0f
+    };
+    unsigned int quadVBO;
+    glGenVertexArrays(1, &oitBuffers.quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(oitBuffers.quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+
+    resizeOIT(SCR_WIDTH, SCR_HEIGHT);
+}
+
+/// Resize OIT
+/**
+  Function that (re)allocates targets of transparent pass
+
+  \param[in] width of targets.
+  \param[in] height of targets.
+*/
+void resizeOIT(int width, int height)
+{
+    oitBuffers.width = width;
+    oitBuffers.height = height;
+
+    glBindTexture(GL_TEXTURE_2D, oitBuffers.accumTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glBindTexture(GL_TEXTURE_2D, oitBuffers.weightTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Depth and stencil format must match default framebuffer for blit
+    glBindRenderbuffer(GL_RENDERBUFFER, oitBuffers.depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, oitBuffers.FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, oitBuffers.accumTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, oitBuffers.weightTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, oitBuffers.depthRBO);
+    unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        cout << "ERROR: OIT FRAMEBUFFER NOT COMPLETE" << endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+}
+
+/// Begin transparent pass
+/**
+  Function that copies opaque depth of scene framebuffer into transparent framebuffer, clears targets and sets
+  additive blending. Transparent objects are tested against opaque depth, but do not write it
+*/
+void beginTransparentPass()
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] != oitBuffers.width || viewport[3] != oitBuffers.height)
+        resizeOIT(viewport[2], viewport[3]);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oitBuffers.FBO);
+    glBlitFramebuffer(0, 0, oitBuffers.width, oitBuffers.height, 0, 0, oitBuffers.width, oitBuffers.height,
+        GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, oitBuffers.FBO);
+
+    // Accumulation starts at zero, revealage at one
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glDepthMask(GL_FALSE);
+    glBlendFuncSeparate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/// End transparent pass
+/**
+  Function that restores framebuffer and state of opaque rendering
+*/
+void endTransparentPass()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glDepthMask(GL_TRUE);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+/// Composite transparent pass
+/**
+  Function that blends average transparent color over opaque scene by revealage
+*/
+void compositeTransparent()
+{
+    glDisable(GL_DEPTH_TEST);
+    glStencilMask(0x00);
+    glBlendFunc(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+    glUseProgram(oitBuffers.compositeProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, oitBuffers.accumTexture);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, oitBuffers.weightTexture);
+    glBindVertexArray(oitBuffers.quadVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glStencilMask(0xFF);
+    glEnable(GL_DEPTH_TEST);
+}
+
+#endif
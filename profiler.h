@@ -0,0 +1,332 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    profiler.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Scoped CPU profiler with GPU timestamp queries and Chrome trace export
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "data.h"
+
+#define N_PROFILER_FRAMES 4
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// PROFILER_DISABLED removes all scopes from build
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name)
+#else
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#endif
+
+/// Measured scope
+struct ProfileEvent {
+    const char* name;///<name of scope, must be string literal
+    long long cpuBegin;///<cpuBegin CPU time of begin in microseconds
+    long long cpuEnd;///<cpuEnd CPU time of end in microseconds
+    unsigned int gpuBegin;///<gpuBegin timestamp query of begin
+    unsigned int gpuEnd;///<gpuEnd timestamp query of end
+};
+
+/// Scopes of one frame, they wait for GPU results until the slot is reused
+struct ProfileFrame {
+    vector<ProfileEvent> events;///<events scopes of frame
+    vector<unsigned int> queries;///<queries pool of timestamp queries
+    unsigned int usedQueries = 0;///<usedQueries number of queries used in frame
+};
+
+/// Event of trace file
+struct TraceEvent {
+    const char* name;///<name of scope
+    long long begin;///<begin in microseconds
+    long long duration;///<duration in microseconds
+    bool gpu;///<gpu event is placed on GPU track
+};
+
+/// Smoothed time of pass, all scopes with the same name in frame are summed
+struct ProfilePass {
+    const char* name;///<name of scope
+    double cpuMs;///<cpuMs smoothed CPU time
+    double gpuMs;///<gpuMs smoothed GPU time
+    double frameCpuMs;///<frameCpuMs CPU time in resolved frame
+    double frameGpuMs;///<frameGpuMs GPU time in resolved frame
+};
+
+/// Profiler state
+struct Profiler {
+    bool enable = false;///<enable profiler is recording, for trace or HUD
+    string tracePath;///<tracePath output of trace JSON, empty when trace is not written
+    vector<ProfilePass> passes;///<passes smoothed times of scopes for HUD
+    ProfileFrame frames[N_PROFILER_FRAMES];///<frames ring of frames waiting for GPU
+    int current = 0;///<current frame in ring
+    vector<TraceEvent> trace;///<trace resolved events
+    chrono::steady_clock::time_point cpuStart;///<cpuStart CPU time of profiler start
+    GLint64 gpuStart = 0;///<gpuStart GPU time of profiler start in nanoseconds
+};
+Profiler profiler;
+
+// Innermost scope, GL statistics are grouped by it
+const char* profilerScope = "frame";
+
+// Functions prototypes
+bool parseProfilerArgs(int argc, char** argv);
+void initProfiler();
+void beginProfilerFrame();
+void finishProfiler();
+
+int profilerBegin(const char* name);
+void profilerEnd(int index);
+long long profilerCpuTime();
+unsigned int profilerTimestamp(ProfileFrame& frame);
+void resolveProfilerFrame(ProfileFrame& frame);
+ProfilePass& profilePass(const char* name);
+void writeTrace();
+
+/// Scope guard
+/**
+  Measures CPU and GPU time from construction to end of scope
+*/
+class ProfileScope
+{
+public:
+    ProfileScope(const char* name)
+    {
+        index = profiler.enable ? profilerBegin(name) : -1;
+#ifdef GL_STATS
+        parent = profilerScope;
+        profilerScope = name;
+#endif
+    }
+    ~ProfileScope()
+    {
+        if (index >= 0) profilerEnd(index);
+#ifdef GL_STATS
+        profilerScope = parent;
+#endif
+    }
+private:
+    int index;///<index of event in current frame
+#ifdef GL_STATS
+    const char* parent;///<parent scope
+#endif
+};
+
+
+/// Parse arguments
+/**
+  Function that reads "--trace out.json" from command line, returns false on bad arguments
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseProfilerArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) != "--trace")
+            continue;
+
+        if (i + 1 >= argc)
+        {
+            cout << "Usage: --trace <output.json>" << endl;
+            return false;
+        }
+        profiler.enable = true;
+        profiler.tracePath = argv[i + 1];
+    }
+    return true;
+}
+
+/// Init profiler
+/**
+  Function that synchronizes CPU and GPU clocks, profiler can be enabled later by HUD
+*/
+void initProfiler()
+{
+    profiler.cpuStart = chrono::steady_clock::now();
+    glGetInteger64v(GL_TIMESTAMP, &profiler.gpuStart);
+}
+
+/// CPU time
+/**
+  Function that returns microseconds from profiler start
+*/
+long long profilerCpuTime()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - profiler.cpuStart).count();
+}
+
+/// GPU timestamp
+/**
+  Function that issues timestamp query from pool of frame
+
+  \param[in] frame current frame.
+*/
+unsigned int profilerTimestamp(ProfileFrame& frame)
+{
+    if (frame.usedQueries == frame.queries.size())
+    {
+        unsigned int query;
+        glGenQueries(1, &query);
+        frame.queries.push_back(query);
+    }
+    unsigned int query = frame.queries[frame.usedQueries++];
+    glQueryCounter(query, GL_TIMESTAMP);
+    return query;
+}
+
+/// Begin scope
+/**
+  Function that starts scope and returns its index in frame
+
+  \param[in] name of scope.
+*/
+int profilerBegin(const char* name)
+{
+    ProfileFrame& frame = profiler.frames[profiler.current];
+    ProfileEvent event;
+    event.name = name;
+    event.gpuBegin = profilerTimestamp(frame);
+    event.gpuEnd = 0;
+    event.cpuBegin = profilerCpuTime();
+    event.cpuEnd = event.cpuBegin;
+    frame.events.push_back(event);
+    return (int)frame.events.size() - 1;
+}
+
+/// End scope
+/**
+  Function that stops scope
+
+  \param[in] index of scope in frame.
+*/
+void profilerEnd(int index)
+{
+    ProfileFrame& frame = profiler.frames[profiler.current];
+    ProfileEvent& event = frame.events[index];
+    event.cpuEnd = profilerCpuTime();
+    event.gpuEnd = profilerTimestamp(frame);
+}
+
+/// Begin frame
+/**
+  Function that moves to next slot of ring and resolves its scopes from a few frames ago
+*/
+void beginProfilerFrame()
+{
+    if (!profiler.enable)
+        return;
+    profiler.current = (profiler.current + 1) % N_PROFILER_FRAMES;
+    resolveProfilerFrame(profiler.frames[profiler.current]);
+}
+
+/// Resolve frame
+/**
+  Function that reads GPU timestamps of frame and moves its scopes into trace.
+  Frame was issued N_PROFILER_FRAMES ago, so results are usually available without waiting
+
+  \param[in] frame resolved frame.
+*/
+void resolveProfilerFrame(ProfileFrame& frame)
+{
+    if (frame.events.empty())
+        return;
+
+    for (auto& pass : profiler.passes)
+    {
+        pass.frameCpuMs = 0.0;
+        pass.frameGpuMs = 0.0;
+    }
+    for (auto& event : frame.events)
+    {
+        GLuint64 gpuBegin = 0, gpuEnd = 0;
+        glGetQueryObjectui64v(event.gpuBegin, GL_QUERY_RESULT, &gpuBegin);
+        glGetQueryObjectui64v(event.gpuEnd, GL_QUERY_RESULT, &gpuEnd);
+
+        ProfilePass& pass = profilePass(event.name);
+        pass.frameCpuMs += (event.cpuEnd - event.cpuBegin) / 1000.0;
+        pass.frameGpuMs += (gpuEnd - gpuBegin) / 1.0e6;
+
+        if (profiler.tracePath.empty())
+            continue;
+        profiler.trace.push_back({ event.name, event.cpuBegin, event.cpuEnd - event.cpuBegin, false });
+        long long begin = ((long long)gpuBegin - profiler.gpuStart) / 1000;
+        profiler.trace.push_back({ event.name, begin, (long long)(gpuEnd - gpuBegin) / 1000, true });
+    }
+    for (auto& pass : profiler.passes)
+    {
+        pass.cpuMs = pass.cpuMs * (1.0 - profilerSmoothing) + pass.frameCpuMs * profilerSmoothing;
+        pass.gpuMs = pass.gpuMs * (1.0 - profilerSmoothing) + pass.frameGpuMs * profilerSmoothing;
+    }
+    frame.events.clear();
+    frame.usedQueries = 0;
+}
+
+/// Pass times
+/**
+  Function that returns smoothed times of scope, scopes are kept in order of first appearance
+
+  \param[in] name of scope.
+*/
+ProfilePass& profilePass(const char* name)
+{
+    for (auto& pass : profiler.passes)
+    {
+        if (pass.name == name)
+            return pass;
+    }
+    profiler.passes.push_back({ name, 0.0, 0.0, 0.0, 0.0 });
+    return profiler.passes.back();
+}
+
+/// Finish profiler
+/**
+  Function that resolves remaining frames and writes trace
+*/
+void finishProfiler()
+{
+    if (profiler.tracePath.empty())
+        return;
+    for (int i = 1; i <= N_PROFILER_FRAMES; i++)
+        resolveProfilerFrame(profiler.frames[(profiler.current + i) % N_PROFILER_FRAMES]);
+    writeTrace();
+}
+
+/// Write trace
+/**
+  Function that writes events in Chrome trace format, it is opened by chrome://tracing or Perfetto
+*/
+void writeTrace()
+{
+    ofstream file(profiler.tracePath);
+    if (!file)
+    {
+        cout << "Failed to write trace to " << profiler.tracePath << endl;
+        return;
+    }
+    file << "{\"traceEvents\":[" << endl;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << endl;
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+    for (auto& event : profiler.trace)
+    {
+        file << "," << endl << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+             << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << "}";
+    }
+    file << endl << "]}" << endl;
+    cout << "Trace saved to " << profiler.tracePath << " (" << profiler.trace.size() << " events)" << endl;
+}
+
+#endif
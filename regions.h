@@ -0,0 +1,506 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    regions.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Named regions of scene whose models are streamed in and out by distance of camera, nearest models first
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data.h"
+#include "Model.h"
+#include "render_queue.h"
+#include "content_registry.h"
+#include "texture_pipeline.h"
+
+/// State of region
+enum RegionState {
+    REGION_UNLOADED,
+    REGION_LOADING,
+    REGION_LOADED
+};
+
+/// Model placed in region
+struct RegionModel {
+    Model* model;///<model slot in Models, empty while region is unloaded
+    string path;///<path of model file
+    int id;///<id of model
+};
+
+/// Room or other part of scene
+/**
+  Region is prefetched when camera comes near its doors and evicted when camera is far from its bounds,
+  gap between distances keeps region from loading and evicting every frame. Resident region has no bounds,
+  it is loaded at start and never evicted
+*/
+struct Region {
+    string name;///<name of region
+    glm::vec3 boundsMin;///<boundsMin corner of bounds in world space
+    glm::vec3 boundsMax;///<boundsMax corner of bounds in world space
+    vector<glm::vec3> doors;///<doors entrances of region in world space
+    vector<RegionModel> models;///<models of region
+    RegionState state = REGION_UNLOADED;///<state of region
+    int pendingModels = 0;///<pendingModels models not uploaded yet
+    bool resident = false;///<resident region is always loaded
+};
+
+/// Model waiting for import
+struct RegionJob {
+    int region;///<region index of region
+    int model;///<model index of model in region
+    float priority;///<priority distance of model from camera, the lowest one is imported first
+};
+
+/// Model imported by loader thread
+struct RegionImport {
+    int region;///<region index of region
+    int model;///<model index of model in region
+    bool valid;///<valid import succeeded
+    ModelImport data;///<data imported model
+};
+
+/// Streaming state
+struct RegionStreaming {
+    vector<Region> regions;///<regions of scene
+    int loads = 0;///<loads number of loaded regions
+    int evictions = 0;///<evictions number of evicted regions
+
+    // Loader thread imports models, render thread uploads them
+    thread loader;///<loader thread importing models
+    mutex lock;///<lock of jobs and results
+    condition_variable wake;///<wake signals new job or quit
+    vector<RegionJob> jobs;///<jobs models waiting for import
+    vector<RegionImport> results;///<results waiting for upload
+    vector<RegionImport> ready;///<ready results taken by render thread
+    int readyPos = 0;///<readyPos next uploaded result of ready
+    bool quit = false;///<quit loader thread ends
+    bool started = false;///<started loader thread runs
+    chrono::steady_clock::time_point start;///<start time when streaming started
+    bool startupDone = false;///<startupDone regions requested at start and their textures are uploaded
+    bool pinned = false;///<pinned all regions are loaded and never evicted, runs measuring complete scene pin them
+};
+RegionStreaming regionStreaming;
+
+// Functions prototypes
+int addRegion(const string& name, glm::vec3 boundsMin, glm::vec3 boundsMax, const vector<glm::vec3>& doors);
+int addResidentRegion(const string& name);
+void addRegionModel(int region, Model& model, const string& path, int id);
+void initRegions(glm::vec3 cameraPos);
+void finishRegionLoads();
+void loadAllRegions(glm::vec3 cameraPos);
+void shutdownRegions();
+void updateRegions(glm::vec3 cameraPos);
+void uploadRegionModels(double budgetMs);
+void prioritizeRegionModels(const RenderQueue& queue, glm::vec3 cameraPos);
+void requestRegion(int region, glm::vec3 cameraPos);
+void evictRegion(Region& region);
+bool regionNear(const Region& region, glm::vec3 cameraPos);
+bool regionFar(const Region& region, glm::vec3 cameraPos);
+float boxDistance(glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3 point);
+int loadedRegions();
+void regionLoaderThread();
+
+
+/// Add region
+/**
+  Function that creates region and returns its index
+
+  \param[in] name of region.
+  \param[in] boundsMin corner of bounds.
+  \param[in] boundsMax corner of bounds.
+  \param[in] doors entrances of region.
+*/
+int addRegion(const string& name, glm::vec3 boundsMin, glm::vec3 boundsMax, const vector<glm::vec3>& doors)
+{
+    Region region;
+    region.name = name;
+    region.boundsMin = boundsMin;
+    region.boundsMax = boundsMax;
+    region.doors = doors;
+    regionStreaming.regions.push_back(region);
+    return (int)regionStreaming.regions.size() - 1;
+}
+
+/// Add resident region
+/**
+  Function that creates region which is always loaded and returns its index
+
+  \param[in] name of region.
+*/
+int addResidentRegion(const string& name)
+{
+    int region = addRegion(name, glm::vec3(0.0f), glm::vec3(0.0f), vector<glm::vec3>());
+    regionStreaming.regions[region].resident = true;
+    return region;
+}
+
+/// Add model
+/**
+  Function that places model into region, model is loaded with region. Id is set now, so ids keep order of loading
+
+  \param[in] region index of region.
+  \param[in] model slot of model.
+  \param[in] path of model file.
+  \param[in] id of model.
+*/
+void addRegionModel(int region, Model& model, const string& path, int id)
+{
+    model.ID = id;
+    regionStreaming.regions[region].models.push_back({ &model, path, id });
+}
+
+/// Init regions
+/**
+  Function that starts loader thread and requests regions near start position of camera,
+  first frame is drawn without waiting for them
+
+  \param[in] cameraPos position of camera.
+*/
+void initRegions(glm::vec3 cameraPos)
+{
+    size_t models = 0;
+    for (auto& region : regionStreaming.regions)
+        models += region.models.size();
+    regionStreaming.jobs.reserve(models);
+    regionStreaming.results.reserve(models);
+    regionStreaming.ready.reserve(models);
+    regionStreaming.start = chrono::steady_clock::now();
+    regionStreaming.loader = thread(regionLoaderThread);
+    regionStreaming.started = true;
+
+    int requested = 0;
+    for (int i = 0; i < (int)regionStreaming.regions.size(); i++)
+    {
+        if (!regionNear(regionStreaming.regions[i], cameraPos))
+            continue;
+        requestRegion(i, cameraPos);
+        requested++;
+    }
+    cout << "Regions requested at start: " << requested << "/" << regionStreaming.regions.size() << endl;
+}
+
+/// Finish loads
+/**
+  Function that waits until regions already requested are uploaded, unloaded regions stay unloaded.
+  Runs which measure complete scene request all of them by loadAllRegions()
+*/
+void finishRegionLoads()
+{
+    while (true)
+    {
+        bool loading = false;
+        for (auto& region : regionStreaming.regions)
+            loading = loading || region.state == REGION_LOADING;
+        if (!loading)
+            break;
+        uploadRegionModels(DBL_MAX);
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+/// Load all regions
+/**
+  Function that requests every unloaded region, waits until all of them are uploaded and disables eviction,
+  so benchmark and headless runs do not stream during measured frames
+
+  \param[in] cameraPos position of camera.
+*/
+void loadAllRegions(glm::vec3 cameraPos)
+{
+    for (int i = 0; i < (int)regionStreaming.regions.size(); i++)
+    {
+        if (regionStreaming.regions[i].state == REGION_UNLOADED)
+            requestRegion(i, cameraPos);
+    }
+    regionStreaming.pinned = true;
+    finishRegionLoads();
+    cout << "Regions loaded before first frame: " << loadedRegions() << "/" << regionStreaming.regions.size() << endl;
+}
+
+/// Shutdown regions
+/**
+  Function that stops loader thread, imports in progress are dropped
+*/
+void shutdownRegions()
+{
+    if (!regionStreaming.started)
+        return;
+    {
+        lock_guard<mutex> guard(regionStreaming.lock);
+        regionStreaming.quit = true;
+    }
+    regionStreaming.wake.notify_one();
+    regionStreaming.loader.join();
+    regionStreaming.started = false;
+    cout << "Regions: " << regionStreaming.loads << " loads, " << regionStreaming.evictions << " evictions" << endl;
+}
+
+/// Update regions
+/**
+  Function that uploads imported models, requests regions near camera and evicts far regions.
+  It is called before draws of frame are collected
+
+  \param[in] cameraPos position of camera.
+*/
+void updateRegions(glm::vec3 cameraPos)
+{
+    if (!regionStreaming.started)
+        return;
+    uploadRegionModels(regionUploadMsPerFrame);
+    bool loading = false;
+    for (int i = 0; i < (int)regionStreaming.regions.size(); i++)
+    {
+        Region& region = regionStreaming.regions[i];
+        if (region.state == REGION_UNLOADED && regionNear(region, cameraPos))
+            requestRegion(i, cameraPos);
+        else if (region.state == REGION_LOADED && !regionStreaming.pinned && regionFar(region, cameraPos))
+            evictRegion(region);
+        loading = loading || region.state == REGION_LOADING;
+    }
+
+    // Sizes of shared textures are known only after their upload
+    if (!regionStreaming.startupDone && !loading && texturePipeline.pending == 0)
+    {
+        regionStreaming.startupDone = true;
+        cout << "Scene streamed in " << chrono::duration<double, milli>(chrono::steady_clock::now() - regionStreaming.start).count()
+            << " ms" << endl;
+        printContentRegistry();
+    }
+}
+
+/// Upload models
+/**
+  Function that uploads models imported by loader thread until budget of frame is spent, one model is uploaded always
+
+  \param[in] budgetMs time of frame for uploads in milliseconds.
+*/
+void uploadRegionModels(double budgetMs)
+{
+    // Render thread never waits for loader
+    if (regionStreaming.readyPos == (int)regionStreaming.ready.size())
+    {
+        unique_lock<mutex> guard(regionStreaming.lock, try_to_lock);
+        if (!guard.owns_lock())
+            return;
+        regionStreaming.ready.clear();
+        regionStreaming.ready.swap(regionStreaming.results);
+        regionStreaming.readyPos = 0;
+    }
+
+    auto start = chrono::steady_clock::now();
+    while (regionStreaming.readyPos < (int)regionStreaming.ready.size())
+    {
+        RegionImport& result = regionStreaming.ready[regionStreaming.readyPos++];
+        Region& region = regionStreaming.regions[result.region];
+        RegionModel& regionModel = region.models[result.model];
+        // Placeholder is replaced
+        *regionModel.model = Model();
+        regionModel.model->ID = regionModel.id;
+        if (result.valid)
+            regionModel.model->upload(result.data, regionModel.id);
+        result.data = ModelImport();
+
+        if (--region.pendingModels == 0)
+        {
+            region.state = REGION_LOADED;
+            regionStreaming.loads++;
+            // Static shadows contain furniture
+            shadowStaticDirty = true;
+            cout << "Region " << region.name << " loaded" << endl;
+        }
+        if (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= budgetMs)
+            break;
+    }
+}
+
+/// Prioritize models
+/**
+  Function that sets priority of waiting models by their draws, priority is distance of bounding sphere
+  from camera and draw outside of frustum is farther by regionHiddenDistance. Model without placeholder
+  keeps priority of its region. It is called after queue is culled
+
+  \param[in] queue culled render queue.
+  \param[in] cameraPos position of camera.
+*/
+void prioritizeRegionModels(const RenderQueue& queue, glm::vec3 cameraPos)
+{
+    // Render thread never waits for loader
+    unique_lock<mutex> guard(regionStreaming.lock, try_to_lock);
+    if (!guard.owns_lock() || regionStreaming.jobs.empty())
+        return;
+    for (auto& job : regionStreaming.jobs)
+    {
+        const Model* model = regionStreaming.regions[job.region].models[job.model].model;
+        bool found = false;
+        float priority = 0.0f;
+        for (int i = 0; i < (int)queue.items.size(); i++)
+        {
+            const DrawItem& item = queue.items[i];
+            if (item.model != model)
+                continue;
+            float distance = max(glm::length(item.center - cameraPos) - item.radius, 0.0f);
+            if (find(queue.visible.begin(), queue.visible.end(), i) == queue.visible.end())
+                distance += regionHiddenDistance;
+            priority = found ? min(priority, distance) : distance;
+            found = true;
+        }
+        if (found)
+            job.priority = priority;
+    }
+}
+
+/// Request region
+/**
+  Function that asks loader thread to import models of region, baked models get placeholders of their bounds
+
+  \param[in] region index of region.
+  \param[in] cameraPos position of camera, models are imported by distance of region until they are drawn.
+*/
+void requestRegion(int region, glm::vec3 cameraPos)
+{
+    Region& requested = regionStreaming.regions[region];
+    requested.state = REGION_LOADING;
+    requested.pendingModels = (int)requested.models.size();
+    for (auto& regionModel : requested.models)
+    {
+        glm::vec3 boundsMin, boundsMax;
+        if (Model::readBakedBounds(regionModel.path, boundsMin, boundsMax))
+        {
+            regionModel.model->initPlaceholder(boundsMin, boundsMax, regionModel.id);
+            shadowStaticDirty = true;
+        }
+    }
+
+    float priority = requested.resident ? 0.0f : boxDistance(requested.boundsMin, requested.boundsMax, cameraPos);
+    {
+        lock_guard<mutex> guard(regionStreaming.lock);
+        for (int i = 0; i < (int)requested.models.size(); i++)
+            regionStreaming.jobs.push_back({ region, i, priority });
+    }
+    regionStreaming.wake.notify_one();
+}
+
+/// Evict region
+/**
+  Function that destroys models of region, their buffers and textures are deleted when GPU finished using them
+
+  \param[in] region evicted region.
+*/
+void evictRegion(Region& region)
+{
+    for (auto& regionModel : region.models)
+    {
+        *regionModel.model = Model();
+        regionModel.model->ID = regionModel.id;
+    }
+    region.state = REGION_UNLOADED;
+    regionStreaming.evictions++;
+    shadowStaticDirty = true;
+    cout << "Region " << region.name << " evicted" << endl;
+}
+
+/// Region is near
+/**
+  Function that returns true when camera is inside of region or near one of its doors
+
+  \param[in] region tested region.
+  \param[in] cameraPos position of camera.
+*/
+bool regionNear(const Region& region, glm::vec3 cameraPos)
+{
+    if (region.resident || boxDistance(region.boundsMin, region.boundsMax, cameraPos) == 0.0f)
+        return true;
+    for (auto& door : region.doors)
+    {
+        if (glm::length(door - cameraPos) < regionPrefetchDistance)
+            return true;
+    }
+    return false;
+}
+
+/// Region is far
+/**
+  Function that returns true when camera is far from bounds of region
+
+  \param[in] region tested region.
+  \param[in] cameraPos position of camera.
+*/
+bool regionFar(const Region& region, glm::vec3 cameraPos)
+{
+    return !region.resident && boxDistance(region.boundsMin, region.boundsMax, cameraPos) > regionEvictDistance;
+}
+
+/// Box distance
+/**
+  Function that returns distance of point from box, 0 inside
+
+  \param[in] boundsMin corner of box.
+  \param[in] boundsMax corner of box.
+  \param[in] point tested point.
+*/
+float boxDistance(glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3 point)
+{
+    return glm::length(glm::max(glm::max(boundsMin - point, point - boundsMax), glm::vec3(0.0f)));
+}
+
+/// Loaded regions
+/**
+  Function that returns number of loaded regions
+*/
+int loadedRegions()
+{
+    int loaded = 0;
+    for (auto& region : regionStreaming.regions)
+    {
+        if (region.state == REGION_LOADED)
+            loaded++;
+    }
+    return loaded;
+}
+
+/// Loader thread
+/**
+  Function that imports models of requested regions until quit, model with the lowest priority goes first.
+  GL is used only by render thread
+*/
+void regionLoaderThread()
+{
+    unique_lock<mutex> guard(regionStreaming.lock);
+    while (true)
+    {
+        regionStreaming.wake.wait(guard, [] { return regionStreaming.quit || !regionStreaming.jobs.empty(); });
+        if (regionStreaming.quit)
+            return;
+        auto next = min_element(regionStreaming.jobs.begin(), regionStreaming.jobs.end(),
+            [](const RegionJob& a, const RegionJob& b) { return a.priority < b.priority; });
+        RegionJob job = *next;
+        regionStreaming.jobs.erase(next);
+        string path = regionStreaming.regions[job.region].models[job.model].path;
+        guard.unlock();
+
+        RegionImport result;
+        result.region = job.region;
+        result.model = job.model;
+        result.valid = Model::importModel(path, result.data);
+
+        guard.lock();
+        regionStreaming.results.push_back(std::move(result));
+    }
+}
+
+#endif
@@ -0,0 +1,309 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    render_queue.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Queue of draws of static models with frustum culling, built every frame in frame arena
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "data.h"
+#include "Model.h"
+#include "ShaderGen.h"
+#include "frame_arena.h"
+
+// Stencil test is disabled for draw item
+#define NO_STENCIL -1
+
+/// Pass of queue draws
+enum DrawPass {
+    DRAW_COLOR,///<DRAW_COLOR shaded draws with materials
+    DRAW_DEPTH,///<DRAW_DEPTH positions of meshes without cutouts
+    DRAW_CUTOUTS///<DRAW_CUTOUTS textured cutout meshes for alpha tested depth
+};
+
+/// Material of draw item
+struct Material {
+    glm::vec3 ambient;///<ambient color
+    glm::vec3 diffuse;///<diffuse color
+    glm::vec3 specular;///<specular color
+    float shininess;///<shininess of material
+};
+
+/// One draw of model, it holds all state of draw, so items can be reordered
+struct DrawItem {
+    Model* model;///<model drawn model
+    glm::mat4 transform;///<transform model matrix
+    Material material;///<material used when hardcoded materials are off
+    bool hardcode;///<hardcode use materials hardcoded in shader
+    int stencilRef;///<stencilRef value written into stencil for picking, NO_STENCIL disables test
+    glm::vec3 center;///<center of bounding sphere in world space
+    float radius;///<radius of bounding sphere in world space
+    uint64_t key;///<key sort key, model in high bits and depth in low bits
+};
+
+/// Draws of frame and result of culling
+struct RenderQueue {
+    FrameVector<DrawItem> items;///<items all draws, shadow passes use them
+    FrameVector<int> visible;///<visible indices of items inside of camera frustum, sorted by key
+    int culled = 0;///<culled number of items outside of frustum
+};
+RenderQueue houseQueue;
+
+// Functions prototypes
+void beginRenderQueue(RenderQueue& queue);
+void pushDrawItem(RenderQueue& queue, Model& model, glm::mat4 transform, const Material& material, bool hardcode, int stencilRef);
+void cullRenderQueue(RenderQueue& queue, glm::mat4 viewProjection, glm::vec3 cameraPos);
+void submitRenderQueue(RenderQueue& queue, ShaderGen& shader, DrawPass pass, bool visibleOnly);
+void submitDrawItem(const DrawItem& item, ShaderGen& shader, DrawPass pass, const DrawItem* previous);
+bool sameMaterial(const Material& a, const Material& b);
+bool sphereInFrustum(const glm::vec4 planes[6], glm::vec3 center, float radius);
+void touchVisibleTextures(RenderQueue& queue, glm::vec3 cameraPos);
+void toggleCulling();
+
+
+/// Begin queue
+/**
+  Function that starts new queue of frame, old memory belongs to reused arena
+
+  \param[in] queue render queue.
+*/
+void beginRenderQueue(RenderQueue& queue)
+{
+    queue.items = FrameVector<DrawItem>();
+    queue.visible = FrameVector<int>();
+    queue.items.reserve(renderQueueReserve);
+    queue.culled = 0;
+}
+
+/// Push draw
+/**
+  Function that adds draw of model into queue and computes its bounding sphere in world space,
+  models without meshes are skipped
+
+  \param[in] queue render queue.
+  \param[in] model drawn model.
+  \param[in] transform model matrix.
+  \param[in] material of draw.
+  \param[in] hardcode use materials hardcoded in shader.
+  \param[in] stencilRef value written into stencil, NO_STENCIL disables test.
+*/
+void pushDrawItem(RenderQueue& queue, Model& model, glm::mat4 transform, const Material& material, bool hardcode, int stencilRef)
+{
+    // Model of unloaded region
+    if (model.meshes.empty())
+        return;
+    DrawItem item;
+    item.model = &model;
+    item.transform = transform;
+    item.material = material;
+    item.hardcode = hardcode;
+    item.stencilRef = stencilRef;
+    item.center = glm::vec3(transform * glm::vec4(model.boundsCenter, 1.0f));
+    float scale = glm::max(glm::length(glm::vec3(transform[0])),
+        glm::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    item.radius = model.boundsRadius * scale;
+    item.key = 0;
+    queue.items.push_back(item);
+}
+
+/// Sphere test
+/**
+  Function that returns false when sphere is completely behind one of frustum planes
+
+  \param[in] planes of frustum, normals point inside.
+  \param[in] center of sphere.
+  \param[in] radius of sphere.
+*/
+bool sphereInFrustum(const glm::vec4 planes[6], glm::vec3 center, float radius)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+/// Cull queue
+/**
+  Function that collects items inside of camera frustum and sorts them by model and distance,
+  so draws of one model go together and front to back
+
+  \param[in] queue render queue.
+  \param[in] viewProjection matrix of camera.
+  \param[in] cameraPos position of camera.
+*/
+void cullRenderQueue(RenderQueue& queue, glm::mat4 viewProjection, glm::vec3 cameraPos)
+{
+    // Planes are rows of matrix combined, glm matrix is column major
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    glm::vec4 planes[6] = {
+        rows[3] + rows[0], rows[3] - rows[0],
+        rows[3] + rows[1], rows[3] - rows[1],
+        rows[3] + rows[2], rows[3] - rows[2]
+    };
+    for (auto& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+
+    queue.visible.reserve(queue.items.size());
+    for (int i = 0; i < (int)queue.items.size(); i++)
+    {
+        DrawItem& item = queue.items[i];
+        if (cullingEnable && item.radius > 0.0f && !sphereInFrustum(planes, item.center, item.radius))
+        {
+            queue.culled++;
+            continue;
+        }
+        // Distance is positive float, so its bits keep order
+        float distance = glm::length(item.center - cameraPos);
+        uint32_t depthBits;
+        memcpy(&depthBits, &distance, sizeof(depthBits));
+        item.key = ((uint64_t)(uint32_t)item.model->ID << 32) | depthBits;
+        queue.visible.push_back(i);
+    }
+    std::sort(queue.visible.begin(), queue.visible.end(),
+        [&queue](int a, int b) { return queue.items[a].key < queue.items[b].key; });
+}
+
+/// Compare materials
+/**
+  Function that returns true for equal materials
+
+  \param[in] a first material.
+  \param[in] b second material.
+*/
+bool sameMaterial(const Material& a, const Material& b)
+{
+    return a.ambient == b.ambient && a.diffuse == b.diffuse && a.specular == b.specular && a.shininess == b.shininess;
+}
+
+/// Submit draw
+/**
+  Function that sets state of item which differs from previous item and draws model
+
+  \param[in] item draw item.
+  \param[in] shader set uniform parametrs.
+  \param[in] pass of draws.
+  \param[in] previous previous item, NULL for the first one.
+*/
+void submitDrawItem(const DrawItem& item, ShaderGen& shader, DrawPass pass, const DrawItem* previous)
+{
+    if (!previous || previous->stencilRef != item.stencilRef)
+    {
+        if (item.stencilRef == NO_STENCIL)
+            glDisable(GL_STENCIL_TEST);
+        else
+        {
+            glEnable(GL_STENCIL_TEST);
+            glStencilFunc(GL_ALWAYS, item.stencilRef, -1);
+        }
+    }
+    glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, &item.transform[0][0]);
+    if (pass == DRAW_DEPTH)
+    {
+        item.model->DrawDepth();
+        return;
+    }
+    if (pass == DRAW_CUTOUTS)
+    {
+        item.model->DrawCutouts(shader);
+        return;
+    }
+
+    // Depth passes have no materials
+    if (!previous || previous->hardcode != item.hardcode)
+        glUniform1i(glGetUniformLocation(shader.ID, "hardcode"), (int)item.hardcode);
+    if (!previous || !sameMaterial(previous->material, item.material))
+    {
+        glUniform1f(glGetUniformLocation(shader.ID, "material1.shininess"), item.material.shininess);
+        glUniform3fv(glGetUniformLocation(shader.ID, "material1.ambient"), 1, &item.material.ambient[0]);
+        glUniform3fv(glGetUniformLocation(shader.ID, "material1.diffuse"), 1, &item.material.diffuse[0]);
+        glUniform3fv(glGetUniformLocation(shader.ID, "material1.specular"), 1, &item.material.specular[0]);
+    }
+    item.model->Draw(shader, depthPrepassEnable);
+}
+
+/// Submit queue
+/**
+  Function that draws visible items of camera passes or all items of shadow passes
+
+  \param[in] queue render queue.
+  \param[in] shader set uniform parametrs.
+  \param[in] pass of draws.
+  \param[in] visibleOnly flag to draw only items inside of camera frustum.
+*/
+void submitRenderQueue(RenderQueue& queue, ShaderGen& shader, DrawPass pass, bool visibleOnly)
+{
+    const DrawItem* previous = NULL;
+    if (visibleOnly)
+    {
+        for (int index : queue.visible)
+        {
+            submitDrawItem(queue.items[index], shader, pass, previous);
+            previous = &queue.items[index];
+        }
+    }
+    else
+    {
+        for (auto& item : queue.items)
+        {
+            submitDrawItem(item, shader, pass, previous);
+            previous = &item;
+        }
+    }
+    glEnable(GL_STENCIL_TEST);
+}
+
+/// Touch textures
+/**
+  Function that marks textures of visible items as used, screen size of item is diameter of its bounding sphere
+
+  \param[in] queue render queue, culled.
+  \param[in] cameraPos position of camera.
+*/
+void touchVisibleTextures(RenderQueue& queue, glm::vec3 cameraPos)
+{
+    for (int index : queue.visible)
+    {
+        const DrawItem& item = queue.items[index];
+        float distance = glm::max(glm::length(item.center - cameraPos), near);
+        float pixels = 2.0f * item.radius / distance * textureResidency.focalPixels;
+        for (auto& mesh : item.model->meshes)
+        {
+            for (auto& texture : mesh.textures)
+                touchResidentTexture(texture.id, pixels);
+        }
+        for (auto& mesh : item.model->getWindows())
+        {
+            for (auto& texture : mesh.textures)
+                touchResidentTexture(texture.id, pixels);
+        }
+    }
+}
+
+/// Toggle culling
+/**
+  Function that switches frustum culling of static models
+*/
+void toggleCulling()
+{
+    cullingEnable = !cullingEnable;
+    cout << "Frustum culling " << (cullingEnable ? "ON" : "OFF") << endl;
+}
+
+#endif
@@ -7,6 +7,9 @@
  */
  //----------------------------------------------------------------------------------------
 
+#ifndef RENDER_STUFF_H
+#define RENDER_STUFF_H
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
@@ -20,10 +23,15 @@
 #include "Model.h"
 #include "Mesh.h"
 #include "stb_image.h"
+#include "depth_prepass.h"
+#include "oit.h"
+#include "render_queue.h"
+#include "regions.h"
+#include "texture_pipeline.h"
+#include "profiler.h"
 using namespace std;
 
 
-vector <Mesh> windows;
 // Models
 struct Models {
     Model houseModel;
@@ -51,51 +59,74 @@ struct Models {
 };
 Models models;
 
+/// Locations of uniforms of one point light
+struct PointLightUniforms {
+    GLint position, direction;
+    GLint Kc, Kl, Kq, cutOff;
+    GLint ambient, diffuse, specular;
+};
+
+/// Locations of light uniforms, they are looked up once per shader program
+struct LightUniforms {
+    unsigned int program = 0;///<program shader program of cached locations
+    GLint dirDirection, dirAmbient, dirDiffuse, dirSpecular;
+    GLint lighterEnable, cutOffLighter;
+    GLint viewPos, cameraDir;
+    GLint fogEnable, disableSpot;
+    PointLightUniforms pointLights[N_POINT_LIGHTS];
+};
+LightUniforms lightUniforms;
+
 // Functions prototypes
-void render_scene(Models models, vector<Mesh>windows, ShaderGen& sceneShader);
+void render_scene(Models& models, vector<Mesh>windows, ShaderGen& sceneShader);
 
 void load_models();
-void draw_house(Models models, ShaderGen sceneShader);
-void draw_lamps(Models models, ShaderGen sceneShader);
-void draw_trash_bin(Models models, ShaderGen sceneShader);
-void draw_tree(Models models, ShaderGen sceneShader);
-void draw_police_car(Models models, ShaderGen sceneShader);
-void draw_plants(Models models, ShaderGen sceneShader);
-void draw_interior(ShaderGen sceneShader, Models models);
-void draw_terrorists(Models models, ShaderGen sceneShader);
-void draw_windows(vector<Mesh> windows, ShaderGen sceneShader);
-void draw_police_mans(Models models, ShaderGen shader);
-
-unsigned int init_skybox();
-void draw_skybox(ShaderGen skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, glm::mat4 view, glm::mat4 projection);
-unsigned int loadCubemap(vector<std::string> faces);
+void unload_models();
+void build_house_queue(Models& models);
+void draw_house(ShaderGen& sceneShader, DrawPass pass = DRAW_COLOR, bool visibleOnly = true);
+void draw_depth_prepass(ShaderGen& prepassShader, glm::mat4 view, glm::mat4 projection);
+void draw_lamps(Models& models, ShaderGen& sceneShader);
+void draw_trash_bin(Models& models, ShaderGen& sceneShader);
+void draw_tree(Models& models, ShaderGen& sceneShader);
+void draw_police_car(Models& models, ShaderGen& sceneShader);
+void draw_plants(Models& models, ShaderGen& sceneShader);
+void draw_interior(ShaderGen& sceneShader, Models& models);
+void draw_terrorists(Models& models, ShaderGen& sceneShader);
+void draw_windows(vector<Mesh>& windows, ShaderGen& sceneShader);
+void draw_police_mans(Models& models, ShaderGen& shader);
+
+GLGeometry init_skybox();
+void draw_skybox(ShaderGen& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, glm::mat4 view, glm::mat4 projection);
+GLTexture loadCubemap(vector<std::string> faces);
 
 void setLight(ShaderGen& shader, glm::vec3 lightDir, Camera &camera, float Kl, float Kq);
+void cacheLightUniforms(ShaderGen& shader);
 void setMaterials(ShaderGen& shader, glm::vec3 ambnt, glm::vec3 diff, glm::vec3 spec, float shinniness);
-unsigned int load_texture(const char* path, bool png);
+GLTexture load_texture(const char* path, bool png);
 
-unsigned int initDuckBuffers();
-unsigned int initButterflyBuffers();
-unsigned int initTableBuffers();
+GLGeometry initDuckBuffers();
+GLGeometry initButterflyBuffers();
+GLGeometry initTableBuffers();
 
-void draw_butterfly(ShaderGen butterflyShader, unsigned int butterflyVAO, unsigned int butterflyTexture, glm::mat4 view, glm::mat4 projection);
-void draw_duck(ShaderGen duckShader, unsigned int duckVAO, unsigned int duckTexture, glm::mat4 view, glm::mat4 projection);
-void draw_table(ShaderGen tableShader, unsigned int tableVAO, unsigned int tableTexture);
+void draw_butterfly(ShaderGen& butterflyShader, unsigned int butterflyVAO, unsigned int butterflyTexture, glm::mat4 view, glm::mat4 projection);
+void draw_duck(ShaderGen& duckShader, unsigned int duckVAO, unsigned int duckTexture, glm::mat4 view, glm::mat4 projection);
+void draw_table(ShaderGen& tableShader, unsigned int tableVAO, unsigned int tableTexture);
+glm::mat4 duckModelMatrix();
+glm::mat4 butterflyModelMatrix();
+glm::vec4 butterflySpriteTransform();
 
 
 /// Load texture 
 /**
-  Function that load texture and returns id of texture
+  Function that creates texture and returns its id, image is decoded and uploaded by texture pipeline
 
   \param[in] path where texture is stored.
   \param[in] png flag for png textures.
 */
-unsigned int load_texture(const char* path, bool png)
+GLTexture load_texture(const char* path, bool png)
 {
-    // Flip textures
-    stbi_set_flip_vertically_on_load(true);
-    unsigned int texture;
-    glGenTextures(1, &texture);
+    GLTexture texture;
+    texture.create();
     glBindTexture(GL_TEXTURE_2D, texture);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -103,78 +134,86 @@ unsigned int load_texture(const char* path, bool png)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    int width, height, nrChannels;
-    unsigned char* data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data)
-    {
-        if (png)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-        else
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-    }
-    else
-    {
-        std::cout << "Failed to load texture" << std::endl;
-    }
-    stbi_image_free(data);
-    stbi_set_flip_vertically_on_load(false);
+    // Flip textures
+    TextureUploadJob job;
+    job.kind = TEXTURE_UPLOAD_SPRITE;
+    job.texture = texture;
+    job.target = GL_TEXTURE_2D;
+    job.format = png ? GL_RGBA : GL_RGB;
+    job.path = path;
+    job.owner = path;
+    job.flip = true;
+    job.channels = png ? 4 : 3;
+    job.normalMap = false;
+    submitTextureUpload(job);
     return texture;
 }
 
 
 /// Init models 
 /**
-  Function that inits models from structure models
+  Function that places models from structure models into regions, they are streamed in by initRegions()
 */
 void load_models()
 {
     int sharedId1 = 0;
-    models.houseModel.init(houseModelpath, sharedId1++);
-    models.policeCarModel.init(policeCarModelpath, sharedId1++);
-    models.trashBinModel.init(trashBinModelpath, sharedId1++);
-    models.treeModel.init(treeModelpath, sharedId1++);
-    models.plantModel.init(plantsModelpath, sharedId1++);
-    models.tableModel.init(tableModelpath, sharedId1++);
-    models.frootsModel.init(frootsModelpath, sharedId1++);
-    models.stoolModel.init(chairModelpath, sharedId1++);
-    models.paintingModel.init(paintingModelpath, sharedId1++);
-    models.couchModel.init(couchModelpath, sharedId1++);
-    models.coffeeTableModel.init(coffeeTableModelpath, sharedId1++);
-    models.loungeChair.init(loungeModelpath, sharedId1++);
-    models.bedModel.init(bedModelpath, sharedId1++);
-    models.chairModel.init(moderChairModelpath, sharedId1++);
-    models.modernTableModel.init(modernTableModelpath, sharedId1++);
+    // Models not streamed with rooms are resident, first frame is drawn before any of them is loaded
+    int scene = addResidentRegion("scene");
+    addRegionModel(scene, models.houseModel, houseModelpath, sharedId1++);
+    addRegionModel(scene, models.policeCarModel, policeCarModelpath, sharedId1++);
+    addRegionModel(scene, models.trashBinModel, trashBinModelpath, sharedId1++);
+    addRegionModel(scene, models.treeModel, treeModelpath, sharedId1++);
+    addRegionModel(scene, models.plantModel, plantsModelpath, sharedId1++);
+
+    // Furniture is streamed with rooms
+    int kitchen = addRegion("kitchen", kitchenMin, kitchenMax, kitchenDoors);
+    int livingRoom = addRegion("living room", livingRoomMin, livingRoomMax, livingRoomDoors);
+    int bedrooms = addRegion("bedrooms", bedroomsMin, bedroomsMax, bedroomsDoors);
+    int terrace = addRegion("terrace", terraceMin, terraceMax, terraceDoors);
+    addRegionModel(kitchen, models.tableModel, tableModelpath, sharedId1++);
+    addRegionModel(kitchen, models.frootsModel, frootsModelpath, sharedId1++);
+    addRegionModel(kitchen, models.stoolModel, chairModelpath, sharedId1++);
+    addRegionModel(scene, models.paintingModel, paintingModelpath, sharedId1++);
+    addRegionModel(livingRoom, models.couchModel, couchModelpath, sharedId1++);
+    addRegionModel(livingRoom, models.coffeeTableModel, coffeeTableModelpath, sharedId1++);
+    addRegionModel(terrace, models.loungeChair, loungeModelpath, sharedId1++);
+    addRegionModel(bedrooms, models.bedModel, bedModelpath, sharedId1++);
+    addRegionModel(bedrooms, models.chairModel, moderChairModelpath, sharedId1++);
+    addRegionModel(bedrooms, models.modernTableModel, modernTableModelpath, sharedId1++);
     //models.terroristModel.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\red_01.obj", sharedId1++);
     //models.terroristModel1.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\red_02.obj", sharedId1++);
     //models.terroristModel2.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\red_03.obj", sharedId1++);
     //models.policeManModel.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\police_man.obj", sharedId1++);
-    models.lampModel.init(lampModelpath, sharedId1++);
+    addRegionModel(scene, models.lampModel, lampModelpath, sharedId1++);
     //models.wallLampModel.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\wall_lamp.obj", sharedId1++);
-    windows = models.houseModel.getWindows();
     //models.backpack.init("C:\\Users\\daniil.lebedev\\Desktop\\MANSION\\backpack.obj");
 
 }
+
+/// Unload models
+/**
+  Function that destroys models, their buffers and textures are deleted when GPU finished using them
+*/
+void unload_models()
+{
+    models = Models();
+    cout << "Models unloaded" << endl;
+}
 /// Init skybox 
 /**
-  Function that setup buffers for skybox and return skyboxVAO
+  Function that setup buffers for skybox and return them
 */
-unsigned int init_skybox()
+GLGeometry init_skybox()
 {
-    unsigned int skyboxVAO, skyboxVBO;
-    glGenVertexArrays(1, &skyboxVAO);
-    glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    GLGeometry skybox;
+    skybox.VAO.create();
+    skybox.VBO.create();
+    glBindVertexArray(skybox.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, skybox.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    return skyboxVAO;
+    return skybox;
 }
 
 /// Draw skybox 
@@ -188,8 +227,9 @@ unsigned int init_skybox()
   \param[in] projection model.
 
 */
-void draw_skybox(ShaderGen skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, glm::mat4 view, glm::mat4 projection)
+void draw_skybox(ShaderGen& skyboxShader, unsigned int skyboxVAO, unsigned int skyboxTexture, glm::mat4 view, glm::mat4 projection)
 {
+    PROFILE_SCOPE("draw_skybox");
     glDepthFunc(GL_LEQUAL);
     skyboxShader.use();
     glm::mat4 viewSky = glm::mat4(glm::mat3(view));
@@ -206,32 +246,29 @@ void draw_skybox(ShaderGen skyboxShader, unsigned int skyboxVAO, unsigned int sk
 
 /// Load cubemap
 /**
-  Function that load and bind skybox faces
+  Function that creates cubemap of skybox, faces are decoded and uploaded by texture pipeline
 
   \param[in] faces vector with paths for skybox faces.
 */
-unsigned int loadCubemap(vector<std::string> faces)
+GLTexture loadCubemap(vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    GLTexture textureID;
+    textureID.create();
     glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-            );
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
+        TextureUploadJob job;
+        job.kind = TEXTURE_UPLOAD_CUBEMAP_FACE;
+        job.texture = textureID;
+        job.target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + i;
+        job.format = GL_RGB;
+        job.path = faces[i];
+        job.owner = "skybox " + faces[0];
+        job.flip = false;
+        job.channels = 3;
+        job.normalMap = false;
+        submitTextureUpload(job);
     }
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -272,64 +309,84 @@ void setMaterials(ShaderGen& shader, glm::vec3 ambnt, glm::vec3 diff, glm::vec3
 */
 void setLight(ShaderGen& shader, glm::vec3 lightDir, Camera &camera, float Kl, float Kq)
 {
+    PROFILE_SCOPE("setLight");
+    if (lightUniforms.program != shader.ID)
+        cacheLightUniforms(shader);
+    const LightUniforms& u = lightUniforms;
+
     // Set directional lights uniforms
-    glUniform3fv(glGetUniformLocation(shader.ID, "dirLight.direction"), 1, &lightDir[0]);
-    glUniform3fv(glGetUniformLocation(shader.ID, "dirLight.ambient"), 1, &lightDirAmbient[0]);
-    glUniform3fv(glGetUniformLocation(shader.ID, "dirLight.diffuse"), 1, &lightDirDiffuse[0]);
-    glUniform3fv(glGetUniformLocation(shader.ID, "dirLight.specular"), 1, &lightDirSpecular[0]);
+    glUniform3fv(u.dirDirection, 1, &lightDir[0]);
+    glUniform3fv(u.dirAmbient, 1, &lightDirAmbient[0]);
+    glUniform3fv(u.dirDiffuse, 1, &lightDirDiffuse[0]);
+    glUniform3fv(u.dirSpecular, 1, &lightDirSpecular[0]);
 
     // Set lighter uniforms
-    glUniform1i(glGetUniformLocation(shader.ID, "lighterEnable"), (int)lighterEnable);
-    glUniform1f(glGetUniformLocation(shader.ID, "cutOffLighter"), cutOffLighter);
+    glUniform1i(u.lighterEnable, (int)lighterEnable);
+    glUniform1f(u.cutOffLighter, cutOffLighter);
     
-    glUniform3fv(glGetUniformLocation(shader.ID, "viewPos"), 1, &camera.Position[0]);
-    glUniform3fv(glGetUniformLocation(shader.ID, "cameraDir"), 1, &camera.Front[0]);
+    glUniform3fv(u.viewPos, 1, &camera.Position[0]);
+    glUniform3fv(u.cameraDir, 1, &camera.Front[0]);
 
     // Enable/Disable fog
-    glUniform1i(glGetUniformLocation(shader.ID, "fogEnable"), (int)fogEnable);
+    glUniform1i(u.fogEnable, (int)fogEnable);
 
     // Enable point lights 
-   // glUniform1i(glGetUniformLocation(shader.ID, "disableSpot"), (int)true);
-    glUniform1i(glGetUniformLocation(shader.ID, "disableSpot"), (int)false);
+    glUniform1i(u.disableSpot, (int)false);
 
     // Set point lights uniforms
-    string tmp;
+    float cutOff = glm::cos(glm::radians(pointLightCutOff));
     for (int i = 0; i < N_POINT_LIGHTS; i++)
     {
-        string pos = "pointLights[].position";
-        string kc = "pointLights[].Kc";
-        string kl = "pointLights[].Kl";
-        string kq = "pointLights[].Kq";
-        string ambient = "pointLights[].ambient";
-        string diffuse = "pointLights[].diffuse";
-        string specular = "pointLights[].specular";
-        string cut = "pointLights[].cutOff";
-        string dir = "pointLights[].direction";
-
-
-        pos.insert(12, to_string(i));
-        kc.insert(12, to_string(i));
-        kl.insert(12, to_string(i));
-        kq.insert(12, to_string(i));
-        ambient.insert(12, to_string(i));
-        diffuse.insert(12, to_string(i));
-        specular.insert(12, to_string(i));
-        cut.insert(12, to_string(i));
-        dir.insert(12, to_string(i));
-
-        glm::vec3 pointLightPos = pointLightPositions[i];
-        glUniform3fv(glGetUniformLocation(shader.ID, pos.c_str()), 1, &pointLightPos[0]);
-        glUniform3fv(glGetUniformLocation(shader.ID, dir.c_str()), 1, &pointLightDir[0]);
+        const PointLightUniforms& point = u.pointLights[i];
+        glUniform3fv(point.position, 1, &pointLightPositions[i][0]);
+        glUniform3fv(point.direction, 1, &pointLightDir[0]);
         // Set attenuation
-        glUniform1f(glGetUniformLocation(shader.ID, kc.c_str()), 1.0f);
-        glUniform1f(glGetUniformLocation(shader.ID, kl.c_str()), Kl);
-        glUniform1f(glGetUniformLocation(shader.ID, kq.c_str()), Kq);
-        glUniform1f(glGetUniformLocation(shader.ID, cut.c_str()), glm::cos(glm::radians(pointLightCutOff)));
+        glUniform1f(point.Kc, 1.0f);
+        glUniform1f(point.Kl, Kl);
+        glUniform1f(point.Kq, Kq);
+        glUniform1f(point.cutOff, cutOff);
+
+        glUniform3fv(point.ambient, 1, &lightPointAmbient[0]);
+        glUniform3fv(point.diffuse, 1, &lightPointDiffuse[0]);
+        glUniform3fv(point.specular, 1, &lightPointSpecular[0]);
+    }
+}
+
+/// Cache light uniforms
+/**
+  Function that looks up locations of light uniforms once per shader program,
+  names of point lights are built here instead of every frame
 
+  \param[in] shader with light uniforms.
+*/
+void cacheLightUniforms(ShaderGen& shader)
+{
+    LightUniforms& u = lightUniforms;
+    u.program = shader.ID;
+    u.dirDirection = glGetUniformLocation(shader.ID, "dirLight.direction");
+    u.dirAmbient = glGetUniformLocation(shader.ID, "dirLight.ambient");
+    u.dirDiffuse = glGetUniformLocation(shader.ID, "dirLight.diffuse");
+    u.dirSpecular = glGetUniformLocation(shader.ID, "dirLight.specular");
+    u.lighterEnable = glGetUniformLocation(shader.ID, "lighterEnable");
+    u.cutOffLighter = glGetUniformLocation(shader.ID, "cutOffLighter");
+    u.viewPos = glGetUniformLocation(shader.ID, "viewPos");
+    u.cameraDir = glGetUniformLocation(shader.ID, "cameraDir");
+    u.fogEnable = glGetUniformLocation(shader.ID, "fogEnable");
+    u.disableSpot = glGetUniformLocation(shader.ID, "disableSpot");
 
-        glUniform3fv(glGetUniformLocation(shader.ID, ambient.c_str()), 1, &lightPointAmbient[0]);
-        glUniform3fv(glGetUniformLocation(shader.ID, diffuse.c_str()), 1, &lightPointDiffuse[0]);
-        glUniform3fv(glGetUniformLocation(shader.ID, specular.c_str()), 1, &lightPointSpecular[0]);
+    for (int i = 0; i < N_POINT_LIGHTS; i++)
+    {
+        string prefix = "pointLights[" + to_string(i) + "].";
+        PointLightUniforms& point = u.pointLights[i];
+        point.position = glGetUniformLocation(shader.ID, (prefix + "position").c_str());
+        point.direction = glGetUniformLocation(shader.ID, (prefix + "direction").c_str());
+        point.Kc = glGetUniformLocation(shader.ID, (prefix + "Kc").c_str());
+        point.Kl = glGetUniformLocation(shader.ID, (prefix + "Kl").c_str());
+        point.Kq = glGetUniformLocation(shader.ID, (prefix + "Kq").c_str());
+        point.cutOff = glGetUniformLocation(shader.ID, (prefix + "cutOff").c_str());
+        point.ambient = glGetUniformLocation(shader.ID, (prefix + "ambient").c_str());
+        point.diffuse = glGetUniformLocation(shader.ID, (prefix + "diffuse").c_str());
+        point.specular = glGetUniformLocation(shader.ID, (prefix + "specular").c_str());
     }
 }
 
@@ -339,11 +396,14 @@ void setLight(ShaderGen& shader, glm::vec3 lightDir, Camera &camera, float Kl, f
 
   \param[in] shader set uniform parametrs.
 */
-void render_scene(ShaderGen sceneShader)
+void render_scene(ShaderGen& sceneShader)
 {
-    // Model render
-    draw_house(models, sceneShader);
-    draw_windows(windows, sceneShader);
+    PROFILE_SCOPE("render_scene");
+    // Model render, with depth pre-pass only visible fragments of opaque objects are shaded
+    beginOpaqueShading();
+    draw_house(sceneShader);
+    endOpaqueShading();
+    draw_windows(models.houseModel.getWindows(), sceneShader);
  
   //  draw_lamps(models, sceneShader);
   //  draw_trash_bin(models, sceneShader);
@@ -366,25 +426,51 @@ void render_scene(ShaderGen sceneShader)
 }
 
 
-/// Draw static
+/// Depth pre-pass
 /**
-  Function that cals static objects in scene
+  Function that fills depth buffer with opaque static objects, colors are not written,
+  cutout meshes are blended and write depth in shading pass
+
+  \param[in] prepassShader position only shader.
+  \param[in] view model.
+  \param[in] projection model.
+*/
+void draw_depth_prepass(ShaderGen& prepassShader, glm::mat4 view, glm::mat4 projection)
+{
+    PROFILE_SCOPE("draw_depth_prepass");
+    if (!depthPrepassEnable)
+        return;
+
+    prepassShader.use();
+    glUniformMatrix4fv(glGetUniformLocation(prepassShader.ID, "view"), 1, GL_FALSE, &view[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(prepassShader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
+
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    draw_house(prepassShader, DRAW_DEPTH);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+/// Build static
+/**
+  Function that fills queue of static objects in scene, it is called once per frame before all passes
 
   \param[in] models struct with models.
-  \param[in] shader set uniform parametrs.
 */
-void draw_house(Models models, ShaderGen sceneShader)
+void build_house_queue(Models& models)
 {
-    // Hardcode materials off
-    glUniform1i(glGetUniformLocation(sceneShader.ID, "hardcode"), (int)disableHardcode);
+    PROFILE_SCOPE("build_house_queue");
+    const Material perl = { perlAmbient, perlDiffuse, perlSpecular, perlShininess };
+    const Material silver = { silverAmbient, silverDiffuse, silverSpecular, silverShininess };
+    const Material copper = { copperAmbient, copperDiffuse, copperSpecular, copperShininess };
+    const Material bed = { bedAmbient, bedDiffuse, bedSpecular, bedShininess };
+    const Material defaultMaterial = { defaultAmbient, defaultDiffuse, defaultSpecular, defaultShininess };
+    beginRenderQueue(houseQueue);
+
     // House model
     glm::mat4 sceneModel = glm::mat4(1.0f);
     sceneModel = glm::translate(sceneModel, housePos);
     sceneModel = glm::scale(sceneModel, houseSize);
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &sceneModel[0][0]);
-    glUniform1i(glGetUniformLocation(sceneShader.ID, "draw_windows"), (int)defaultAlpha);
-    setMaterials(sceneShader, perlAmbient, perlDiffuse, perlSpecular, perlShininess); // Perl
-    models.houseModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.houseModel, sceneModel, perl, disableHardcode, 0);
     
     // Lamps models
     for (int lamp = 0; lamp < lampPositions.size(); lamp++)
@@ -392,41 +478,33 @@ void draw_house(Models models, ShaderGen sceneShader)
         glm::mat4 lampModel = glm::mat4(1.0f);
         lampModel = glm::translate(lampModel, lampPositions[lamp]);
         lampModel = glm::scale(lampModel, glm::vec3(0.005f, 0.005f, 0.005f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &lampModel[0][0]);
-        setMaterials(sceneShader, silverAmbient, silverDiffuse, silverSpecular, silverShininess); //Silver 
-        models.lampModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.lampModel, lampModel, silver, disableHardcode, 0);
     }
 
     // Table model
-    setMaterials(sceneShader, defaultAmbient, defaultDiffuse, defaultSpecular, defaultShininess);
     glm::mat4 tableMod = glm::mat4(1.0f);
     tableMod = glm::translate(tableMod, tablePos);
     tableMod = glm::scale(tableMod, glm::vec3(0.6f, 0.6f, 0.6f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &tableMod[0][0]);
-    models.tableModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.tableModel, tableMod, defaultMaterial, disableHardcode, 0);
 
     
     // Froots model
     glm::mat4 frootsMod = glm::mat4(1.0f);
     frootsMod = glm::translate(frootsMod, frootsPos);
     frootsMod = glm::scale(frootsMod, glm::vec3(0.02f, 0.02f, 0.02f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &frootsMod[0][0]);
-    models.frootsModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.frootsModel, frootsMod, defaultMaterial, disableHardcode, 0);
     
     // Chairs model
-   // glStencilFunc(GL_ALWAYS, 0, -1);
     for (int chair = 0; chair < chairsPostion.size(); chair++)
     {
         glm::mat4 stoolMod = glm::mat4(1.0f);
         stoolMod = glm::translate(stoolMod, chairsPostion[chair]);
         stoolMod = glm::scale(stoolMod, glm::vec3(0.0003f, 0.0003f, 0.0003f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &stoolMod[0][0]);
-        models.stoolModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.stoolModel, stoolMod, defaultMaterial, disableHardcode, 0);
     }
 
 
-    // Painting model
-    glStencilFunc(GL_ALWAYS, models.paintingModel.ID, -1);
+    // Painting model, it is clickable
     // If user click on picture, tear it
     if (!tearPicture)
     {
@@ -434,76 +512,61 @@ void draw_house(Models models, ShaderGen sceneShader)
         paintingMod = glm::translate(paintingMod, glm::vec3(2.0f, 0.01f, 0.1f));
         paintingMod = glm::rotate(paintingMod, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         paintingMod = glm::scale(paintingMod, glm::vec3(0.5f, 0.5f, 0.5f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &paintingMod[0][0]);
-
-        models.paintingModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.paintingModel, paintingMod, defaultMaterial, disableHardcode, models.paintingModel.ID);
     }
     
-    glDisable(GL_STENCIL_TEST);
-
     // Couch model
-   // glStencilFunc(GL_ALWAYS, 0, -1);
     glm::mat4 couchMod = glm::mat4(1.0f);
     couchMod = glm::translate(couchMod, couchPos);
     couchMod = glm::scale(couchMod, glm::vec3(0.3f, 0.3f, 0.3f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &couchMod[0][0]);
-    models.couchModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.couchModel, couchMod, defaultMaterial, disableHardcode, NO_STENCIL);
 
     // Coffee table model
     glm::mat4 coffeeTableMod = glm::mat4(1.0f);
     coffeeTableMod = glm::translate(coffeeTableMod, coffeeTablePos);
     coffeeTableMod = glm::scale(coffeeTableMod, glm::vec3(0.3f, 0.3f, 0.3f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &coffeeTableMod[0][0]);
-    models.coffeeTableModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.coffeeTableModel, coffeeTableMod, defaultMaterial, disableHardcode, NO_STENCIL);
 
     // Lounge chair model
     for (int lounge = 0; lounge < loungeChairPositions.size(); lounge++)
     {
-        setMaterials(sceneShader, copperAmbient, copperDiffuse, copperSpecular, copperShininess);
         glm::mat4 loungeСhair = glm::mat4(1.0f);
         loungeСhair = glm::translate(loungeСhair, loungeChairPositions[lounge]);
         loungeСhair = glm::scale(loungeСhair, glm::vec3(0.3f, 0.3f, 0.3f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &loungeСhair[0][0]);
-        models.loungeChair.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.loungeChair, loungeСhair, copper, disableHardcode, NO_STENCIL);
     }
     
     // Bed model
-    for (int bed = 0; bed < bedPositions.size(); bed++)
+    for (int bedIndex = 0; bedIndex < bedPositions.size(); bedIndex++)
     {
-        setMaterials(sceneShader, bedAmbient, bedDiffuse, bedSpecular, bedShininess);
         glm::mat4 bedMod = glm::mat4(1.0f);
-        bedMod = glm::translate(bedMod, bedPositions[bed]);
+        bedMod = glm::translate(bedMod, bedPositions[bedIndex]);
         bedMod = glm::scale(bedMod, glm::vec3(0.3f, 0.3f, 0.3f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &bedMod[0][0]);
-        models.bedModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.bedModel, bedMod, bed, disableHardcode, NO_STENCIL);
     }
 
 
-    // Hardcode materials on
-    glUniform1i(glGetUniformLocation(sceneShader.ID, "hardcode"), (int)enableHardcode);
+    // Hardcode materials on for the rest of models
 
     // Modern table model
     glm::mat4 modernTableMod = glm::mat4(1.0f);
     modernTableMod = glm::translate(modernTableMod, modernTablePos);
     modernTableMod = glm::rotate(modernTableMod, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     modernTableMod = glm::scale(modernTableMod, glm::vec3(0.3f, 0.3f, 0.3f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &modernTableMod[0][0]);
-    models.modernTableModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.modernTableModel, modernTableMod, bed, enableHardcode, NO_STENCIL);
 
     // Modern chair model
     glm::mat4 chairMod = glm::mat4(1.0f);
     chairMod = glm::translate(chairMod, modernChairPos);
     chairMod = glm::rotate(chairMod, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     chairMod = glm::scale(chairMod, glm::vec3(0.3f, 0.3f, 0.3f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &chairMod[0][0]);
-    models.chairModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.chairModel, chairMod, bed, enableHardcode, NO_STENCIL);
 
     // Bin model
     glm::mat4 binModel = glm::mat4(1.0f);
     binModel = glm::translate(binModel, binPos);
     binModel = glm::scale(binModel, glm::vec3(0.0009f, 0.0009f, 0.0009f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &binModel[0][0]);
-    models.trashBinModel.Draw(sceneShader);
+    pushDrawItem(houseQueue, models.trashBinModel, binModel, bed, enableHardcode, NO_STENCIL);
 
     // Tree models
     for (int tree = 0; tree < treePositions.size(); tree++)
@@ -511,8 +574,7 @@ void draw_house(Models models, ShaderGen sceneShader)
         glm::mat4 treeMod = glm::mat4(1.0f);
         treeMod = glm::translate(treeMod, treePositions[tree]);
         treeMod = glm::scale(treeMod, glm::vec3(0.2f, 0.2f, 0.2f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &treeMod[0][0]);
-        models.treeModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.treeModel, treeMod, bed, enableHardcode, NO_STENCIL);
     }
 
     // Plant Models
@@ -522,22 +584,35 @@ void draw_house(Models models, ShaderGen sceneShader)
         plantMod = glm::translate(plantMod, plantsPositions[plant]);
         plantMod = glm::rotate(plantMod, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
         plantMod = glm::scale(plantMod, glm::vec3(0.0005f, 0.0005f, 0.0005f));
-        glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &plantMod[0][0]);
-        models.plantModel.Draw(sceneShader);
+        pushDrawItem(houseQueue, models.plantModel, plantMod, bed, enableHardcode, NO_STENCIL);
     }
 
 
-    glEnable(GL_STENCIL_TEST);
-    // Police car model
+    // Police car model, it is clickable
     glm::mat4 carModel = glm::mat4(1.0f);
     carModel = glm::translate(carModel, policeCarPos);
     carModel = glm::rotate(carModel, glm::radians(290.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     carModel = glm::scale(carModel, glm::vec3(0.3f, 0.3f, 0.3f));
-    glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &carModel[0][0]);
+    pushDrawItem(houseQueue, models.policeCarModel, carModel, bed, enableHardcode, models.policeCarModel.ID);
+}
 
+/// Draw static
+/**
+  Function that draws queue of static objects in scene, models are in houseQueue
 
-    glStencilFunc(GL_ALWAYS, models.policeCarModel.ID, -1);
-    models.policeCarModel.Draw(sceneShader);
+  \param[in] shader set uniform parametrs.
+  \param[in] pass of draws, depth passes draw only positions.
+  \param[in] visibleOnly flag to draw only objects inside of camera frustum, shadow passes draw all.
+*/
+void draw_house(ShaderGen& sceneShader, DrawPass pass, bool visibleOnly)
+{
+    PROFILE_SCOPE("draw_house");
+    if (pass == DRAW_COLOR)
+        glUniform1i(glGetUniformLocation(sceneShader.ID, "draw_windows"), (int)defaultAlpha);
+    submitRenderQueue(houseQueue, sceneShader, pass, visibleOnly);
+    // Windows are drawn with hardcoded materials
+    if (pass == DRAW_COLOR)
+        glUniform1i(glGetUniformLocation(sceneShader.ID, "hardcode"), (int)enableHardcode);
 }
 
 /// Draw windows
@@ -547,36 +622,27 @@ void draw_house(Models models, ShaderGen sceneShader)
   \param[in] windows vector.
   \param[in] sceneShader set uniform parametrs.
 */
-void draw_windows(vector<Mesh> windows, ShaderGen sceneShader)
+void draw_windows(vector<Mesh>& windows, ShaderGen& sceneShader)
 {
-    /*
-    for (map<float, Mesh>::reverse_iterator it = sorted_windows_pos.rbegin(); it != sorted_windows_pos.rend(); ++it)
-    {
-        auto window = it->second;
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
-        sceneShader.setMat4("model", model);
-        sceneShader.setBool("draw_windows", true);
-        window.Draw(sceneShader);
-    }
-    */
-
-
-    for (auto window : windows)
+    PROFILE_SCOPE("draw_windows");
+    // Windows are accumulated in any order, so they do not need sorting by distance
+    beginTransparentPass();
+    glUniform1i(glGetUniformLocation(sceneShader.ID, "draw_windows"), (int)windowsAlpha);
+    for (auto& window : windows)
     {
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, windowsPos);
         model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
         glUniformMatrix4fv(glGetUniformLocation(sceneShader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-        glUniform1i(glGetUniformLocation(sceneShader.ID, "draw_windows"), (int)windowsAlpha);
-
-        // Unclickable
-        glStencilFunc(GL_ALWAYS, 0, -1);
         window.Draw(sceneShader);
     }
     // Draw other object with normal alpha 
     glUniform1i(glGetUniformLocation(sceneShader.ID, "draw_windows"), (int)defaultAlpha);
+    endTransparentPass();
+
+    // Resolve windows over opaque scene
+    compositeTransparent();
+    sceneShader.use();
 }
 
 /// Draw table
@@ -590,8 +656,9 @@ void draw_windows(vector<Mesh> windows, ShaderGen sceneShader)
   \param[in] projection model.
 
 */
-void draw_table(ShaderGen tableShader, unsigned int tableVAO, unsigned int tableTexture)
+void draw_table(ShaderGen& tableShader, unsigned int tableVAO, unsigned int tableTexture)
 {
+    PROFILE_SCOPE("draw_table");
     tableShader.use();
     glm::mat4 model = glm::mat4(1.0f);
     model = glm::translate(model, tableStartPos);
@@ -620,27 +687,17 @@ void draw_table(ShaderGen tableShader, unsigned int tableVAO, unsigned int table
   \param[in] projection model.
 
 */
-void draw_duck(ShaderGen duckShader, unsigned int duckVAO, unsigned int duckTexture, glm::mat4 view, glm::mat4 projection)
+void draw_duck(ShaderGen& duckShader, unsigned int duckVAO, unsigned int duckTexture, glm::mat4 view, glm::mat4 projection)
 {
+    PROFILE_SCOPE("draw_duck");
     duckShader.use();
     glUniformMatrix4fv(glGetUniformLocation(duckShader.ID, "view"), 1, GL_FALSE, &view[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(duckShader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
 
 
-    glm::mat4 model = glm::mat4(1.0f);
-    float rot = sin(glfwGetTime()) * speedOfRotation;
-    model = glm::translate(model, duckStartPos);
-    
-    if (start_animate_duck)
-    {
-        model = glm::translate(model, glm::vec3(sin(glfwGetTime()) * 0.08f, 0.01f, 4.0f));
-    }
-    else
-        model = glm::translate(model, duckWaitiingPos);
-    model = glm::rotate(model, glm::radians(rot), glm::vec3(0.0f, 1.0f, 0.0f));
-    model = glm::scale(model, duckSize);
+    glm::mat4 model = duckModelMatrix();
     glUniformMatrix4fv(glGetUniformLocation(duckShader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-    glm::vec2 shiftCoords = glm::vec2(0.0f, sin(glfwGetTime()) * 0.02f);
+    glm::vec2 shiftCoords = glm::vec2(0.0f, sin(sceneTime) * 0.02f);
     glUniform2fv(glGetUniformLocation(duckShader.ID, "TexShift"), 1, &shiftCoords[0]);
 
 
@@ -661,50 +718,88 @@ void draw_duck(ShaderGen duckShader, unsigned int duckVAO, unsigned int duckText
   \param[in] projection model.
 
 */
-void draw_butterfly(ShaderGen butterflyShader, unsigned int butterflyVAO, unsigned int butterflyTexture, glm::mat4 view, glm::mat4 projection)
+void draw_butterfly(ShaderGen& butterflyShader, unsigned int butterflyVAO, unsigned int butterflyTexture, glm::mat4 view, glm::mat4 projection)
 {
+    PROFILE_SCOPE("draw_butterfly");
     butterflyShader.use();
     glUniformMatrix4fv(glGetUniformLocation(butterflyShader.ID, "view"), 1, GL_FALSE, &view[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(butterflyShader.ID, "projection"), 1, GL_FALSE, &projection[0][0]);
     
+    glm::mat4 model = butterflyModelMatrix();
+    glUniformMatrix4fv(glGetUniformLocation(butterflyShader.ID, "model"), 1, GL_FALSE, &model[0][0]);
+    glUniform1f(glGetUniformLocation(butterflyShader.ID, "time"), sin(deltaTime * speedAnimation));
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, butterflyTexture);
+    glBindVertexArray(butterflyVAO);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+}
+
+/// Duck model matrix
+/**
+  Function that returns model matrix of duck in current frame
+*/
+glm::mat4 duckModelMatrix()
+{
     glm::mat4 model = glm::mat4(1.0f);
-    model = glm::translate(model, butterflyPos2);
-    model = glm::scale(model, butterflySize);
-    for (int i = 0; i < 1; i++)
+    float rot = sin(sceneTime) * speedOfRotation;
+    model = glm::translate(model, duckStartPos);
+    
+    if (start_animate_duck)
     {
-        float theta = 2.0f * 3.1415926f * float(i) / float(3);
-        float x = 0.1f * glm::cos(theta);
-        float y = 0.1f * glm::sin(theta);
-        float angle = 20.0f * 1;
-        model = glm::translate(model, glm::vec3(cos(glfwGetTime() * 0.2f) + x, sin(glfwGetTime() * 0.2f) + y, 0.0f));
-        angle = glfwGetTime() * 9.0f;
-        model = glm::rotate(model, glm::radians(angle), butterflyRot);
-        glUniformMatrix4fv(glGetUniformLocation(butterflyShader.ID, "model"), 1, GL_FALSE, &model[0][0]);
-        glUniform1f(glGetUniformLocation(butterflyShader.ID, "time"), sin(deltaTime * speedAnimation));
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, butterflyTexture);
-        glBindVertexArray(butterflyVAO);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+        model = glm::translate(model, glm::vec3(sin(sceneTime) * 0.08f, 0.01f, 4.0f));
     }
+    else
+        model = glm::translate(model, duckWaitiingPos);
+    model = glm::rotate(model, glm::radians(rot), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::scale(model, duckSize);
+    return model;
+}
+
+/// Butterfly model matrix
+/**
+  Function that returns model matrix of butterfly in current frame
+*/
+glm::mat4 butterflyModelMatrix()
+{
+    glm::mat4 model = glm::mat4(1.0f);
+    model = glm::translate(model, butterflyPos2);
+    model = glm::scale(model, butterflySize);
+    model = glm::translate(model, glm::vec3(cos(sceneTime * 0.2f) + 0.1f, sin(sceneTime * 0.2f), 0.0f));
+    float angle = sceneTime * 9.0f;
+    model = glm::rotate(model, glm::radians(angle), butterflyRot);
+    return model;
+}
+
+/// Butterfly sprite frame
+/**
+  Function that returns scale (xy) and offset (zw) of current butterfly frame in sprite sheet, 
+  the same frame as sampleTexture() in butterflyFS.txt picks
+*/
+glm::vec4 butterflySpriteTransform()
+{
+    float time = sin(deltaTime * speedAnimation);
+    int frame = int(time / 0.2f);
+    glm::vec2 dims = glm::vec2(1.0f / butterflySpritePattern.x, 1.0f / butterflySpritePattern.y);
+    return glm::vec4(dims.x, dims.y, dims.x * (frame % butterflySpritePattern.x), dims.y * (frame / butterflySpritePattern.y));
 }
 
 
 
 /// Set buffers for duck object
 /**
-  Function that setup VAO, VBO buffers for duck object and return VAO
+  Function that setup VAO, VBO buffers for duck object and return them
 */
-unsigned int initDuckBuffers()
+GLGeometry initDuckBuffers()
 {
-    unsigned int duckVBO, duckVAO;
+    GLGeometry duck;
 
-    glGenVertexArrays(1, &duckVAO);
-    glGenBuffers(1, &duckVBO);
+    duck.VAO.create();
+    duck.VBO.create();
 
-    glBindVertexArray(duckVAO);
+    glBindVertexArray(duck.VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, duckVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, duck.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -713,24 +808,28 @@ unsigned int initDuckBuffers()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 5, (void*)(3 * sizeof(float)));
 
+    // Shadow depth shader reads texture coords at location of meshes
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(float) * 5, (void*)(3 * sizeof(float)));
+
     glBindVertexArray(0);
-    return duckVAO;
+    return duck;
 }
 
 /// Set buffers for butterfly object
 /**
-  Function that setup VAO, VBO buffers for butterfly object and return VAO
+  Function that setup VAO, VBO buffers for butterfly object and return them
 */
-unsigned int initButterflyBuffers()
+GLGeometry initButterflyBuffers()
 {
-    unsigned int butterflyVBO, butterflyVAO;
+    GLGeometry butterfly;
 
-    glGenVertexArrays(1, &butterflyVAO);
-    glGenBuffers(1, &butterflyVBO);
+    butterfly.VAO.create();
+    butterfly.VBO.create();
 
-    glBindVertexArray(butterflyVAO);
+    glBindVertexArray(butterfly.VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, butterflyVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, butterfly.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -739,28 +838,32 @@ unsigned int initButterflyBuffers()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
+    // Shadow depth shader reads texture coords at location of meshes
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
     glBindVertexArray(0);
-    return butterflyVAO;
+    return butterfly;
 }
 
 /// Set buffers for table object
 /**
-  Function that setup VAO, VBO and EBO buffers for table object and return VAO
+  Function that setup VAO, VBO and EBO buffers for table object and return them
 */
-unsigned int initTableBuffers()
+GLGeometry initTableBuffers()
 {
-    unsigned int tableVBO, tableVAO, tableEBO;
+    GLGeometry table;
      
-    glGenVertexArrays(1, &tableVAO);
-    glGenBuffers(1, &tableVBO);
-    glGenBuffers(1, &tableEBO);
+    table.VAO.create();
+    table.VBO.create();
+    table.EBO.create();
 
-    glBindVertexArray(tableVAO);
+    glBindVertexArray(table.VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, tableVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, table.VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(cube_002Vertices), cube_002Vertices, GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tableEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, table.EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_002Triangles), cube_002Triangles, GL_STATIC_DRAW);
 
     glEnableVertexAttribArray(0);
@@ -773,12 +876,12 @@ unsigned int initTableBuffers()
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 
     glBindVertexArray(0);
-    return tableVAO;
+    return table;
 }
 
 // Unused draw functions of static objects
 /*
-void draw_tree(Models models, ShaderGen sceneShader)
+void draw_tree(Models& models, ShaderGen& sceneShader)
 {
     glm::mat4 treeMod = glm::mat4(1.0f);
     treeMod = glm::translate(treeMod, glm::vec3(-7.0f, 0.06f, 7.0f));
@@ -803,7 +906,7 @@ void draw_tree(Models models, ShaderGen sceneShader)
 }
 
 
-void draw_trash_bin(Models models, ShaderGen sceneShader)
+void draw_trash_bin(Models& models, ShaderGen& sceneShader)
 {
     glm::mat4 binModel = glm::mat4(1.0f);
     binModel = glm::translate(binModel, glm::vec3(2.7f, 0.03f, -1.88f));
@@ -814,7 +917,7 @@ void draw_trash_bin(Models models, ShaderGen sceneShader)
 }
 
 
-void draw_plants(Models models, ShaderGen sceneShader)
+void draw_plants(Models& models, ShaderGen& sceneShader)
 {
     glm::mat4 plantMod = glm::mat4(1.0f);
     plantMod = glm::translate(plantMod, glm::vec3(-2.7f, 0.0f, 3.0f));
@@ -834,7 +937,7 @@ void draw_plants(Models models, ShaderGen sceneShader)
 }
 
 
-void draw_police_car(Models models, ShaderGen policeCarShader)
+void draw_police_car(Models& models, ShaderGen& policeCarShader)
 {
     glStencilFunc(GL_ALWAYS, models.policeCarModel.ID, -1);
     glm::mat4 carModel = glm::mat4(1.0f);
@@ -856,8 +959,8 @@ void draw_police_car(Models models, ShaderGen policeCarShader)
 }
 
 
-void draw_interior(ShaderGen sceneShader,
-    Models models)
+void draw_interior(ShaderGen& sceneShader,
+    Models& models)
 {
    
     glm::mat4 tableMod = glm::mat4(1.0f);
@@ -980,7 +1083,7 @@ void draw_interior(ShaderGen sceneShader,
     models.chairModel.Draw(sceneShader);
 }
 
-void draw_police_mans(Models models, ShaderGen shader)
+void draw_police_mans(Models& models, ShaderGen& shader)
 {
     glm::mat4 policeMan = glm::mat4(1.0f);
     policeMan = glm::translate(policeMan, glm::vec3(3.0f, 0.0f, 3.0f));
@@ -990,7 +1093,7 @@ void draw_police_mans(Models models, ShaderGen shader)
     models.policeManModel.Draw(shader);
 }
 
-void draw_terrorists(Models models, ShaderGen shader)
+void draw_terrorists(Models& models, ShaderGen& shader)
 {
     glm::mat4 terrorModel = glm::mat4(1.0f);
     terrorModel = glm::translate(terrorModel, glm::vec3(0.0f, 0.0f, 3.0f));
@@ -1014,7 +1117,7 @@ void draw_terrorists(Models models, ShaderGen shader)
     models.terroristModel.Draw(shader);
 }
 
-void draw_lamps(Models models, ShaderGen shader)
+void draw_lamps(Models& models, ShaderGen& shader)
 {
     glm::mat4 lampKitchen = glm::mat4(1.0f);
     lampKitchen = glm::translate(lampKitchen, glm::vec3(-1.70f, 0.83f, -0.7f));
@@ -1163,3 +1266,4 @@ void draw_lamps(Models models, ShaderGen shader)
 }
 */
 
+#endif
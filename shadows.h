@@ -0,0 +1,418 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    shadows.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Cascaded shadow maps of directional light with cached static depth
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+
+#include "data.h"
+#include "ShaderGen.h"
+#include "render_stuff.h"
+
+/// One cascade of shadow map
+/**
+  Static depth of the house is rendered into staticDepth only when the cache is stale.
+  Every frame staticDepth is copied into depth under dynamic objects and they are drawn on top of it,
+  scene shader samples depth.
+*/
+struct ShadowCascade {
+    unsigned int staticFBO;///<staticFBO framebuffer of cached static depth
+    unsigned int staticDepth;///<staticDepth texture with depth of static objects
+    unsigned int FBO;///<FBO framebuffer of composited depth
+    unsigned int depth;///<depth texture with static and dynamic objects
+    glm::mat4 lightSpaceMatrix;///<lightSpaceMatrix projection * view of light
+    bool hadDynamic;///<hadDynamic dynamic objects were drawn into depth last frame
+    int dynamicRect[4];///<dynamicRect pixels x0, y0, x1, y1 of depth covered by dynamic objects last frame
+};
+
+/// Shadow maps of all cascades
+struct ShadowMaps {
+    ShadowCascade cascades[N_SHADOW_CASCADES];///<cascades from the nearest to the farthest
+    glm::vec3 cachedLightDir;///<cachedLightDir light direction of cached static depth
+    bool valid = false;///<valid static depth was rendered at least once
+};
+ShadowMaps shadowMaps;
+
+/// Locations of shadow uniforms in scene shader, looked up once per program
+struct ShadowUniforms {
+    unsigned int program = 0;///<program shader program of cached locations
+    GLint shadowsEnable;///<shadowsEnable location of switch
+    GLint shadowMap[N_SHADOW_CASCADES];///<shadowMap locations of samplers of cascades
+    GLint lightSpaceMatrix[N_SHADOW_CASCADES];///<lightSpaceMatrix locations of matrices of cascades
+};
+ShadowUniforms shadowUniforms;
+
+// Functions prototypes
+void initShadowMaps();
+void updateShadowMaps(ShaderGen& shadowShader, unsigned int tableVAO, unsigned int tableTexture,
+    unsigned int duckVAO, unsigned int duckTexture, unsigned int butterflyVAO, unsigned int butterflyTexture);
+void bindShadowMaps(ShaderGen& sceneShader);
+void cacheShadowUniforms(ShaderGen& sceneShader);
+
+unsigned int createShadowDepthTexture();
+unsigned int createShadowFramebuffer(unsigned int depthTexture);
+glm::mat4 calcLightSpaceMatrix(glm::vec3 lightDir, float extent);
+bool insideCascade(const ShadowCascade& cascade, glm::vec3 worldPos);
+void renderStaticShadows(ShaderGen& shadowShader, unsigned int tableVAO, unsigned int tableTexture);
+void renderDynamicShadows(ShaderGen& shadowShader, unsigned int duckVAO, unsigned int duckTexture, unsigned int butterflyVAO, unsigned int butterflyTexture);
+void growShadowRect(const glm::mat4& lightSpaceMatrix, const glm::mat4& model, int rect[4]);
+void setShadowRect(int rect[4], int x0, int y0, int x1, int y1);
+
+
+/// Init shadow maps
+/**
+  Function that creates depth textures and framebuffers for all cascades
+*/
+void initShadowMaps()
+{
+    for (int i = 0; i < N_SHADOW_CASCADES; i++)
+    {
+        ShadowCascade& cascade = shadowMaps.cascades[i];
+        cascade.staticDepth = createShadowDepthTexture();
+        cascade.staticFBO = createShadowFramebuffer(cascade.staticDepth);
+        cascade.depth = createShadowDepthTexture();
+        cascade.FBO = createShadowFramebuffer(cascade.depth);
+        cascade.lightSpaceMatrix = glm::mat4(1.0f);
+        cascade.hadDynamic = false;
+        setShadowRect(cascade.dynamicRect, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0);
+    }
+    shadowMaps.valid = false;
+}
+
+/// Shadow depth texture
+/**
+  Function that creates and returns depth texture for shadow map
+*/
+unsigned int createShadowDepthTexture()
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    // Everything outside of the map is lit
+    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+    return texture;
+}
+
+/// Shadow framebuffer
+/**
+  Function that creates and returns depth only framebuffer
+
+  \param[in] depthTexture attached depth texture.
+*/
+unsigned int createShadowFramebuffer(unsigned int depthTexture)
+{
+    unsigned int FBO;
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        cout << "ERROR: SHADOW FRAMEBUFFER NOT COMPLETE" << endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    return FBO;
+}
+
+/// Light space matrix
+/**
+  Function that returns orthographic projection * view of directional light for cascade.
+  Cascades are fixed around the house, so they do not change when camera moves
+
+  \param[in] lightDir light direction.
+  \param[in] extent half size of cascade.
+*/
+glm::mat4 calcLightSpaceMatrix(glm::vec3 lightDir, float extent)
+{
+    glm::vec3 dir = glm::normalize(lightDir);
+    // Sun is almost above the house, so up vector can not be Y
+    glm::vec3 up = abs(dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 lightView = glm::lookAt(shadowCenter - dir * shadowLightDistance, shadowCenter, up);
+    glm::mat4 lightProjection = glm::ortho(-extent, extent, -extent, extent, shadowNear, shadowFar);
+    return lightProjection * lightView;
+}
+
+/// Cascade test
+/**
+  Function that checks if point is covered by cascade
+
+  \param[in] cascade shadow cascade.
+  \param[in] worldPos point in world space.
+*/
+bool insideCascade(const ShadowCascade& cascade, glm::vec3 worldPos)
+{
+    glm::vec4 pos = cascade.lightSpaceMatrix * glm::vec4(worldPos, 1.0f);
+    return abs(pos.x) <= pos.w && abs(pos.y) <= pos.w;
+}
+
+/// Update shadow maps
+/**
+  Function that renders static depth when light direction changed or static object moved
+  and composites dynamic objects into shadow maps every frame
+
+  \param[in] shadowShader depth only shader.
+  \param[in] tableVAO bind VAO of table.
+  \param[in] tableTexture texture of table.
+  \param[in] duckVAO bind VAO of duck.
+  \param[in] duckTexture texture of duck for alpha test.
+  \param[in] butterflyVAO bind VAO of butterfly.
+  \param[in] butterflyTexture texture of butterfly for alpha test.
+*/
+void updateShadowMaps(ShaderGen& shadowShader, unsigned int tableVAO, unsigned int tableTexture,
+    unsigned int duckVAO, unsigned int duckTexture, unsigned int butterflyVAO, unsigned int butterflyTexture)
+{
+    PROFILE_SCOPE("updateShadowMaps");
+    if (!shadowsEnable)
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(shadowOffsetFactor, shadowOffsetUnits);
+
+    shadowShader.use();
+
+    // Static depth is cached until light or static objects change
+    if (!shadowMaps.valid || shadowStaticDirty || shadowMaps.cachedLightDir != lightDir)
+    {
+        renderStaticShadows(shadowShader, tableVAO, tableTexture);
+        shadowMaps.cachedLightDir = lightDir;
+        shadowMaps.valid = true;
+        shadowStaticDirty = false;
+    }
+
+    renderDynamicShadows(shadowShader, duckVAO, duckTexture, butterflyVAO, butterflyTexture);
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+/// Render static shadows
+/**
+  Function that renders house, furniture (position only stream) and table into cached depth of every cascade,
+  cutout meshes like leaves are drawn with textures and alpha test
+
+  \param[in] shadowShader depth only shader.
+  \param[in] tableVAO bind VAO of table.
+  \param[in] tableTexture texture of table.
+*/
+void renderStaticShadows(ShaderGen& shadowShader, unsigned int tableVAO, unsigned int tableTexture)
+{
+    glm::vec4 noTexTransform = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+    glUniform4fv(glGetUniformLocation(shadowShader.ID, "texTransform"), 1, &noTexTransform[0]);
+
+    for (int i = 0; i < N_SHADOW_CASCADES; i++)
+    {
+        ShadowCascade& cascade = shadowMaps.cascades[i];
+        cascade.lightSpaceMatrix = calcLightSpaceMatrix(lightDir, shadowCascadeExtents[i]);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, cascade.staticFBO);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glUniformMatrix4fv(glGetUniformLocation(shadowShader.ID, "lightSpaceMatrix"), 1, GL_FALSE, &cascade.lightSpaceMatrix[0][0]);
+
+        glUniform1i(glGetUniformLocation(shadowShader.ID, "alphaTest"), (int)false);
+        draw_house(shadowShader, DRAW_DEPTH, false);
+        draw_table(shadowShader, tableVAO, tableTexture);
+        glUniform1i(glGetUniformLocation(shadowShader.ID, "alphaTest"), (int)true);
+        draw_house(shadowShader, DRAW_CUTOUTS, false);
+
+        // Composited map has to be refreshed from the new static depth
+        cascade.hadDynamic = true;
+        setShadowRect(cascade.dynamicRect, 0, 0, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE);
+    }
+}
+
+/// Render dynamic shadows
+/**
+  Function that copies cached static depth under dynamic objects of this and last frame and draws them on top of it.
+  Cascades without dynamic objects in this and last frame are left untouched
+
+  \param[in] shadowShader depth only shader.
+  \param[in] duckVAO bind VAO of duck.
+  \param[in] duckTexture texture of duck for alpha test.
+  \param[in] butterflyVAO bind VAO of butterfly.
+  \param[in] butterflyTexture texture of butterfly for alpha test.
+*/
+void renderDynamicShadows(ShaderGen& shadowShader, unsigned int duckVAO, unsigned int duckTexture, unsigned int butterflyVAO, unsigned int butterflyTexture)
+{
+    glm::mat4 duckModel = duckModelMatrix();
+    glm::mat4 butterflyModel = butterflyModelMatrix();
+    glm::vec3 duckPos = glm::vec3(duckModel[3]);
+    glm::vec3 butterflyPos = glm::vec3(butterflyModel[3]);
+
+    glUniform1i(glGetUniformLocation(shadowShader.ID, "alphaTest"), (int)true);
+    // Cutout meshes of static pass could bind diffuse texture to other unit
+    glUniform1i(glGetUniformLocation(shadowShader.ID, "texture_diffuse1"), 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    for (int i = 0; i < N_SHADOW_CASCADES; i++)
+    {
+        ShadowCascade& cascade = shadowMaps.cascades[i];
+        bool drawDuck = insideCascade(cascade, duckPos);
+        bool drawButterfly = insideCascade(cascade, butterflyPos);
+        bool hasDynamic = drawDuck || drawButterfly;
+
+        // Nothing to erase and nothing to draw
+        if (!hasDynamic && !cascade.hadDynamic)
+            continue;
+
+        int rect[4];
+        setShadowRect(rect, SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, 0, 0);
+        if (drawDuck)
+            growShadowRect(cascade.lightSpaceMatrix, duckModel, rect);
+        if (drawButterfly)
+            growShadowRect(cascade.lightSpaceMatrix, butterflyModel, rect);
+
+        // Static depth is restored where dynamic objects were last frame and where they are drawn now
+        int x0 = min(rect[0], cascade.dynamicRect[0]);
+        int y0 = min(rect[1], cascade.dynamicRect[1]);
+        int x1 = max(rect[2], cascade.dynamicRect[2]);
+        int y1 = max(rect[3], cascade.dynamicRect[3]);
+        if (x0 < x1 && y0 < y1)
+        {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, cascade.staticFBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.FBO);
+            glBlitFramebuffer(x0, y0, x1, y1, x0, y0, x1, y1, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        setShadowRect(cascade.dynamicRect, rect[0], rect[1], rect[2], rect[3]);
+        cascade.hadDynamic = hasDynamic;
+        if (!hasDynamic)
+            continue;
+
+        glBindFramebuffer(GL_FRAMEBUFFER, cascade.FBO);
+        glUniformMatrix4fv(glGetUniformLocation(shadowShader.ID, "lightSpaceMatrix"), 1, GL_FALSE, &cascade.lightSpaceMatrix[0][0]);
+
+        // Duck
+        if (drawDuck)
+        {
+            glm::vec4 duckTexTransform = glm::vec4(1.0f, 1.0f, 0.0f, sin(sceneTime) * 0.02f);
+            glUniform4fv(glGetUniformLocation(shadowShader.ID, "texTransform"), 1, &duckTexTransform[0]);
+            glUniformMatrix4fv(glGetUniformLocation(shadowShader.ID, "model"), 1, GL_FALSE, &duckModel[0][0]);
+            glBindTexture(GL_TEXTURE_2D, duckTexture);
+            glBindVertexArray(duckVAO);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+        }
+
+        // Butterfly
+        if (drawButterfly)
+        {
+            glm::vec4 butterflyTexTransform = butterflySpriteTransform();
+            glUniform4fv(glGetUniformLocation(shadowShader.ID, "texTransform"), 1, &butterflyTexTransform[0]);
+            glUniformMatrix4fv(glGetUniformLocation(shadowShader.ID, "model"), 1, GL_FALSE, &butterflyModel[0][0]);
+            glBindTexture(GL_TEXTURE_2D, butterflyTexture);
+            glBindVertexArray(butterflyVAO);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 6);
+        }
+    }
+    glBindVertexArray(0);
+}
+
+/// Grow shadow rectangle
+/**
+  Function that grows rectangle by pixels of shadow map covered by dynamic object,
+  sprites of duck and butterfly lie inside of unit cube of their model matrix
+
+  \param[in] lightSpaceMatrix matrix of cascade.
+  \param[in] model matrix of object.
+  \param[in,out] rect pixels x0, y0, x1, y1, empty when x0 >= x1.
+*/
+void growShadowRect(const glm::mat4& lightSpaceMatrix, const glm::mat4& model, int rect[4])
+{
+    glm::mat4 matrix = lightSpaceMatrix * model;
+    int size = (int)SHADOW_MAP_SIZE;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        glm::vec4 pos = matrix * glm::vec4((corner & 1) ? 0.5f : -0.5f, (corner & 2) ? 0.5f : -0.5f, (corner & 4) ? 0.5f : -0.5f, 1.0f);
+        float x = (pos.x / pos.w * 0.5f + 0.5f) * size;
+        float y = (pos.y / pos.w * 0.5f + 0.5f) * size;
+        // One pixel border keeps edges of rasterized sprite inside
+        rect[0] = min(rect[0], max((int)floor(x) - 1, 0));
+        rect[1] = min(rect[1], max((int)floor(y) - 1, 0));
+        rect[2] = max(rect[2], min((int)ceil(x) + 1, size));
+        rect[3] = max(rect[3], min((int)ceil(y) + 1, size));
+    }
+}
+
+/// Set shadow rectangle
+/**
+  Function that sets pixels of rectangle
+
+  \param[out] rect pixels x0, y0, x1, y1.
+  \param[in] x0 left pixel.
+  \param[in] y0 bottom pixel.
+  \param[in] x1 right pixel, exclusive.
+  \param[in] y1 top pixel, exclusive.
+*/
+void setShadowRect(int rect[4], int x0, int y0, int x1, int y1)
+{
+    rect[0] = x0;
+    rect[1] = y0;
+    rect[2] = x1;
+    rect[3] = y1;
+}
+
+/// Bind shadow maps
+/**
+  Function that binds composited depth of all cascades and sets light space matrices in scene shader
+
+  \param[in] sceneShader scene shader, has to be in use.
+*/
+void bindShadowMaps(ShaderGen& sceneShader)
+{
+    if (shadowUniforms.program != sceneShader.ID)
+        cacheShadowUniforms(sceneShader);
+    const ShadowUniforms& u = shadowUniforms;
+
+    glUniform1i(u.shadowsEnable, (int)(shadowsEnable && shadowMaps.valid));
+    if (!shadowsEnable || !shadowMaps.valid)
+        return;
+
+    for (int i = 0; i < N_SHADOW_CASCADES; i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + shadowTextureUnit + i);
+        glBindTexture(GL_TEXTURE_2D, shadowMaps.cascades[i].depth);
+        glUniform1i(u.shadowMap[i], shadowTextureUnit + i);
+        glUniformMatrix4fv(u.lightSpaceMatrix[i], 1, GL_FALSE, &shadowMaps.cascades[i].lightSpaceMatrix[0][0]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+}
+
+/// Cache shadow uniforms
+/**
+  Function that looks up locations of shadow uniforms once per shader program,
+  names of cascades are built here instead of every frame
+
+  \param[in] sceneShader scene shader.
+*/
+void cacheShadowUniforms(ShaderGen& sceneShader)
+{
+    ShadowUniforms& u = shadowUniforms;
+    u.program = sceneShader.ID;
+    u.shadowsEnable = glGetUniformLocation(sceneShader.ID, "shadowsEnable");
+    for (int i = 0; i < N_SHADOW_CASCADES; i++)
+    {
+        u.shadowMap[i] = glGetUniformLocation(sceneShader.ID, ("shadowMap" + to_string(i)).c_str());
+        u.lightSpaceMatrix[i] = glGetUniformLocation(sceneShader.ID, ("lightSpaceMatrix[" + to_string(i) + "]").c_str());
+    }
+}
+
+#endif
@@ -0,0 +1,115 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    mip_chain_test.cpp
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Checks of mip chains of grey + alpha images, alpha has to stay linear and keep coverage
+ */
+ //----------------------------------------------------------------------------------------
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "mip_chain.h"
+
+int failures = 0;
+
+// Functions prototypes
+void check(bool condition, const char* what);
+void testAlphaStaysLinear();
+void testCutoutCoverage();
+
+
+/// Check
+/**
+  Function that prints failed condition and counts it
+
+  \param[in] condition tested condition.
+  \param[in] what description of condition.
+*/
+void check(bool condition, const char* what)
+{
+    if (condition)
+        return;
+    cout << "FAILED: " << what << endl;
+    failures++;
+}
+
+/// Linear alpha
+/**
+  Function that checks grey + alpha image whose alpha alternates 255 and 51, all texels pass alpha test,
+  so chain is filtered plainly and alpha of level 1 is linear average 153. Through sRGB tables it would be 188
+*/
+void testAlphaStaysLinear()
+{
+    const int size = 16;
+    vector<unsigned char> image(size * size * 2);
+    for (int i = 0; i < size * size; i++)
+    {
+        image[i * 2] = (unsigned char)(i * 7);
+        image[i * 2 + 1] = (i % 2) ? 51 : 255;
+    }
+    vector<unsigned char> chain;
+    buildMipChain(image.data(), size, size, 2, true, chain);
+
+    bool same = true;
+    for (size_t i = 0; i < image.size(); i++)
+        same = same && chain[i] == image[i];
+    check(same, "level 0 of grey + alpha chain is unchanged");
+
+    const unsigned char* level1 = chain.data() + mipChainOffset(size, size, 2, 1);
+    bool linear = true;
+    for (int i = 0; i < (size / 2) * (size / 2); i++)
+        linear = linear && abs(level1[i * 2 + 1] - 153) <= 1;
+    check(linear, "alpha of level 1 is averaged in linear space");
+}
+
+/// Cutout coverage
+/**
+  Function that checks grey + alpha cutout, disc with soft edge, keeps share of texels passing alpha test
+  at every level near share of level 0
+*/
+void testCutoutCoverage()
+{
+    const int size = 64;
+    vector<unsigned char> image(size * size * 2);
+    for (int y = 0; y < size; y++)
+    {
+        for (int x = 0; x < size; x++)
+        {
+            float distance = sqrtf((x - 31.5f) * (x - 31.5f) + (y - 31.5f) * (y - 31.5f));
+            float alpha = min(max((24.0f - distance) / 8.0f, 0.0f), 1.0f);
+            // Sparse holes like gaps between leaves
+            if ((x * 7 + y * 13) % 5 == 0)
+                alpha *= 0.05f;
+            image[(y * size + x) * 2] = 200;
+            image[(y * size + x) * 2 + 1] = (unsigned char)(alpha * 255.0f + 0.5f);
+        }
+    }
+    vector<unsigned char> chain;
+    buildMipChain(image.data(), size, size, 2, true, chain);
+
+    float coverage = alphaCoverage(image.data(), (size_t)size * size, 2, textureAlphaCutoff, 1.0f);
+    check(coverage > 0.0f && coverage < 1.0f, "test image is cutout");
+    for (int level = 1; level < mipLevelsOf(size, size); level++)
+    {
+        int levelSize = max(1, size >> level);
+        // Coarse levels have too few texels to match share exactly
+        if (levelSize < 8)
+            break;
+        const unsigned char* data = chain.data() + mipChainOffset(size, size, 2, level);
+        float levelCoverage = alphaCoverage(data, (size_t)levelSize * levelSize, 2, textureAlphaCutoff, 1.0f);
+        check(fabsf(levelCoverage - coverage) < 0.05f, "coverage of level is near coverage of level 0");
+    }
+}
+
+int main()
+{
+    testAlphaStaysLinear();
+    testCutoutCoverage();
+    if (failures == 0)
+        cout << "mip chain tests passed" << endl;
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
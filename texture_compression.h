@@ -0,0 +1,592 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    texture_compression.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Block compression of textures of models into BC1/BC3/BC4/BC5 with cache of compressed mip chains
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BC_SSE2
+#endif
+
+#include "data.h"
+#include "stb_image.h"
+#include "asset_pack.h"
+#include "memory_ledger.h"
+#include "mip_chain.h"
+
+#define BTEX_MAGIC 0x58455442
+#define BTEX_VERSION 2
+
+/// Header of cache file, mip chain follows it from level 0
+struct BtexHeader {
+    uint32_t magic;///<magic "BTEX"
+    uint32_t version;///<version of layout
+    uint32_t format;///<format compressed internal format
+    int32_t width;///<width of level 0
+    int32_t height;///<height of level 0
+    int32_t levels;///<levels number of mip levels
+    int32_t channels;///<channels of source image
+    unsigned char average[4];///<average color of source image
+    int64_t sourceSize;///<sourceSize size of source file, stale cache is encoded again
+    int64_t sourceTime;///<sourceTime modification time of source file
+};
+
+/// Compressed mip chain
+struct CompressedImage {
+    GLenum format = 0;///<format compressed internal format, 0 when image is not compressed
+    int width = 0;///<width of level 0
+    int height = 0;///<height of level 0
+    int levels = 0;///<levels number of mip levels
+    int channels = 0;///<channels of source image
+    unsigned char average[4] = {};///<average color of source image
+    vector<unsigned char> data;///<data all levels, the finest first
+};
+
+/// Compression state
+struct TextureCompression {
+    bool enable = true;///<enable textures of models are compressed
+    bool supported = false;///<supported driver exposes S3TC
+    atomic<int> cacheHits{ 0 };///<cacheHits textures read from cache
+    atomic<int> encoded{ 0 };///<encoded textures compressed at loading
+    atomic<int> temporaries{ 0 };///<temporaries number of written caches, it makes names of temporary files unique
+};
+TextureCompression textureCompression;
+
+// Functions prototypes
+bool parseCompressionArgs(int argc, char** argv);
+void initTextureCompression();
+void printTextureCompression();
+bool compressedTexturesEnabled();
+GLenum compressedFormatFor(int channels, bool normalMap);
+bool loadCompressedTexture(const string& path, bool normalMap, CompressedImage& image);
+bool readCompressedCache(const string& path, CompressedImage& image, int64_t sourceSize, int64_t sourceTime);
+void writeCompressedCache(const string& path, const CompressedImage& image, int64_t sourceSize, int64_t sourceTime);
+void compressImage(const unsigned char* data, int width, int height, int channels, GLenum format, bool srgb, CompressedImage& image);
+void compressLevel(const unsigned char* pixels, int width, int height, int channels, GLenum format, unsigned char* out);
+size_t levelOffset(const CompressedImage& image, int level);
+size_t levelBytes(GLenum format, int width, int height);
+void fetchBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by, unsigned char block[64]);
+void encodeBC1(const unsigned char block[64], unsigned char out[8]);
+void encodeBC4(const unsigned char block[64], int channel, unsigned char out[8]);
+void blockBounds(const unsigned char block[64], unsigned char minColor[4], unsigned char maxColor[4]);
+void averageTexel(const unsigned char* data, int width, int height, int channels, unsigned char out[4]);
+
+
+/// Parse arguments
+/**
+  Function that reads "--uncompressed-textures" from command line, textures are loaded like before compression
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseCompressionArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) == "--uncompressed-textures")
+            textureCompression.enable = false;
+    }
+    return true;
+}
+
+/// Init compression
+/**
+  Function that checks S3TC extension, it is called before texture pipeline starts, RGTC is in core
+*/
+void initTextureCompression()
+{
+    int count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; i++)
+    {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+        if (name && strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+            textureCompression.supported = true;
+    }
+    if (!textureCompression.enable)
+        cout << "Texture compression: disabled" << endl;
+    else if (!textureCompression.supported)
+        cout << "Texture compression: S3TC is not supported, textures are uncompressed" << endl;
+    else
+        cout << "Texture compression: BC1/BC3/BC4/BC5, cache " << textureCacheExtension << endl;
+}
+
+/// Print compression
+/**
+  Function that prints how many textures were read from cache and how many were compressed
+*/
+void printTextureCompression()
+{
+    if (compressedTexturesEnabled())
+        cout << "Compressed textures: " << textureCompression.cacheHits << " from cache, " << textureCompression.encoded << " encoded" << endl;
+}
+
+/// Compression enabled
+/**
+  Function that returns true when textures of models are compressed
+*/
+bool compressedTexturesEnabled()
+{
+    return textureCompression.enable && textureCompression.supported;
+}
+
+/// Format of texture
+/**
+  Function that returns compressed format of image. Normal maps keep only X and Y in RGTC2 (BC5),
+  no shader samples normal maps now, shader that does has to reconstruct Z from them
+
+  \param[in] channels number of channels of image.
+  \param[in] normalMap image is normal map.
+*/
+GLenum compressedFormatFor(int channels, bool normalMap)
+{
+    if (normalMap || channels == 2)
+        return GL_COMPRESSED_RG_RGTC2;
+    if (channels == 1)
+        return GL_COMPRESSED_RED_RGTC1;
+    if (channels == 4)
+        return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+/// Load compressed texture
+/**
+  Function that reads compressed mip chain from cache, image is decoded and compressed when cache is missing
+  or older than image. It runs on worker thread, returns false when image failed to load
+
+  \param[in] path of image file.
+  \param[in] normalMap image is normal map.
+  \param[out] image compressed mip chain.
+*/
+bool loadCompressedTexture(const string& path, bool normalMap, CompressedImage& image)
+{
+    int64_t sourceSize = 0, sourceTime = 0;
+    if (!assetFileStat(path, sourceSize, sourceTime))
+        return false;
+    if (readCompressedCache(path, image, sourceSize, sourceTime) && (image.format == GL_COMPRESSED_RG_RGTC2) == (normalMap || image.channels == 2))
+    {
+        textureCompression.cacheHits++;
+        return true;
+    }
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(false);
+    unsigned char* data = loadAssetImage(path, &width, &height, &channels, 0);
+    if (!data)
+        return false;
+    if (channels < 1 || channels > 4)
+    {
+        stbi_image_free(data);
+        return false;
+    }
+    compressImage(data, width, height, channels, compressedFormatFor(channels, normalMap), !normalMap, image);
+    stbi_image_free(data);
+
+    writeCompressedCache(path, image, sourceSize, sourceTime);
+    textureCompression.encoded++;
+    return true;
+}
+
+/// Read cache
+/**
+  Function that reads compressed mip chain, returns false when cache is missing, broken or stale
+
+  \param[in] path of image file.
+  \param[out] image compressed mip chain.
+  \param[in] sourceSize size of image file.
+  \param[in] sourceTime modification time of image file.
+*/
+bool readCompressedCache(const string& path, CompressedImage& image, int64_t sourceSize, int64_t sourceTime)
+{
+    AssetData cache;
+    if (!readAsset(path + textureCacheExtension, cache) || cache.size < sizeof(BtexHeader))
+        return false;
+    BtexHeader header;
+    memcpy(&header, cache.data, sizeof(header));
+    if (header.magic != BTEX_MAGIC || header.version != BTEX_VERSION ||
+        header.sourceSize != sourceSize || header.sourceTime != sourceTime || !compressedBlockBytes(header.format) ||
+        header.width <= 0 || header.height <= 0 || header.levels != mipLevelsOf(header.width, header.height))
+        return false;
+
+    image.format = header.format;
+    image.width = header.width;
+    image.height = header.height;
+    image.levels = header.levels;
+    image.channels = header.channels;
+    memcpy(image.average, header.average, sizeof(image.average));
+    size_t bytes = levelOffset(image, image.levels);
+    if (cache.size - sizeof(header) < bytes)
+    {
+        image = CompressedImage();
+        return false;
+    }
+    image.data.assign(cache.data + sizeof(header), cache.data + sizeof(header) + bytes);
+    return true;
+}
+
+/// Write cache
+/**
+  Function that saves compressed mip chain next to image, failure only costs compression at next start
+
+  \param[in] path of image file.
+  \param[in] image compressed mip chain.
+  \param[in] sourceSize size of image file.
+  \param[in] sourceTime modification time of image file.
+*/
+void writeCompressedCache(const string& path, const CompressedImage& image, int64_t sourceSize, int64_t sourceTime)
+{
+    BtexHeader header;
+    header.magic = BTEX_MAGIC;
+    header.version = BTEX_VERSION;
+    header.format = image.format;
+    header.width = image.width;
+    header.height = image.height;
+    header.levels = image.levels;
+    header.channels = image.channels;
+    memcpy(header.average, image.average, sizeof(header.average));
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+
+    // Other thread never reads half written cache, workers encoding the same image write own temporary files
+    string temporary = path + textureCacheExtension + "." + to_string(++textureCompression.temporaries) + ".tmp";
+    {
+        ofstream file(temporary, ios::binary | ios::trunc);
+        if (!file.write((const char*)&header, sizeof(header)) || !file.write((const char*)image.data.data(), image.data.size()))
+        {
+            cout << "Failed to write texture cache of " << path << endl;
+            file.close();
+            remove(temporary.c_str());
+            return;
+        }
+    }
+    remove((path + textureCacheExtension).c_str());
+    rename(temporary.c_str(), (path + textureCacheExtension).c_str());
+}
+
+/// Compress image
+/**
+  Function that builds mip chain of image and compresses every level
+
+  \param[in] data pixels of image.
+  \param[in] width of image.
+  \param[in] height of image.
+  \param[in] channels number of channels.
+  \param[in] format compressed format.
+  \param[in] srgb color channels are sRGB, mips are filtered in linear space.
+  \param[out] image compressed mip chain.
+*/
+void compressImage(const unsigned char* data, int width, int height, int channels, GLenum format, bool srgb, CompressedImage& image)
+{
+    image.format = format;
+    image.width = width;
+    image.height = height;
+    image.levels = mipLevelsOf(width, height);
+    image.channels = channels;
+    averageTexel(data, width, height, channels, image.average);
+    image.data.resize(levelOffset(image, image.levels));
+
+    vector<unsigned char> chain;
+    buildMipChain(data, width, height, channels, srgb, chain);
+    for (int level = 0; level < image.levels; level++)
+    {
+        compressLevel(chain.data() + mipChainOffset(width, height, channels, level), max(1, width >> level), max(1, height >> level),
+            channels, format, image.data.data() + levelOffset(image, level));
+    }
+}
+
+/// Compress level
+/**
+  Function that compresses one level block by block, edge blocks repeat last row and column
+
+  \param[in] pixels of level.
+  \param[in] width of level.
+  \param[in] height of level.
+  \param[in] channels number of channels.
+  \param[in] format compressed format.
+  \param[out] out blocks of level.
+*/
+void compressLevel(const unsigned char* pixels, int width, int height, int channels, GLenum format, unsigned char* out)
+{
+    unsigned char block[64];
+    for (int by = 0; by < (height + 3) / 4; by++)
+    {
+        for (int bx = 0; bx < (width + 3) / 4; bx++)
+        {
+            fetchBlock(pixels, width, height, channels, bx, by, block);
+            switch (format)
+            {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                encodeBC1(block, out);
+                out += 8;
+                break;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                encodeBC4(block, 3, out);
+                encodeBC1(block, out + 8);
+                out += 16;
+                break;
+            case GL_COMPRESSED_RED_RGTC1:
+                encodeBC4(block, 0, out);
+                out += 8;
+                break;
+            case GL_COMPRESSED_RG_RGTC2:
+                encodeBC4(block, 0, out);
+                encodeBC4(block, 1, out + 8);
+                out += 16;
+                break;
+            }
+        }
+    }
+}
+
+/// Level offset
+/**
+  Function that returns offset of level in data of compressed image, offset of levels count is size of data
+
+  \param[in] image compressed mip chain.
+  \param[in] level mip level.
+*/
+size_t levelOffset(const CompressedImage& image, int level)
+{
+    size_t offset = 0;
+    for (int i = 0; i < level; i++)
+        offset += levelBytes(image.format, max(1, image.width >> i), max(1, image.height >> i));
+    return offset;
+}
+
+/// Level bytes
+/**
+  Function that returns size of compressed level
+
+  \param[in] format compressed format.
+  \param[in] width of level.
+  \param[in] height of level.
+*/
+size_t levelBytes(GLenum format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * compressedBlockBytes(format);
+}
+
+/// Fetch block
+/**
+  Function that copies 4x4 block into RGBA texels, missing channels are 0 and alpha is 255 like GL samples them
+
+  \param[in] pixels of level.
+  \param[in] width of level.
+  \param[in] height of level.
+  \param[in] channels number of channels.
+  \param[in] bx column of block.
+  \param[in] by row of block.
+  \param[out] block RGBA texels.
+*/
+void fetchBlock(const unsigned char* pixels, int width, int height, int channels, int bx, int by, unsigned char block[64])
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int py = min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            int px = min(bx * 4 + x, width - 1);
+            const unsigned char* texel = &pixels[((size_t)py * width + px) * channels];
+            unsigned char* target = block + (y * 4 + x) * 4;
+            target[0] = texel[0];
+            target[1] = channels > 1 ? texel[1] : 0;
+            target[2] = channels > 2 ? texel[2] : 0;
+            target[3] = channels > 3 ? texel[3] : 255;
+        }
+    }
+}
+
+/// Encode BC1
+/**
+  Function that encodes colors of block, endpoints are corners of bounding box inset by 1/16 of its size
+
+  \param[in] block RGBA texels.
+  \param[out] out 8 bytes of block.
+*/
+void encodeBC1(const unsigned char block[64], unsigned char out[8])
+{
+    unsigned char minColor[4], maxColor[4];
+    blockBounds(block, minColor, maxColor);
+    for (int c = 0; c < 3; c++)
+    {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        minColor[c] = (unsigned char)min(minColor[c] + inset, 255);
+        maxColor[c] = (unsigned char)max(maxColor[c] - inset, 0);
+    }
+
+    unsigned short color0 = (unsigned short)(((maxColor[0] >> 3) << 11) | ((maxColor[1] >> 2) << 5) | (maxColor[2] >> 3));
+    unsigned short color1 = (unsigned short)(((minColor[0] >> 3) << 11) | ((minColor[1] >> 2) << 5) | (minColor[2] >> 3));
+    out[0] = (unsigned char)(color0 & 0xFF);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xFF);
+    out[3] = (unsigned char)(color1 >> 8);
+
+    // Palette as decoder expands it, index 2 and 3 are thirds between endpoints
+    int palette[4][3];
+    for (int i = 0; i < 2; i++)
+    {
+        unsigned short color = i == 0 ? color0 : color1;
+        palette[i][0] = ((color >> 11) << 3) | (color >> 13);
+        palette[i][1] = (((color >> 5) & 63) << 2) | ((color >> 9) & 3);
+        palette[i][2] = ((color & 31) << 3) | ((color >> 2) & 7);
+    }
+    for (int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+
+    unsigned int indices = 0;
+    if (color0 != color1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            const unsigned char* texel = block + i * 4;
+            int best = 0, bestDistance = INT32_MAX;
+            for (int p = 0; p < 4; p++)
+            {
+                int dr = texel[0] - palette[p][0], dg = texel[1] - palette[p][1], db = texel[2] - palette[p][2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= (unsigned int)best << (2 * i);
+        }
+    }
+    memcpy(out + 4, &indices, 4);
+}
+
+/// Encode BC4
+/**
+  Function that encodes one channel of block with 8 values between minimum and maximum
+
+  \param[in] block RGBA texels.
+  \param[in] channel encoded channel.
+  \param[out] out 8 bytes of block.
+*/
+void encodeBC4(const unsigned char block[64], int channel, unsigned char out[8])
+{
+    unsigned char minColor[4], maxColor[4];
+    blockBounds(block, minColor, maxColor);
+    int value0 = maxColor[channel], value1 = minColor[channel];
+    out[0] = (unsigned char)value0;
+    out[1] = (unsigned char)value1;
+
+    // Index 0 and 1 are endpoints, 2 to 7 are steps from maximum to minimum
+    int palette[8] = { value0, value1 };
+    for (int i = 1; i < 7; i++)
+        palette[i + 1] = ((7 - i) * value0 + i * value1) / 7;
+
+    uint64_t indices = 0;
+    if (value0 != value1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int value = block[i * 4 + channel];
+            int best = 0;
+            for (int p = 1; p < 8; p++)
+            {
+                if (abs(value - palette[p]) < abs(value - palette[best]))
+                    best = p;
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+/// Block bounds
+/**
+  Function that returns minimum and maximum of every channel of block
+
+  \param[in] block RGBA texels.
+  \param[out] minColor minimum of channels.
+  \param[out] maxColor maximum of channels.
+*/
+void blockBounds(const unsigned char block[64], unsigned char minColor[4], unsigned char maxColor[4])
+{
+#ifdef BC_SSE2
+    // Four texels per register, then halves are folded down to one texel
+    __m128i low = _mm_loadu_si128((const __m128i*)block);
+    __m128i high = low;
+    for (int i = 1; i < 4; i++)
+    {
+        __m128i row = _mm_loadu_si128((const __m128i*)(block + 16 * i));
+        low = _mm_min_epu8(low, row);
+        high = _mm_max_epu8(high, row);
+    }
+    low = _mm_min_epu8(low, _mm_srli_si128(low, 8));
+    low = _mm_min_epu8(low, _mm_srli_si128(low, 4));
+    high = _mm_max_epu8(high, _mm_srli_si128(high, 8));
+    high = _mm_max_epu8(high, _mm_srli_si128(high, 4));
+    int minBits = _mm_cvtsi128_si32(low), maxBits = _mm_cvtsi128_si32(high);
+    memcpy(minColor, &minBits, 4);
+    memcpy(maxColor, &maxBits, 4);
+#else
+    for (int c = 0; c < 4; c++)
+    {
+        minColor[c] = 255;
+        maxColor[c] = 0;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            minColor[c] = min(minColor[c], block[i * 4 + c]);
+            maxColor[c] = max(maxColor[c], block[i * 4 + c]);
+        }
+    }
+#endif
+}
+
+/// Average texel
+/**
+  Function that computes average color of image from at most 64K samples
+
+  \param[in] data pixels of image.
+  \param[in] width of image.
+  \param[in] height of image.
+  \param[in] channels number of channels.
+  \param[out] out average color.
+*/
+void averageTexel(const unsigned char* data, int width, int height, int channels, unsigned char out[4])
+{
+    long long sums[4] = {};
+    long long count = 0;
+    size_t pixels = (size_t)width * height;
+    size_t step = max((size_t)1, pixels / 65536);
+    for (size_t i = 0; i < pixels; i += step)
+    {
+        for (int c = 0; c < channels && c < 4; c++)
+            sums[c] += data[i * channels + c];
+        count++;
+    }
+    for (int c = 0; c < 4; c++)
+        out[c] = count ? (unsigned char)(sums[c] / count) : 0;
+}
+
+#endif
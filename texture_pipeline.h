@@ -0,0 +1,572 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    texture_pipeline.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Texture decoding by worker threads and upload through pixel buffer objects with per-frame budget
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef TEXTURE_PIPELINE_H
+#define TEXTURE_PIPELINE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "data.h"
+#include "stb_image.h"
+#include "asset_pack.h"
+#include "memory_ledger.h"
+#include "texture_residency.h"
+#include "texture_compression.h"
+#include "mip_chain.h"
+
+// Staging buffers in ring, one is written by worker while others are copied by GPU
+#define N_STAGING_BUFFERS 4
+
+/// What the texture is used for, it decides format and parameters set after upload
+enum TextureUploadKind {
+    TEXTURE_UPLOAD_MODEL,///< texture of model material, format by channels of file
+    TEXTURE_UPLOAD_SPRITE,///< texture of dynamical object, format given by caller
+    TEXTURE_UPLOAD_CUBEMAP_FACE///< one face of skybox
+};
+
+/// State of staging buffer
+enum StagingState {
+    STAGING_FREE,///< mapped, waiting for worker
+    STAGING_FILLED,///< mapped, worker copied image into it
+    STAGING_IN_FLIGHT///< unmapped, GPU copies it into texture until fence
+};
+
+/// Decode request
+struct TextureUploadJob {
+    TextureUploadKind kind;///<kind of texture
+    unsigned int texture;///<texture ID of texture, created by caller
+    GLenum target;///<target of glTexImage2D, face for cubemaps
+    GLenum format;///<format of sprite texture
+    string path;///<path of image file
+    string owner;///<owner name in memory ledger
+    string group;///<group of memory ledger when job was submitted
+    bool flip;///<flip image vertically
+    int channels;///<channels requested channels, 0 keeps channels of file
+    bool normalMap;///<normalMap texture of model is normal map
+    long long sequence;///<sequence number of job, set by submit
+};
+
+/// Pixel buffer object mapped for workers
+struct StagingBuffer {
+    unsigned int PBO;///<PBO pixel unpack buffer
+    unsigned char* mapped;///<mapped pointer while buffer is mapped
+    StagingState state;///<state of buffer
+    GLsync fence;///<fence of last copy from buffer
+};
+
+/// Decoded image
+struct TextureUpload {
+    TextureUploadJob job;///<job decoded job
+    int width = 0;///<width of image
+    int height = 0;///<height of image
+    int channels = 0;///<channels of pixels
+    int staging = -1;///<staging buffer with pixels, -1 when image did not fit into it
+    vector<unsigned char> pixels;///<pixels mip chain, the finest level first, kept only when it did not fit into staging buffer
+    int levels = 1;///<levels number of mip levels of image
+    CompressedImage compressed;///<compressed mip chain of texture of model, format 0 when image is not compressed
+    unsigned char average[4] = {};///<average color of image
+    bool valid = false;///<valid image was decoded
+};
+
+/// Pipeline state
+struct TexturePipeline {
+    StagingBuffer staging[N_STAGING_BUFFERS];///<staging ring of pixel buffers
+    vector<thread> workers;///<workers decoding threads
+    mutex lock;///<lock of queues and staging states
+    condition_variable wake;///<wake signals job, free staging buffer or quit
+    condition_variable done;///<done signals decoded image
+    vector<TextureUploadJob> jobs;///<jobs waiting for worker
+    vector<TextureUpload> decoded;///<decoded images waiting for upload
+    vector<TextureUpload> ready;///<ready images taken by GL thread
+    int readyPos = 0;///<readyPos next uploaded image of ready
+    vector<int> freeStaging;///<freeStaging mapped buffers for workers
+    int pending = 0;///<pending jobs not uploaded yet
+    long long sequence = 0;///<sequence number of last submitted job
+    unordered_map<unsigned int, long long> lastJob;///<lastJob sequence of last job of texture
+    unordered_map<unsigned int, long long> canceled;///<canceled jobs of deleted texture up to sequence are skipped
+    unordered_set<unsigned int> alphaTextures;///<alphaTextures uploaded model textures with alpha channel
+    long long uploadedBytes = 0;///<uploadedBytes bytes uploaded in current frame
+    bool quit = false;///<quit workers end
+    bool started = false;///<started workers run
+};
+TexturePipeline texturePipeline;
+
+// Functions prototypes
+void initTexturePipeline();
+void shutdownTexturePipeline();
+void submitTextureUpload(const TextureUploadJob& job);
+void cancelTextureUploads(unsigned int texture);
+void updateTextureUploads(long long byteBudget);
+void finishTextureUploads();
+void recycleStagingBuffers();
+void completeTextureUpload(TextureUpload& upload);
+void finishTextureParameters(const TextureUpload& upload, GLenum format);
+bool textureHasAlpha(unsigned int texture);
+GLenum formatOfChannels(int channels);
+void textureWorkerThread();
+void decodeTexture(TextureUpload& upload, unique_lock<mutex>& guard);
+
+
+/// Init pipeline
+/**
+  Function that creates and maps staging buffers and starts workers, it is called when GL context is current
+*/
+void initTexturePipeline()
+{
+    for (int i = 0; i < N_STAGING_BUFFERS; i++)
+    {
+        StagingBuffer& buffer = texturePipeline.staging[i];
+        glGenBuffers(1, &buffer.PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, textureStagingBytes, NULL, GL_STREAM_DRAW);
+        ledgerBuffer(buffer.PBO, textureStagingBytes, "staging", "texture pipeline", 0);
+        buffer.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, textureStagingBytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        buffer.state = STAGING_FREE;
+        buffer.fence = 0;
+        texturePipeline.freeStaging.push_back(i);
+    }
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    int workers = (int)min<unsigned int>(max(thread::hardware_concurrency(), 2u) - 1, (unsigned int)textureDecodeThreads);
+    for (int i = 0; i < workers; i++)
+        texturePipeline.workers.push_back(thread(textureWorkerThread));
+    texturePipeline.started = true;
+    cout << "Texture pipeline: " << workers << " decoding threads, " << N_STAGING_BUFFERS << " staging buffers of "
+         << textureStagingBytes / (1024 * 1024) << " MB" << endl;
+}
+
+/// Shutdown pipeline
+/**
+  Function that stops workers and releases staging buffers, jobs in progress are dropped
+*/
+void shutdownTexturePipeline()
+{
+    if (!texturePipeline.started)
+        return;
+    {
+        lock_guard<mutex> guard(texturePipeline.lock);
+        texturePipeline.quit = true;
+    }
+    texturePipeline.wake.notify_all();
+    for (auto& worker : texturePipeline.workers)
+        worker.join();
+    texturePipeline.workers.clear();
+    texturePipeline.decoded.clear();
+    texturePipeline.ready.clear();
+
+    for (auto& buffer : texturePipeline.staging)
+    {
+        if (buffer.fence)
+            glDeleteSync(buffer.fence);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.PBO);
+        if (buffer.state != STAGING_IN_FLIGHT)
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &buffer.PBO);
+        ledgerRelease(LEDGER_BUFFER, buffer.PBO);
+    }
+    texturePipeline.started = false;
+}
+
+/// Submit upload
+/**
+  Function that queues image for decoding, texture keeps its storage until the image is uploaded
+
+  \param[in] job decode request.
+*/
+void submitTextureUpload(const TextureUploadJob& job)
+{
+    texturePipeline.pending++;
+    texturePipeline.lastJob[job.texture] = ++texturePipeline.sequence;
+    {
+        lock_guard<mutex> guard(texturePipeline.lock);
+        texturePipeline.jobs.push_back(job);
+        texturePipeline.jobs.back().group = memoryLedger.group;
+        texturePipeline.jobs.back().sequence = texturePipeline.sequence;
+    }
+    texturePipeline.wake.notify_all();
+}
+
+/// Cancel uploads
+/**
+  Function that skips uploads into deleted texture, its ID may be reused by new texture
+  whose jobs have higher sequence
+
+  \param[in] texture deleted texture.
+*/
+void cancelTextureUploads(unsigned int texture)
+{
+    auto found = texturePipeline.lastJob.find(texture);
+    if (found != texturePipeline.lastJob.end())
+        texturePipeline.canceled[texture] = found->second;
+    texturePipeline.alphaTextures.erase(texture);
+}
+
+/// Update uploads
+/**
+  Function that returns staging buffers finished by GPU to workers and uploads decoded images
+  until byte budget is spent, at least one image is uploaded per call. Bytes left are used by reloads of textures
+
+  \param[in] byteBudget bytes uploaded in this call.
+*/
+void updateTextureUploads(long long byteBudget)
+{
+    texturePipeline.uploadedBytes = 0;
+    if (!texturePipeline.started || texturePipeline.pending == 0)
+        return;
+    recycleStagingBuffers();
+
+    while (texturePipeline.uploadedBytes < byteBudget)
+    {
+        // GL thread never waits for workers
+        if (texturePipeline.readyPos == (int)texturePipeline.ready.size())
+        {
+            unique_lock<mutex> guard(texturePipeline.lock, try_to_lock);
+            if (!guard.owns_lock() || texturePipeline.decoded.empty())
+                return;
+            texturePipeline.ready.clear();
+            texturePipeline.ready.swap(texturePipeline.decoded);
+            texturePipeline.readyPos = 0;
+        }
+        completeTextureUpload(texturePipeline.ready[texturePipeline.readyPos++]);
+    }
+}
+
+/// Finish uploads
+/**
+  Function that uploads all submitted images, it is used at the end of loading
+*/
+void finishTextureUploads()
+{
+    auto start = chrono::steady_clock::now();
+    while (texturePipeline.pending > 0)
+    {
+        updateTextureUploads(LLONG_MAX);
+        if (texturePipeline.pending == 0)
+            break;
+        // Fences of staging buffers are signaled only after commands are flushed
+        glFlush();
+        unique_lock<mutex> guard(texturePipeline.lock);
+        texturePipeline.done.wait_for(guard, chrono::milliseconds(1), [] { return !texturePipeline.decoded.empty(); });
+    }
+    cout << "Textures uploaded in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+    printTextureCompression();
+}
+
+/// Recycle buffers
+/**
+  Function that maps staging buffers whose copies GPU finished and gives them to workers
+*/
+void recycleStagingBuffers()
+{
+    bool recycled = false;
+    for (int i = 0; i < N_STAGING_BUFFERS; i++)
+    {
+        StagingBuffer& buffer = texturePipeline.staging[i];
+        if (buffer.state != STAGING_IN_FLIGHT)
+            continue;
+        GLenum status = glClientWaitSync(buffer.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            continue;
+        glDeleteSync(buffer.fence);
+        buffer.fence = 0;
+
+        // Invalidation gives new storage, so mapping does not wait for GPU
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.PBO);
+        buffer.mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, textureStagingBytes,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+        lock_guard<mutex> guard(texturePipeline.lock);
+        buffer.state = STAGING_FREE;
+        texturePipeline.freeStaging.push_back(i);
+        recycled = true;
+    }
+    if (recycled)
+        texturePipeline.wake.notify_all();
+}
+
+/// Complete upload
+/**
+  Function that copies decoded image into texture, GL thread issues only copy from staging buffer and fence
+
+  \param[in] upload decoded image.
+*/
+void completeTextureUpload(TextureUpload& upload)
+{
+    const TextureUploadJob& job = upload.job;
+    auto canceled = texturePipeline.canceled.find(job.texture);
+    bool skip = canceled != texturePipeline.canceled.end() && job.sequence <= canceled->second;
+    if (--texturePipeline.pending == 0)
+    {
+        texturePipeline.lastJob.clear();
+        texturePipeline.canceled.clear();
+    }
+
+    // Texture was deleted, staging buffer is returned untouched
+    if (skip || !upload.valid)
+    {
+        if (upload.staging >= 0)
+        {
+            lock_guard<mutex> guard(texturePipeline.lock);
+            texturePipeline.staging[upload.staging].state = STAGING_FREE;
+            texturePipeline.freeStaging.push_back(upload.staging);
+        }
+        if (skip)
+            return;
+        if (job.kind == TEXTURE_UPLOAD_MODEL)
+            cout << "Texture failed to load at path: " << job.owner << endl;
+        else if (job.kind == TEXTURE_UPLOAD_CUBEMAP_FACE)
+            cout << "Cubemap tex failed to load at path: " << job.path << endl;
+        else
+            cout << "Failed to load texture" << endl;
+        texturePipeline.wake.notify_all();
+        return;
+    }
+
+    const CompressedImage& compressed = upload.compressed;
+    GLenum format = compressed.format ? compressed.format : job.kind == TEXTURE_UPLOAD_SPRITE ? job.format : formatOfChannels(upload.channels);
+    GLenum bindTarget = job.kind == TEXTURE_UPLOAD_CUBEMAP_FACE ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    glBindTexture(bindTarget, job.texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // Offsets into staging buffer or pointers into CPU copy
+    const unsigned char* source = NULL;
+    if (upload.staging >= 0)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, texturePipeline.staging[upload.staging].PBO);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    else
+        source = compressed.format ? compressed.data.data() : upload.pixels.data();
+
+    if (compressed.format)
+    {
+        for (int level = 0; level < compressed.levels; level++)
+        {
+            int width = max(1, compressed.width >> level), height = max(1, compressed.height >> level);
+            glCompressedTexImage2D(job.target, level, format, width, height, 0, (GLsizei)levelBytes(format, width, height),
+                source + levelOffset(compressed, level));
+        }
+        texturePipeline.uploadedBytes += (long long)levelOffset(compressed, compressed.levels);
+    }
+    else
+    {
+        // Levels were filtered by worker, nothing is generated on GPU
+        for (int level = 0; level < upload.levels; level++)
+        {
+            glTexImage2D(job.target, level, format, max(1, upload.width >> level), max(1, upload.height >> level), 0, format,
+                GL_UNSIGNED_BYTE, source + mipChainOffset(upload.width, upload.height, upload.channels, level));
+        }
+        texturePipeline.uploadedBytes += (long long)mipChainOffset(upload.width, upload.height, upload.channels, upload.levels);
+    }
+
+    if (upload.staging >= 0)
+    {
+        StagingBuffer& buffer = texturePipeline.staging[upload.staging];
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        buffer.mapped = NULL;
+        buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        buffer.state = STAGING_IN_FLIGHT;
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    finishTextureParameters(upload, format);
+    glBindTexture(bindTarget, 0);
+}
+
+/// Finish parameters
+/**
+  Function that sets parameters by kind of texture and records texture into ledger and texture budget.
+  Texture is bound
+
+  \param[in] upload uploaded image.
+  \param[in] format of texels.
+*/
+void finishTextureParameters(const TextureUpload& upload, GLenum format)
+{
+    const TextureUploadJob& job = upload.job;
+    string group = memoryLedger.group;
+    memoryLedger.group = job.group;
+    if (job.kind == TEXTURE_UPLOAD_MODEL)
+    {
+        ledgerTexture(job.texture, format, upload.width, upload.height, 1, true, job.owner);
+        registerResidentTexture(job.texture, job.path, format, upload.width, upload.height, upload.average, !job.normalMap);
+
+        if (upload.channels == 4)
+        {
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            texturePipeline.alphaTextures.insert(job.texture);
+        }
+        else
+        {
+            texturePipeline.alphaTextures.erase(job.texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else if (job.kind == TEXTURE_UPLOAD_SPRITE)
+    {
+        ledgerTexture(job.texture, format, upload.width, upload.height, 1, true, job.owner);
+    }
+    else
+    {
+        // Faces come one by one, entry of cubemap grows by layer
+        LedgerEntry* entry = findLedgerEntry(LEDGER_TEXTURE, job.texture);
+        if (!entry)
+            ledgerTexture(job.texture, format, upload.width, upload.height, 1, false, job.owner);
+        else
+        {
+            entry->layers++;
+            ledgerTextureResize(job.texture, format, upload.width, upload.height, 1);
+        }
+    }
+    memoryLedger.group = group;
+}
+
+/// Texture alpha
+/**
+  Function that returns true when uploaded model texture has alpha channel, meshes with it are cutouts
+
+  \param[in] texture name of texture.
+*/
+bool textureHasAlpha(unsigned int texture)
+{
+    return texturePipeline.alphaTextures.count(texture) > 0;
+}
+
+/// Format of channels
+/**
+  Function that returns format of texels with given number of channels
+
+  \param[in] channels number of channels.
+*/
+GLenum formatOfChannels(int channels)
+{
+    switch (channels)
+    {
+    case 1: return GL_RED;
+    case 2: return GL_RG;
+    case 3: return GL_RGB;
+    default: return GL_RGBA;
+    }
+}
+
+/// Worker thread
+/**
+  Function that decodes queued images until quit, GL is used only by GL thread
+*/
+void textureWorkerThread()
+{
+    unique_lock<mutex> guard(texturePipeline.lock);
+    while (true)
+    {
+        texturePipeline.wake.wait(guard, [] { return texturePipeline.quit || !texturePipeline.jobs.empty(); });
+        if (texturePipeline.quit)
+            return;
+        TextureUpload upload;
+        upload.job = std::move(texturePipeline.jobs.front());
+        texturePipeline.jobs.erase(texturePipeline.jobs.begin());
+
+        decodeTexture(upload, guard);
+        if (texturePipeline.quit)
+            return;
+        texturePipeline.decoded.push_back(std::move(upload));
+        texturePipeline.done.notify_one();
+    }
+}
+
+/// Decode texture
+/**
+  Function that decodes image, builds its mip chain and copies it into free staging buffer, it waits for buffer
+  when all are in use.
+  Textures of models are read as compressed mip chains when compression is enabled.
+  Images bigger than staging buffer stay in CPU memory. Lock is held on entry and exit
+
+  \param[in,out] upload image of job.
+  \param[in] guard lock of pipeline.
+*/
+void decodeTexture(TextureUpload& upload, unique_lock<mutex>& guard)
+{
+    guard.unlock();
+    const unsigned char* data;
+    size_t bytes;
+    CompressedImage& compressed = upload.compressed;
+    if (upload.job.kind == TEXTURE_UPLOAD_MODEL && compressedTexturesEnabled())
+    {
+        upload.valid = loadCompressedTexture(upload.job.path, upload.job.normalMap, compressed);
+        upload.width = compressed.width;
+        upload.height = compressed.height;
+        upload.channels = compressed.channels;
+        memcpy(upload.average, compressed.average, sizeof(upload.average));
+        data = compressed.data.data();
+        bytes = compressed.data.size();
+    }
+    else
+    {
+        stbi_set_flip_vertically_on_load_thread(upload.job.flip);
+        int fileChannels;
+        unsigned char* image = loadAssetImage(upload.job.path, &upload.width, &upload.height, &fileChannels, upload.job.channels);
+        upload.channels = upload.job.channels ? upload.job.channels : fileChannels;
+        upload.valid = image && upload.channels >= 1 && upload.channels <= 4;
+        if (upload.valid)
+        {
+            averageTexel(image, upload.width, upload.height, upload.channels, upload.average);
+            // Faces of skybox have no mips
+            if (upload.job.kind == TEXTURE_UPLOAD_CUBEMAP_FACE)
+                upload.pixels.assign(image, image + (size_t)upload.width * upload.height * upload.channels);
+            else
+            {
+                buildMipChain(image, upload.width, upload.height, upload.channels, !upload.job.normalMap, upload.pixels);
+                upload.levels = mipLevelsOf(upload.width, upload.height);
+            }
+        }
+        stbi_image_free(image);
+        data = upload.pixels.data();
+        bytes = upload.pixels.size();
+    }
+    guard.lock();
+
+    if (!upload.valid || bytes > textureStagingBytes)
+        return;
+
+    texturePipeline.wake.wait(guard, [] { return texturePipeline.quit || !texturePipeline.freeStaging.empty(); });
+    if (texturePipeline.quit)
+        return;
+    upload.staging = texturePipeline.freeStaging.back();
+    texturePipeline.freeStaging.pop_back();
+    StagingBuffer& buffer = texturePipeline.staging[upload.staging];
+    buffer.state = STAGING_FILLED;
+    unsigned char* mapped = buffer.mapped;
+
+    guard.unlock();
+    memcpy(mapped, data, bytes);
+    vector<unsigned char>().swap(upload.pixels);
+    vector<unsigned char>().swap(compressed.data);
+    guard.lock();
+}
+
+#endif
@@ -0,0 +1,780 @@
+//----------------------------------------------------------------------------------------
+/**
+ * \file    texture_residency.h
+ * \author  Lebedev Daniil
+ * \date    2022
+ * \brief   Budget of video memory for textures of models with mip dropping, LRU eviction and async reload
+ */
+ //----------------------------------------------------------------------------------------
+
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "data.h"
+#include "stb_image.h"
+#include "asset_pack.h"
+#include "memory_ledger.h"
+#include "texture_compression.h"
+#include "mip_chain.h"
+
+// Texture is not in video memory, 1x1 placeholder of its average color is bound instead
+#define TEXTURE_EVICTED -1
+
+/// Texture of model under budget
+/**
+  ID never changes, meshes keep binding it, only storage of texture is respecified.
+  Mips are counted from file, so residentMip 2 means level 0 of texture is quarter of file
+*/
+struct ResidentTexture {
+    unsigned int ID;///<ID of texture, 0 when slot is free
+    string path;///<path of image file
+    GLenum format;///<format of texels
+    int width;///<width of file
+    int height;///<height of file
+    int residentMip;///<residentMip mip of file in level 0, TEXTURE_EVICTED when evicted
+    int wantedMip;///<wantedMip finest mip sampled, estimated from screen size of objects
+    bool loading;///<loading reload is in progress
+    int loadingMip;///<loadingMip mip being loaded
+    long long lastUsedFrame;///<lastUsedFrame frame when texture was drawn
+    long long bytes;///<bytes size in video memory
+    unsigned char placeholder[4];///<placeholder average color of image
+    bool srgb;///<srgb color channels are sRGB, mips are filtered in linear space
+};
+
+/// Reload request of loader thread
+struct TextureLoadJob {
+    int index;///<index of texture, loader copies its path under lock
+    int mip;///<mip loaded mip of file
+};
+
+/// Image decoded by loader thread
+struct TextureLoadResult {
+    int index;///<index of texture
+    int mip;///<mip loaded mip of file
+    int width;///<width of image
+    int height;///<height of image
+    vector<unsigned char> pixels;///<pixels empty when loading failed, compressed levels of compressed texture
+};
+
+/// Residency state
+struct TextureResidency {
+    vector<ResidentTexture> textures;///<textures registered during loading of models
+    unordered_map<unsigned int, int> byID;///<byID index of texture by its ID
+    long long residentBytes = 0;///<residentBytes size of textures in video memory
+    long long incomingBytes = 0;///<incomingBytes size of textures being loaded
+    long long frame = 0;///<frame current frame
+    float focalPixels = 1.0f;///<focalPixels pixels of unit size at unit distance
+    unsigned int copyFramebuffer = 0;///<copyFramebuffer reads levels when mips are dropped
+    int evictions = 0;///<evictions number of evicted textures
+    int mipDrops = 0;///<mipDrops number of dropped mip chains
+    int reloads = 0;///<reloads number of reloaded textures
+
+    // Loader thread, jobs and results are reserved for all textures, so main thread never allocates
+    thread loader;///<loader thread decoding images
+    mutex lock;///<lock of jobs and results
+    condition_variable wake;///<wake signals new job or quit
+    vector<TextureLoadJob> jobs;///<jobs waiting for loader, at most one per texture
+    vector<TextureLoadResult> results;///<results waiting for upload
+    vector<TextureLoadResult> ready;///<ready results taken by main thread
+    int readyPos = 0;///<readyPos next uploaded result of ready
+    bool quit = false;///<quit loader thread ends
+    bool started = false;///<started loader thread runs
+};
+TextureResidency textureResidency;
+
+// Functions prototypes
+bool parseTextureArgs(int argc, char** argv);
+void registerResidentTexture(unsigned int ID, const string& path, GLenum format, int width, int height,
+    const unsigned char placeholder[4], bool srgb);
+void unregisterResidentTexture(unsigned int ID);
+void reserveTextureJobs();
+void initTextureResidency();
+void shutdownTextureResidency();
+void beginTextureResidencyFrame(glm::mat4 projection);
+void touchResidentTexture(unsigned int ID, float screenPixels);
+void updateTextureResidency(long long byteBudget);
+void uploadLoadedTextures(long long byteBudget);
+void requestTextureLoads();
+void enforceTextureBudget();
+void dropTextureMips(ResidentTexture& texture, int mip);
+void evictTexture(ResidentTexture& texture);
+void finishTextureLevels(ResidentTexture& texture, int mip, int oldLevels);
+int mipWidth(const ResidentTexture& texture, int mip);
+int mipHeight(const ResidentTexture& texture, int mip);
+int mipCount(const ResidentTexture& texture, int mip);
+int coarsestMip(const ResidentTexture& texture);
+long long mipBytes(const ResidentTexture& texture, int mip);
+void textureLoaderThread();
+void uploadTextureLevels(const ResidentTexture& texture, int mip, const unsigned char* data);
+GLenum pixelFormatOf(const ResidentTexture& texture);
+int formatChannels(GLenum format);
+void loadTextureMip(const TextureLoadJob& job, const string& path, GLenum format, bool srgb, TextureLoadResult& result);
+
+
+/// Parse arguments
+/**
+  Function that reads "--texture-budget MB" from command line, returns false on bad arguments
+
+  \param[in] argc number of arguments.
+  \param[in] argv arguments.
+*/
+bool parseTextureArgs(int argc, char** argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (string(argv[i]) != "--texture-budget")
+            continue;
+
+        if (i + 1 >= argc || atoi(argv[i + 1]) <= 0)
+        {
+            cout << "Usage: --texture-budget <MB>" << endl;
+            return false;
+        }
+        textureBudgetMB = atoi(argv[i + 1]);
+    }
+    return true;
+}
+
+/// Register texture
+/**
+  Function that puts loaded texture of model under budget, free slot of deleted texture is reused
+
+  \param[in] ID of texture.
+  \param[in] path of image file.
+  \param[in] format of texels.
+  \param[in] width of image.
+  \param[in] height of image.
+  \param[in] placeholder average color of image.
+  \param[in] srgb color channels are sRGB.
+*/
+void registerResidentTexture(unsigned int ID, const string& path, GLenum format, int width, int height,
+    const unsigned char placeholder[4], bool srgb)
+{
+    ResidentTexture texture;
+    texture.ID = ID;
+    texture.path = path;
+    texture.format = format;
+    texture.width = width;
+    texture.height = height;
+    texture.residentMip = 0;
+    texture.wantedMip = 0;
+    texture.loading = false;
+    texture.loadingMip = 0;
+    texture.lastUsedFrame = 0;
+    texture.bytes = mipBytes(texture, 0);
+    memcpy(texture.placeholder, placeholder, sizeof(texture.placeholder));
+    texture.srgb = srgb;
+
+    auto& textures = textureResidency.textures;
+    int index = 0;
+    while (index < (int)textures.size() && (textures[index].ID != 0 || textures[index].loading))
+        index++;
+    {
+        // Loader reads paths of textures
+        lock_guard<mutex> guard(textureResidency.lock);
+        if (index == (int)textures.size())
+            textures.push_back(texture);
+        else
+            textures[index] = texture;
+    }
+    textureResidency.byID[ID] = index;
+    textureResidency.residentBytes += texture.bytes;
+    if (textureResidency.started)
+        reserveTextureJobs();
+}
+
+/// Unregister texture
+/**
+  Function that frees slot of deleted texture, slot with reload in progress is freed by upload
+
+  \param[in] ID of texture.
+*/
+void unregisterResidentTexture(unsigned int ID)
+{
+    auto found = textureResidency.byID.find(ID);
+    if (found == textureResidency.byID.end())
+        return;
+    ResidentTexture& texture = textureResidency.textures[found->second];
+    textureResidency.residentBytes -= texture.bytes;
+    texture.bytes = 0;
+    texture.ID = 0;
+    textureResidency.byID.erase(found);
+}
+
+/// Reserve jobs
+/**
+  Function that makes room for job and result of every texture, so frames never grow them
+*/
+void reserveTextureJobs()
+{
+    size_t count = textureResidency.textures.size();
+    lock_guard<mutex> guard(textureResidency.lock);
+    textureResidency.jobs.reserve(count);
+    textureResidency.results.reserve(count);
+    textureResidency.ready.reserve(count);
+}
+
+/// Init residency
+/**
+  Function that starts loader thread, textures of models streamed in later are registered by their upload
+*/
+void initTextureResidency()
+{
+    size_t count = textureResidency.textures.size();
+    reserveTextureJobs();
+
+    glGenFramebuffers(1, &textureResidency.copyFramebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, textureResidency.copyFramebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+
+    textureResidency.loader = thread(textureLoaderThread);
+    textureResidency.started = true;
+    cout << "Texture budget " << textureBudgetMB << " MB, " << count << " textures use "
+         << textureResidency.residentBytes / (1024 * 1024) << " MB" << endl;
+}
+
+/// Shutdown residency
+/**
+  Function that stops loader thread and prints statistics, it is called before models are unloaded
+*/
+void shutdownTextureResidency()
+{
+    if (!textureResidency.started)
+        return;
+    {
+        lock_guard<mutex> guard(textureResidency.lock);
+        textureResidency.quit = true;
+    }
+    textureResidency.wake.notify_one();
+    textureResidency.loader.join();
+    textureResidency.started = false;
+    cout << "Texture residency: " << textureResidency.mipDrops << " mip drops, " << textureResidency.evictions
+         << " evictions, " << textureResidency.reloads << " reloads" << endl;
+}
+
+/// Begin frame
+/**
+  Function that takes scale of projection, screen size of objects is estimated by it
+
+  \param[in] projection matrix of camera.
+*/
+void beginTextureResidencyFrame(glm::mat4 projection)
+{
+    textureResidency.frame++;
+    textureResidency.focalPixels = projection[1][1] * SCR_HEIGHT * 0.5f;
+}
+
+/// Touch texture
+/**
+  Function that marks texture as used in frame and lowers its wanted mip.
+  Texture spans object once at most, so texels per pixel are size of texture over screen size of object
+
+  \param[in] ID of texture.
+  \param[in] screenPixels size of object on screen.
+*/
+void touchResidentTexture(unsigned int ID, float screenPixels)
+{
+    auto found = textureResidency.byID.find(ID);
+    if (found == textureResidency.byID.end())
+        return;
+    ResidentTexture& texture = textureResidency.textures[found->second];
+
+    float texels = (float)max(texture.width, texture.height);
+    int mip = (int)floor(log2(max(texels / max(screenPixels, 1.0f), 1.0f))) - textureMipBias;
+    mip = glm::clamp(mip, 0, coarsestMip(texture));
+
+    if (texture.lastUsedFrame != textureResidency.frame)
+    {
+        texture.lastUsedFrame = textureResidency.frame;
+        texture.wantedMip = mip;
+    }
+    else
+        texture.wantedMip = min(texture.wantedMip, mip);
+}
+
+/// Update residency
+/**
+  Function that uploads loaded images, requests images of textures drawn in too low resolution
+  and fits textures into budget, it is called after textures of frame are touched
+
+  \param[in] byteBudget bytes left for reloads in this frame.
+*/
+void updateTextureResidency(long long byteBudget)
+{
+    if (!textureResidency.started)
+        return;
+    uploadLoadedTextures(byteBudget);
+    requestTextureLoads();
+    enforceTextureBudget();
+}
+
+/// Upload textures
+/**
+  Function that uploads images decoded by loader thread until byte budget is spent. Image bigger than
+  the whole budget of frame is uploaded alone in frame without other uploads
+
+  \param[in] byteBudget bytes left for reloads in this frame.
+*/
+void uploadLoadedTextures(long long byteBudget)
+{
+    // Main thread never waits for loader
+    if (textureResidency.readyPos == (int)textureResidency.ready.size())
+    {
+        unique_lock<mutex> guard(textureResidency.lock, try_to_lock);
+        if (!guard.owns_lock())
+            return;
+        textureResidency.ready.clear();
+        textureResidency.ready.swap(textureResidency.results);
+        textureResidency.readyPos = 0;
+    }
+
+    long long uploaded = 0;
+    while (textureResidency.readyPos < (int)textureResidency.ready.size())
+    {
+        TextureLoadResult& result = textureResidency.ready[textureResidency.readyPos];
+        long long bytes = (long long)result.pixels.size();
+        if (uploaded + bytes > byteBudget && (uploaded > 0 || byteBudget < textureUploadBytesPerFrame))
+            break;
+        textureResidency.readyPos++;
+        ResidentTexture& texture = textureResidency.textures[result.index];
+        texture.loading = false;
+        textureResidency.incomingBytes -= mipBytes(texture, result.mip);
+        // Texture was deleted during loading
+        if (texture.ID == 0)
+            continue;
+        if (result.pixels.empty())
+        {
+            cout << "Texture failed to reload at path: " << texture.path << endl;
+            continue;
+        }
+
+        int oldLevels = texture.residentMip == TEXTURE_EVICTED ? 1 : mipCount(texture, texture.residentMip);
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        uploadTextureLevels(texture, result.mip, result.pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        finishTextureLevels(texture, result.mip, oldLevels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        textureResidency.reloads++;
+        uploaded += bytes;
+    }
+}
+
+/// Request loads
+/**
+  Function that asks loader thread for textures drawn in this frame whose resident mip is coarser than wanted,
+  requested mip is the finest one fitting into budget
+*/
+void requestTextureLoads()
+{
+    long long budget = (long long)textureBudgetMB * 1024 * 1024;
+    bool requested = false;
+    for (int i = 0; i < (int)textureResidency.textures.size(); i++)
+    {
+        ResidentTexture& texture = textureResidency.textures[i];
+        if (texture.ID == 0 || texture.loading || texture.lastUsedFrame != textureResidency.frame)
+            continue;
+        bool evicted = texture.residentMip == TEXTURE_EVICTED;
+        if (!evicted && texture.residentMip <= texture.wantedMip)
+            continue;
+
+        long long freeBytes = budget - textureResidency.residentBytes - textureResidency.incomingBytes + texture.bytes;
+        int mip = texture.wantedMip;
+        while (mip < coarsestMip(texture) && mipBytes(texture, mip) > freeBytes)
+            mip++;
+        // Evicted texture is loaded anyway, unused textures are evicted for it
+        if (!evicted && mip >= texture.residentMip)
+            continue;
+
+        if (!requested)
+        {
+            textureResidency.lock.lock();
+            requested = true;
+        }
+        texture.loading = true;
+        texture.loadingMip = mip;
+        textureResidency.incomingBytes += mipBytes(texture, mip);
+        textureResidency.jobs.push_back({ i, mip });
+    }
+    if (requested)
+    {
+        textureResidency.lock.unlock();
+        textureResidency.wake.notify_one();
+    }
+}
+
+/// Enforce budget
+/**
+  Function that frees video memory until textures fit into budget. At first it drops mips finer than wanted,
+  then evicts least recently used textures, at last it drops top mips of textures drawn in this frame
+*/
+void enforceTextureBudget()
+{
+    long long budget = (long long)textureBudgetMB * 1024 * 1024;
+    auto& textures = textureResidency.textures;
+
+    // Mips nobody samples, the biggest saving first
+    while (textureResidency.residentBytes > budget)
+    {
+        ResidentTexture* best = NULL;
+        long long bestSaving = 0;
+        for (auto& texture : textures)
+        {
+            if (texture.ID == 0 || texture.loading || texture.residentMip == TEXTURE_EVICTED || texture.residentMip >= texture.wantedMip)
+                continue;
+            long long saving = texture.bytes - mipBytes(texture, texture.wantedMip);
+            if (saving > bestSaving)
+            {
+                best = &texture;
+                bestSaving = saving;
+            }
+        }
+        if (!best)
+            break;
+        dropTextureMips(*best, best->wantedMip);
+    }
+
+    // Textures not drawn in this frame, the oldest first
+    while (textureResidency.residentBytes > budget)
+    {
+        ResidentTexture* oldest = NULL;
+        for (auto& texture : textures)
+        {
+            if (texture.ID == 0 || texture.loading || texture.residentMip == TEXTURE_EVICTED || texture.lastUsedFrame == textureResidency.frame)
+                continue;
+            if (!oldest || texture.lastUsedFrame < oldest->lastUsedFrame)
+                oldest = &texture;
+        }
+        if (!oldest)
+            break;
+        evictTexture(*oldest);
+    }
+
+    // Visible textures lose resolution, the biggest first
+    while (textureResidency.residentBytes > budget)
+    {
+        ResidentTexture* biggest = NULL;
+        for (auto& texture : textures)
+        {
+            if (texture.ID == 0 || texture.loading || texture.residentMip == TEXTURE_EVICTED || texture.residentMip >= coarsestMip(texture))
+                continue;
+            if (!biggest || texture.bytes > biggest->bytes)
+                biggest = &texture;
+        }
+        if (!biggest)
+            break;
+        dropTextureMips(*biggest, biggest->residentMip + 1);
+    }
+}
+
+/// Drop mips
+/**
+  Function that makes mip of file level 0 of texture, kept levels are copied on GPU, so nothing is read back.
+  Compressed levels cannot be attached to framebuffer, they are read back and uploaded again
+
+  \param[in] texture resident texture.
+  \param[in] mip new top mip of file, coarser than resident one.
+*/
+void dropTextureMips(ResidentTexture& texture, int mip)
+{
+    int oldLevels = mipCount(texture, texture.residentMip);
+    if (compressedBlockBytes(texture.format))
+    {
+        vector<unsigned char> levels((size_t)mipBytes(texture, mip));
+        size_t offset = 0;
+        glBindTexture(GL_TEXTURE_2D, texture.ID);
+        for (int level = mip - texture.residentMip; level < oldLevels; level++)
+        {
+            glGetCompressedTexImage(GL_TEXTURE_2D, level, levels.data() + offset);
+            int fileMip = texture.residentMip + level;
+            offset += levelBytes(texture.format, mipWidth(texture, fileMip), mipHeight(texture, fileMip));
+        }
+        uploadTextureLevels(texture, mip, levels.data());
+        finishTextureLevels(texture, mip, oldLevels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        textureResidency.mipDrops++;
+        return;
+    }
+
+    // Levels are copied aside, then they become levels of the same texture from 0
+    int levels = mipCount(texture, mip);
+    int skipped = mip - texture.residentMip;
+    unsigned int copy;
+    glGenTextures(1, &copy);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, textureResidency.copyFramebuffer);
+    for (int level = 0; level < levels; level++)
+    {
+        int width = mipWidth(texture, mip + level), height = mipHeight(texture, mip + level);
+        glBindTexture(GL_TEXTURE_2D, copy);
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format, width, height, 0, texture.format, GL_UNSIGNED_BYTE, NULL);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.ID, skipped + level);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, 0, 0, width, height);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture.ID);
+    for (int level = 0; level < levels; level++)
+    {
+        int width = mipWidth(texture, mip + level), height = mipHeight(texture, mip + level);
+        glTexImage2D(GL_TEXTURE_2D, level, texture.format, width, height, 0, texture.format, GL_UNSIGNED_BYTE, NULL);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, copy, level);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, 0, 0, width, height);
+    }
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+    glDeleteTextures(1, &copy);
+
+    finishTextureLevels(texture, mip, oldLevels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    textureResidency.mipDrops++;
+}
+
+/// Evict texture
+/**
+  Function that replaces storage of texture by 1x1 placeholder of its average color
+
+  \param[in] texture resident texture.
+*/
+void evictTexture(ResidentTexture& texture)
+{
+    int oldLevels = mipCount(texture, texture.residentMip);
+    GLenum format = pixelFormatOf(texture);
+    glBindTexture(GL_TEXTURE_2D, texture.ID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, 1, 1, 0, format, GL_UNSIGNED_BYTE, texture.placeholder);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    finishTextureLevels(texture, TEXTURE_EVICTED, oldLevels);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    textureResidency.evictions++;
+}
+
+/// Finish levels
+/**
+  Function that frees levels of previous storage and updates sizes, levels of new storage are uploaded already.
+  Texture is bound
+
+  \param[in] texture resident texture.
+  \param[in] mip new top mip of file or TEXTURE_EVICTED.
+  \param[in] oldLevels number of levels of previous storage.
+*/
+void finishTextureLevels(ResidentTexture& texture, int mip, int oldLevels)
+{
+    bool evicted = mip == TEXTURE_EVICTED;
+    int levels = evicted ? 1 : mipCount(texture, mip);
+    GLenum format = pixelFormatOf(texture);
+    for (int level = levels; level < oldLevels; level++)
+        glTexImage2D(GL_TEXTURE_2D, level, format, 0, 0, 0, format, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+
+    long long bytes = evicted ? texelBytes(texture.format) : mipBytes(texture, mip);
+    textureResidency.residentBytes += bytes - texture.bytes;
+    texture.bytes = bytes;
+    texture.residentMip = mip;
+    ledgerTextureResize(texture.ID, texture.format, evicted ? 1 : mipWidth(texture, mip), evicted ? 1 : mipHeight(texture, mip), levels);
+}
+
+/// Upload levels
+/**
+  Function that uploads chain whose level 0 is mip of file, compressed or tightly packed. Texture is bound
+
+  \param[in] texture resident texture.
+  \param[in] mip of file in level 0.
+  \param[in] data levels, the finest first.
+*/
+void uploadTextureLevels(const ResidentTexture& texture, int mip, const unsigned char* data)
+{
+    bool compressed = compressedBlockBytes(texture.format) != 0;
+    int channels = formatChannels(texture.format);
+    for (int level = 0; level < mipCount(texture, mip); level++)
+    {
+        int width = mipWidth(texture, mip + level), height = mipHeight(texture, mip + level);
+        if (compressed)
+        {
+            GLsizei bytes = (GLsizei)levelBytes(texture.format, width, height);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, texture.format, width, height, 0, bytes, data);
+            data += bytes;
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, texture.format, width, height, 0, texture.format, GL_UNSIGNED_BYTE, data);
+            data += (size_t)width * height * channels;
+        }
+    }
+}
+
+/// Pixel format
+/**
+  Function that returns format of pixels given to glTexImage2D, placeholders of compressed textures are RGBA
+
+  \param[in] texture resident texture.
+*/
+GLenum pixelFormatOf(const ResidentTexture& texture)
+{
+    return compressedBlockBytes(texture.format) ? GL_RGBA : texture.format;
+}
+
+/// Format channels
+/**
+  Function that returns number of channels of pixels of uncompressed format
+
+  \param[in] format of texels.
+*/
+int formatChannels(GLenum format)
+{
+    switch (format)
+    {
+    case GL_RED: return 1;
+    case GL_RG: return 2;
+    case GL_RGB: return 3;
+    default: return 4;
+    }
+}
+
+/// Mip width
+/**
+  Function that returns width of mip of file
+
+  \param[in] texture resident texture.
+  \param[in] mip of file.
+*/
+int mipWidth(const ResidentTexture& texture, int mip)
+{
+    return max(1, texture.width >> mip);
+}
+
+/// Mip height
+/**
+  Function that returns height of mip of file
+
+  \param[in] texture resident texture.
+  \param[in] mip of file.
+*/
+int mipHeight(const ResidentTexture& texture, int mip)
+{
+    return max(1, texture.height >> mip);
+}
+
+/// Mip count
+/**
+  Function that returns number of levels of texture whose level 0 is mip of file
+
+  \param[in] texture resident texture.
+  \param[in] mip of file.
+*/
+int mipCount(const ResidentTexture& texture, int mip)
+{
+    return mipLevelsOf(mipWidth(texture, mip), mipHeight(texture, mip));
+}
+
+/// Coarsest mip
+/**
+  Function that returns the coarsest mip kept in level 0, smaller textures lose too much when UVs repeat
+
+  \param[in] texture resident texture.
+*/
+int coarsestMip(const ResidentTexture& texture)
+{
+    int mip = 0;
+    while (max(mipWidth(texture, mip), mipHeight(texture, mip)) > textureMinSize)
+        mip++;
+    return mip;
+}
+
+/// Mip bytes
+/**
+  Function that returns size of texture whose level 0 is mip of file
+
+  \param[in] texture resident texture.
+  \param[in] mip of file.
+*/
+long long mipBytes(const ResidentTexture& texture, int mip)
+{
+    return textureSize(texture.format, mipWidth(texture, mip), mipHeight(texture, mip), mipCount(texture, mip));
+}
+
+/// Loader thread
+/**
+  Function that decodes requested images until quit, GL is used only by main thread
+*/
+void textureLoaderThread()
+{
+    unique_lock<mutex> guard(textureResidency.lock);
+    while (true)
+    {
+        textureResidency.wake.wait(guard, [] { return textureResidency.quit || !textureResidency.jobs.empty(); });
+        if (textureResidency.quit)
+            return;
+        TextureLoadJob job = textureResidency.jobs.front();
+        textureResidency.jobs.erase(textureResidency.jobs.begin());
+        string path = textureResidency.textures[job.index].path;
+        GLenum format = textureResidency.textures[job.index].format;
+        bool srgb = textureResidency.textures[job.index].srgb;
+        guard.unlock();
+
+        TextureLoadResult result;
+        loadTextureMip(job, path, format, srgb, result);
+
+        guard.lock();
+        textureResidency.results.push_back(std::move(result));
+    }
+}
+
+/// Load mip
+/**
+  Function that decodes image and builds its mip chain from requested mip.
+  Textures of models are read without flip like at first loading, compressed ones are read from cache
+
+  \param[in] job load request.
+  \param[in] path of image file.
+  \param[in] format of texture.
+  \param[in] srgb color channels are sRGB.
+  \param[out] result levels from requested mip, the finest first.
+*/
+void loadTextureMip(const TextureLoadJob& job, const string& path, GLenum format, bool srgb, TextureLoadResult& result)
+{
+    result.index = job.index;
+    result.mip = job.mip;
+    if (compressedBlockBytes(format))
+    {
+        int64_t sourceSize, sourceTime;
+        CompressedImage image;
+        if (!assetFileStat(path, sourceSize, sourceTime) || !readCompressedCache(path, image, sourceSize, sourceTime) || image.format != format)
+            return;
+        result.width = max(1, image.width >> job.mip);
+        result.height = max(1, image.height >> job.mip);
+        result.pixels.assign(image.data.begin() + levelOffset(image, job.mip), image.data.end());
+        return;
+    }
+
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(false);
+    unsigned char* data = loadAssetImage(path, &width, &height, &channels, 0);
+    if (!data)
+        return;
+    vector<unsigned char> chain;
+    buildMipChain(data, width, height, channels, srgb, chain);
+    stbi_image_free(data);
+
+    result.width = max(1, width >> job.mip);
+    result.height = max(1, height >> job.mip);
+    result.pixels.assign(chain.begin() + mipChainOffset(width, height, channels, job.mip), chain.end());
+}
+
+#endif